@@ -4,7 +4,7 @@
 # LICENSE file in the root directory of this source tree.
 
 import contextlib
-from typing import Iterator, List, Union
+from typing import Iterator, List, Optional, Union
 
 import nvtx
 import torch
@@ -102,6 +102,11 @@ def get_forward_backward_func():
     first_val_step (bool, optional): Is the first step of the validation phase. Used by
         Transformer Engine modules to only update their fp8 weights only on the first validation
         step.
+
+    seq_lengths (list of int, optional): Sequence length of each microbatch, e.g., the token
+        counts returned by the FlatFlow control plane. If given to the non-interleaved pipeline
+        schedule, the tensor shapes for inter-stage communication are taken from these instead
+        of being exchanged between stages when variable_seq_lengths in the config is True.
     """
     pipeline_model_parallel_size = parallel_state.get_pipeline_model_parallel_world_size()
     if pipeline_model_parallel_size > 1:
@@ -433,6 +438,7 @@ def forward_backward_no_pipelining(
     collect_non_loss_data: bool = False,
     first_val_step: bool = None,
     enable_profile: bool = True,
+    seq_lengths: Optional[List[int]] = None,  # unused
 ):
     """Run forward and backward passes with no pipeline parallelism
     (no inter-stage communication).
@@ -577,6 +583,7 @@ def forward_backward_pipelining_with_interleaving(
     collect_non_loss_data: bool = False,
     first_val_step: bool = None,
     enable_profile: bool = True,
+    seq_lengths: Optional[List[int]] = None,  # unused
 ):
     """Run interleaved 1F1B schedule (model split into model chunks), with
     communication between pipeline stages as needed.
@@ -1318,6 +1325,7 @@ def forward_backward_pipelining_without_interleaving(
     collect_non_loss_data: bool = False,
     first_val_step: bool = None,
     enable_profile: bool = True,
+    seq_lengths: Optional[List[int]] = None,
 ):
     """Run non-interleaved 1F1B schedule, with communication between pipeline
     stages. Returns dictionary with losses if the last stage, empty dict otherwise."""
@@ -1414,6 +1422,39 @@ def forward_backward_pipelining_without_interleaving(
         encoder_decoder_xattn=encoder_decoder_xattn,
     )
 
+    # If the sequence length of every microbatch is known in advance, the tensor shapes are
+    # given per microbatch and need not be exchanged between stages.
+    variable_seq_lengths = config.variable_seq_lengths
+    if seq_lengths is not None:
+        assert len(seq_lengths) == num_microbatches
+        config.variable_seq_lengths = False
+
+    def get_recv_tensor_shapes(microbatch_id):
+        if seq_lengths is None:
+            return recv_tensor_shapes
+        return get_tensor_shapes(
+            rank=rank - 1,
+            model_type=model_type,
+            seq_length=seq_lengths[microbatch_id],
+            micro_batch_size=micro_batch_size,
+            decoder_seq_length=decoder_seq_length,
+            config=config,
+            encoder_decoder_xattn=encoder_decoder_xattn,
+        )
+
+    def get_send_tensor_shapes(microbatch_id):
+        if seq_lengths is None:
+            return send_tensor_shapes
+        return get_tensor_shapes(
+            rank=rank,
+            model_type=model_type,
+            seq_length=seq_lengths[microbatch_id],
+            micro_batch_size=micro_batch_size,
+            decoder_seq_length=decoder_seq_length,
+            config=config,
+            encoder_decoder_xattn=encoder_decoder_xattn,
+        )
+
     # Input, output tensors only need to be saved when doing backward passes
     input_tensors = None
     output_tensors = None
@@ -1435,7 +1476,7 @@ def forward_backward_pipelining_without_interleaving(
         else:
             checkpoint_activations_microbatch = None
 
-        input_tensor = recv_forward(recv_tensor_shapes, config)
+        input_tensor = recv_forward(get_recv_tensor_shapes(i), config)
         output_tensor, num_tokens = forward_step(
             forward_step_func,
             data_iterator,
@@ -1452,7 +1493,7 @@ def forward_backward_pipelining_without_interleaving(
             global_microbatch_id=f"{total_microbatch_id + i}",
             forward_only=forward_only,
         )
-        send_forward(output_tensor, send_tensor_shapes, config)
+        send_forward(output_tensor, get_send_tensor_shapes(i), config)
         total_num_tokens += num_tokens.item()
 
         if not forward_only:
@@ -1464,7 +1505,7 @@ def forward_backward_pipelining_without_interleaving(
     # If all microbatches are run in warmup / cooldown phase, then no need to
     # receive this tensor here.
     if num_microbatches_remaining > 0:
-        input_tensor = recv_forward(recv_tensor_shapes, config)
+        input_tensor = recv_forward(get_recv_tensor_shapes(num_warmup_microbatches), config)
 
     # Run 1F1B in steady state.
     for i in range(num_microbatches_remaining):
@@ -1499,14 +1540,18 @@ def forward_backward_pipelining_without_interleaving(
         total_num_tokens += num_tokens.item()
 
         if forward_only:
-            send_forward(output_tensor, send_tensor_shapes, config)
+            send_forward(output_tensor, get_send_tensor_shapes(i + num_warmup_microbatches), config)
 
             if not last_iteration:
-                input_tensor = recv_forward(recv_tensor_shapes, config)
+                input_tensor = recv_forward(
+                    get_recv_tensor_shapes(i + num_warmup_microbatches + 1), config
+                )
 
         else:
+            # The gradient received here belongs to the i-th microbatch, whose backward pass
+            # runs next.
             output_tensor_grad = send_forward_recv_backward(
-                output_tensor, send_tensor_shapes, config
+                output_tensor, get_send_tensor_shapes(i), config
             )
 
             # Add input_tensor and output_tensor to end of list.
@@ -1531,10 +1576,12 @@ def forward_backward_pipelining_without_interleaving(
 
             if last_iteration:
                 input_tensor = None
-                send_backward(input_tensor_grad, recv_tensor_shapes, config)
+                send_backward(input_tensor_grad, get_recv_tensor_shapes(i), config)
             else:
                 input_tensor = send_backward_recv_forward(
-                    input_tensor_grad, recv_tensor_shapes, config
+                    input_tensor_grad,
+                    get_recv_tensor_shapes(i + num_warmup_microbatches + 1),
+                    config,
                 )
 
     # Run cooldown backward passes.
@@ -1554,13 +1601,17 @@ def forward_backward_pipelining_without_interleaving(
             output_tensor, output_current_microbatch_id = output_tensors.pop(0)
             assert input_current_microbatch_id == output_current_microbatch_id, "Input & output batch id should be the same"
 
-            output_tensor_grad = recv_backward(send_tensor_shapes, config)
+            output_tensor_grad = recv_backward(
+                get_send_tensor_shapes(i + num_microbatches_remaining), config
+            )
 
             input_tensor_grad = backward_step(
                 input_tensor, output_tensor, output_tensor_grad, model_type, config, global_microbatch_id=f"{output_current_microbatch_id}", forward_only=forward_only, enable_profile=enable_profile
             )
 
-            send_backward(input_tensor_grad, recv_tensor_shapes, config)
+            send_backward(
+                input_tensor_grad, get_recv_tensor_shapes(i + num_microbatches_remaining), config
+            )
 
         # Launch any remaining grad reductions.
         if no_sync_context is not None:
@@ -1587,4 +1638,6 @@ def forward_backward_pipelining_without_interleaving(
     if not forward_only:
         total_microbatch_id += num_microbatches
 
+    config.variable_seq_lengths = variable_seq_lengths
+
     return forward_data_store
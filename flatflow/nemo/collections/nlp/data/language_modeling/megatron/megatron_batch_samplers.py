@@ -15,6 +15,8 @@
 # limitations under the License.
 
 import os
+from collections.abc import Sequence
+from typing import Optional
 
 import grpc
 import torch.distributed
@@ -25,7 +27,7 @@ from nemo.collections.nlp.data.language_modeling.megatron.megatron_batch_sampler
 )
 
 from flatflow import sys
-from flatflow.rpc import ControlPlaneClient, run
+from flatflow.rpc import ControlPlaneClient, Mode, run
 from flatflow.torch.utils.data.dataset import Dataset
 
 __all__ = ["MegatronPretrainingBatchSampler"]
@@ -57,6 +59,42 @@ class MegatronPretrainingBatchSampler(BaseMegatronBatchSampler):
         pad_samples_to_global_batch_size (bool, optional): If ``True``, then the sampler will pad (default: ``False``)
         port (int, optional): Port on the master node (rank 0) to be used for initializing
             the communicator server. (default: ``50051``)
+        use_hierarchical_partitioning (bool, optional): If ``True``, then micro-batches are
+            balanced across nodes first and then across the ranks within each node,
+            following the hierarchical gradient reduction. (default: ``False``)
+        pad_to_longest (bool, optional): If ``True``, then the scheduler assumes that samples
+            in each micro-batch are padded to the longest one rather than concatenated,
+            and groups samples of similar sizes together. (default: ``False``)
+        bound_inflight_activations (bool, optional): If ``True``, then micro-batches are
+            ordered to bound the activations held in flight by the 1F1B pipeline schedule
+            instead of being sorted in ascending order of cost. (default: ``False``)
+        offsets (Sequence[int], optional): Storage offset of each sample, e.g., its byte offset
+            in the memory-mapped dataset. If given, samples in each micro-batch are read in
+            order of their offsets. (default: ``None``)
+        shard_ids (Sequence[int], optional): Dataset shard of each sample. (default: ``None``)
+        shard_node_ids (Sequence[int], optional): Node that holds each shard locally, where
+            the node of a global rank is the rank divided by ``LOCAL_WORLD_SIZE``. If given
+            along with ``shard_ids``, samples are exchanged between ranks so that each rank
+            mostly reads local data; this also enables hierarchical partitioning, as the
+            placement of ranks on nodes is required. (default: ``None``)
+        max_balance_penalty (float, optional): The maximum fraction by which the cost of the
+            slowest rank may grow for locality. (default: ``0.0``)
+        bucket_capacities (Sequence[int], optional): Capacities of shape buckets in tokens,
+            in ascending order. If given, each micro-batch is assigned to the smallest bucket
+            that holds it, and :attr:`buckets` holds the bucket of each micro-batch of this
+            rank in the current epoch, so that it can be padded to the bucket capacity to
+            reuse compiled graphs. (default: ``None``)
+        memory_budget (int, optional): Activation memory budget of each rank in bytes.
+            If nonzero, :attr:`recompute` holds the number of layers of each pipeline stage
+            to recompute for each micro-batch of this rank in the current epoch, so that
+            short micro-batches skip activation recomputation. (default: ``0``)
+        forward_only (bool, optional): If ``True``, then the sampler schedules forward passes
+            only, as for validation and test datasets, in a session of the control plane
+            separate from training. The samples left over from a multiple of the
+            data-parallel size are appended to the schedules of the first ranks, and the
+            other ranks take a padding index of ``-1`` instead, so that every rank runs the
+            same number of micro-batches and the losses reduced across data-parallel ranks
+            for each of them stay in step. (default: ``False``)
     .. warning::
         In distributed mode, calling the :meth:`set_epoch` method at
         the beginning of each epoch **before** creating the :class:`DataLoader` iterator
@@ -76,6 +114,16 @@ class MegatronPretrainingBatchSampler(BaseMegatronBatchSampler):
         graph: torch.fx.Graph,
         pad_samples_to_global_batch_size=False,
         port: int = 50051,
+        use_hierarchical_partitioning: bool = False,
+        pad_to_longest: bool = False,
+        bound_inflight_activations: bool = False,
+        offsets: Optional[Sequence[int]] = None,
+        shard_ids: Optional[Sequence[int]] = None,
+        shard_node_ids: Optional[Sequence[int]] = None,
+        max_balance_penalty: float = 0.0,
+        bucket_capacities: Optional[Sequence[int]] = None,
+        memory_budget: int = 0,
+        forward_only: bool = False,
     ) -> None:
         super().__init__(
             total_samples=total_samples,
@@ -93,6 +141,9 @@ class MegatronPretrainingBatchSampler(BaseMegatronBatchSampler):
         self.data_parallel_rank: int = data_parallel_rank
         self.data_parallel_size: int = data_parallel_size
         self.drop_last: bool = drop_last
+        self.bucket_capacities: Optional[Sequence[int]] = bucket_capacities
+        self.memory_budget: int = memory_budget
+        self.forward_only: bool = forward_only
         self.tensor_parallel_world_size: int = parallel_state.get_tensor_model_parallel_world_size()
         self.tensor_parallel_rank: int = parallel_state.get_tensor_model_parallel_rank()
         self.pipeline_parallel_rank: int = parallel_state.get_pipeline_model_parallel_rank()
@@ -106,7 +157,22 @@ class MegatronPretrainingBatchSampler(BaseMegatronBatchSampler):
         self.num_data_parallel_group = self.world_size // (
             self.tensor_parallel_world_size * self.pipeline_parallel_world_size
         )
-        sizes = [sys.getsizeof(self.dataset, index) for index in range(len(self.dataset))]
+        # The scheduler takes a multiple of the data-parallel size; for evaluation, where
+        # every sample counts, the rest are taken by the first ranks unscheduled.
+        self.num_scheduled_samples = len(self.dataset)
+        if forward_only:
+            self.num_scheduled_samples -= len(self.dataset) % data_parallel_size
+        sizes = [sys.getsizeof(self.dataset, index) for index in range(self.num_scheduled_samples)]
+
+        # Each node is identified by the global ranks it hosts, as launched by torchrun.
+        node_ids = None
+        if use_hierarchical_partitioning or shard_node_ids is not None:
+            local_world_size = int(os.getenv("LOCAL_WORLD_SIZE", torch.cuda.device_count()))
+            data_parallel_group = parallel_state.get_data_parallel_group()
+            node_ids = [
+                rank // local_world_size
+                for rank in torch.distributed.get_process_group_ranks(data_parallel_group)
+            ]
 
         addr = os.getenv("MASTER_ADDR")
         channel = grpc.insecure_channel(f"{addr}:{port}")
@@ -115,15 +181,27 @@ class MegatronPretrainingBatchSampler(BaseMegatronBatchSampler):
             run(port, data_parallel_size)
 
         self.schedule = []
-        self.schedule_size = [0]
+        self.schedule_size = [0, 0, 0]
+        self.buckets = []
+        self.recompute = []
         if self.pipeline_parallel_rank == 0 and self.tensor_parallel_rank == 0:
-            self.client = ControlPlaneClient(self.data_parallel_rank, channel)
+            self.client = ControlPlaneClient(self.data_parallel_rank, channel, mode=Mode.EVAL if forward_only else Mode.TRAIN)
             if self.data_parallel_rank == 0:
                 self.client.Init(
                     global_batch_size,
                     micro_batch_size,
                     graph,
                     sizes,
+                    node_ids=node_ids,
+                    pad_to_longest=pad_to_longest,
+                    pipeline_parallel_world_size=self.pipeline_parallel_world_size,
+                    bound_inflight_activations=bound_inflight_activations,
+                    offsets=offsets,
+                    shard_ids=shard_ids,
+                    shard_node_ids=shard_node_ids,
+                    max_balance_penalty=max_balance_penalty,
+                    bucket_capacities=bucket_capacities,
+                    memory_budget=memory_budget,
                 )
 
     def set_epoch(self, epoch: int) -> None:
@@ -136,7 +214,7 @@ class MegatronPretrainingBatchSampler(BaseMegatronBatchSampler):
         self.epoch = epoch
 
     def __iter__(self):
-        indices = list(range(len(self.dataset)))
+        indices = list(range(self.num_scheduled_samples))
         model_parallel_group = parallel_state.get_model_parallel_group() 
         model_parallel_src_rank = torch.distributed.get_process_group_ranks(model_parallel_group)[0]
         is_model_parallel_src = (self.global_rank == model_parallel_src_rank)
@@ -144,14 +222,41 @@ class MegatronPretrainingBatchSampler(BaseMegatronBatchSampler):
         # receive the reordered computation schedule from the control plane
         if is_model_parallel_src:
             self.schedule = self.client.Broadcast(self.epoch, indices)
-            self.schedule_size = [len(self.schedule)]
+            self.buckets = self.client.response.BucketsAsNumpy().tolist()
+            self.recompute = self.client.response.RecomputeAsNumpy().tolist()
+            self.schedule_size = [
+                len(self.schedule),
+                len(self.buckets),
+                len(self.recompute),
+            ]
             self.epoch += 1
 
         torch.distributed.broadcast_object_list(self.schedule_size, src=model_parallel_src_rank, group=model_parallel_group)
         if not is_model_parallel_src:
             self.schedule = [0] * self.schedule_size[0]
+            self.buckets = [0] * self.schedule_size[1]
+            self.recompute = [0] * self.schedule_size[2]
         torch.distributed.broadcast_object_list(self.schedule, src=model_parallel_src_rank, group=model_parallel_group)
 
+        # Every rank in the model-parallel group pads micro-batches to the same buckets.
+        if self.bucket_capacities is not None:
+            torch.distributed.broadcast_object_list(
+                self.buckets, src=model_parallel_src_rank, group=model_parallel_group
+            )
+
+        # Every pipeline stage recomputes its own layers for the same micro-batches.
+        if self.memory_budget != 0:
+            torch.distributed.broadcast_object_list(
+                self.recompute, src=model_parallel_src_rank, group=model_parallel_group
+            )
+
+        # Every rank takes one more index if any samples are left over, padding if none
+        # is left for it, so that the batches below are cut at the same points.
+        if self.forward_only and self.num_scheduled_samples < len(self.dataset):
+            leftover = self.num_scheduled_samples + self.data_parallel_rank
+            self.schedule = list(self.schedule) + [leftover if leftover < len(self.dataset) else -1]
+            self.schedule_size[0] += 1
+
         batch = []
         for idx in range(self.schedule_size[0]):
             batch.append(self.schedule[idx])
@@ -168,5 +273,5 @@ class MegatronPretrainingBatchSampler(BaseMegatronBatchSampler):
         self.consumed_samples = 0
 
     def __del__(self) -> None:
-        if hasattr(self, "client") and self.client.rank == 0:
+        if hasattr(self, "client") and self.client.rank == 0 and not self.forward_only:
             self.client.Finalize()
@@ -118,6 +118,8 @@ class MegatronGPTSFTModel(NLPAdapterModelMixin, MegatronGPTModel):
         self.init_global_step = 0
 
         self.use_flatflow = cfg.get("use_flatflow", True)
+        # Evaluation is scheduled in a forward-only session of its own, if enabled.
+        self.use_flatflow_eval = self.use_flatflow and cfg.get("use_flatflow_eval", False)
         self.enable_profile = cfg.get("enable_profile", True)
 
         if self.use_flatflow:
@@ -301,8 +303,8 @@ class MegatronGPTSFTModel(NLPAdapterModelMixin, MegatronGPTModel):
 
         dataset_kwargs = {}
         for file_path, num_samples in zip(data_cfg.file_names, num_train_samples_per_dataset):
-            # flatflow is applied only for training
-            if self.use_flatflow and is_train:
+            # flatflow is applied for evaluation only if enabled
+            if (self.use_flatflow and is_train) or self.use_flatflow_eval:
                 dataset_cls = flatflow.nemo.collections.nlp.data.language_modeling.megatron.GPTSFTDataset
             elif self.cfg.data.get("chat", False):
                 dataset_cls = GPTSFTChatDataset
@@ -407,6 +409,7 @@ class MegatronGPTSFTModel(NLPAdapterModelMixin, MegatronGPTModel):
             # Pass only torch.Tensor to prevent errors when process get_iterator_k_split()
             batch = {k: v for k, v in batch.items() if isinstance(v, torch.Tensor)}
             _, seq_length = batch['tokens'].shape
+            seq_lengths = None
             data_iter = get_iterator_k_split(batch, num_microbatches)
         else:
             # Using flatflow, the 'stack-dim' batch size is always 1 for a microbatch. Instead, the `get_micro_batch_size()`
@@ -425,6 +428,8 @@ class MegatronGPTSFTModel(NLPAdapterModelMixin, MegatronGPTModel):
                 token_count_avg = sum([mb['token_count'] for mb in batch]) / (len(batch) * get_micro_batch_size())
             # seq_length is required but will be ignored. See megatron...schedules.get_forward_backword_func's comment(docstring).
             seq_length = sum([mb['tokens'].shape[1] for mb in batch])
+            # The per-microbatch sequence lengths let pipeline stages skip exchanging tensor shapes.
+            seq_lengths = [mb['tokens'].shape[1] for mb in batch]
             data_iter = itertools.chain(batch)
 
         if log_token_counts:
@@ -457,6 +462,7 @@ class MegatronGPTSFTModel(NLPAdapterModelMixin, MegatronGPTModel):
             micro_batch_size=micro_batch_size,
             first_val_step=first_val_step,
             enable_profile=self.enable_profile,
+            seq_lengths=seq_lengths,
         )
 
         non_loss_tensors = {}
@@ -907,7 +913,7 @@ class MegatronGPTSFTModel(NLPAdapterModelMixin, MegatronGPTModel):
         else:
             collate_fn = dataset.collate_fn
 
-        if self.use_flatflow and is_train:
+        if (self.use_flatflow and is_train) or self.use_flatflow_eval:
 
             batch_sampler = flatflow.nemo.collections.nlp.data.language_modeling.megatron.MegatronPretrainingBatchSampler(
                 total_samples=len(dataset),
@@ -920,6 +926,7 @@ class MegatronGPTSFTModel(NLPAdapterModelMixin, MegatronGPTModel):
                 pad_samples_to_global_batch_size=not data_cfg.drop_last,
                 dataset=dataset,
                 graph=_export(self.model_path),
+                forward_only=not is_train,
             )
             data_loader_cls = flatflow.torch.utils.data.DataLoader
         else:
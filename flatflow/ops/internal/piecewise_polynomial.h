@@ -0,0 +1,210 @@
+// Copyright 2025 The FlatFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FLATFLOW_OPS_INTERNAL_PIECEWISE_POLYNOMIAL_H_
+#define FLATFLOW_OPS_INTERNAL_PIECEWISE_POLYNOMIAL_H_
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+#include "flatflow/ops/internal/polynomial.h"
+#include "flatflow/types.h"
+
+namespace flatflow {
+namespace internal {
+
+// piecewise_polynomial<>
+//
+// Represents a piecewise function of polynomials of degree two, where each
+// piece applies from its breakpoint up to the breakpoint of the next piece.
+// Costs of blocked or windowed kernels such as sliding window attention change
+// regime at a size threshold, being quadratic below the threshold and linear
+// above it, which cannot be expressed as a single polynomial.
+//
+// The first piece always starts at the lowest value of `T`, so that
+// a piecewise polynomial without any breakpoint is equivalent to a polynomial.
+template <typename T>
+  requires flatflow::arithmetic<T>
+class piecewise_polynomial {
+ public:
+  using value_type = typename polynomial<T>::value_type;
+  using piece_type = std::pair<T, polynomial<T>>;
+  using size_type = typename std::vector<piece_type>::size_type;
+
+  // Constructors and assignment operators
+  //
+  // `piecewise_polynomial<>` supports construction from a polynomial and from
+  // two polynomials separated by a breakpoint, as well as the copy/move
+  // constructors and assignment operators.
+  piecewise_polynomial()
+      : pieces_{{std::numeric_limits<T>::lowest(), polynomial<T>()}} {}
+
+  piecewise_polynomial(const polynomial<T> &poly)
+      : pieces_{{std::numeric_limits<T>::lowest(), poly}} {}
+
+  piecewise_polynomial(const polynomial<T> &lower, T breakpoint,
+                       const polynomial<T> &upper)
+      : pieces_{{std::numeric_limits<T>::lowest(), lower},
+                {breakpoint, upper}} {}
+
+  piecewise_polynomial(const piecewise_polynomial &other) = default;
+
+  piecewise_polynomial &operator=(const piecewise_polynomial &other) = default;
+
+  piecewise_polynomial(piecewise_polynomial &&other) = default;
+
+  piecewise_polynomial &operator=(piecewise_polynomial &&other) = default;
+
+  // Accessors
+  //
+  // `piecewise_polynomial<>` provides access to the underlying pieces, each of
+  // which is a pair of its breakpoint and polynomial.
+  size_type size() const noexcept { return pieces_.size(); }
+
+  std::vector<piece_type> &pieces() { return pieces_; }
+
+  const std::vector<piece_type> &pieces() const { return pieces_; }
+
+  piece_type &operator[](size_type index) { return pieces_[index]; }
+
+  const piece_type &operator[](size_type index) const {
+    return pieces_[index];
+  }
+
+  // Operators
+  //
+  // `piecewise_polynomial<>` supports addition and scalar arithmetic, which
+  // are sufficient to sum up the costs of operators.
+  template <typename U>
+    requires flatflow::arithmetic<U>
+  value_type operator()(U value) const {
+    return evaluate_piecewise_polynomial(*this, value);
+  }
+
+  piecewise_polynomial operator+(const piecewise_polynomial &other) const {
+    auto p = *this;
+    p += other;
+    return p;
+  }
+
+  // Both operands are merged at the union of their breakpoints, where each
+  // piece of the sum is the sum of the pieces that apply from it.
+  piecewise_polynomial &operator+=(const piecewise_polynomial &other) {
+    auto pieces = std::vector<piece_type>();
+    pieces.reserve(pieces_.size() + other.size());
+
+    auto lhs = pieces_.cbegin();
+    auto rhs = other.pieces().cbegin();
+    auto lpoly = polynomial<T>();
+    auto rpoly = polynomial<T>();
+
+    while (lhs != pieces_.cend() || rhs != other.pieces().cend()) {
+      const auto breakpoint =
+          rhs == other.pieces().cend() ||
+                  (lhs != pieces_.cend() && lhs->first <= rhs->first)
+              ? lhs->first
+              : rhs->first;
+      if (lhs != pieces_.cend() && lhs->first == breakpoint) {
+        lpoly = (lhs++)->second;
+      }
+      if (rhs != other.pieces().cend() && rhs->first == breakpoint) {
+        rpoly = (rhs++)->second;
+      }
+      pieces.emplace_back(breakpoint, lpoly + rpoly);
+    }
+
+    pieces_ = std::move(pieces);
+    return *this;
+  }
+
+  piecewise_polynomial operator-(value_type value) const {
+    auto p = *this;
+    p -= value;
+    return p;
+  }
+
+  piecewise_polynomial &operator-=(value_type value) {
+    for (auto &[breakpoint, poly] : pieces_) {
+      poly -= value;
+    }
+    return *this;
+  }
+
+  piecewise_polynomial operator*(value_type value) const {
+    auto p = *this;
+    p *= value;
+    return p;
+  }
+
+  piecewise_polynomial &operator*=(value_type value) {
+    for (auto &[breakpoint, poly] : pieces_) {
+      poly *= value;
+    }
+    return *this;
+  }
+
+  bool operator==(const piecewise_polynomial &other) const {
+    return pieces_ == other.pieces();
+  }
+
+  bool operator!=(const piecewise_polynomial &other) const {
+    return pieces_ != other.pieces();
+  }
+
+  // piecewise_polynomial::normalize()
+  //
+  // Reduces coefficients across all the pieces.
+  piecewise_polynomial &normalize() {
+    auto divisor = static_cast<value_type>(0);
+    for (const auto &[breakpoint, poly] : pieces_) {
+      divisor = std::gcd(std::gcd(std::gcd(divisor, poly[0]), poly[1]),
+                         poly[2]);
+    }
+    if (divisor != 0) {
+      for (auto &[breakpoint, poly] : pieces_) {
+        poly /= divisor;
+      }
+    }
+    return *this;
+  }
+
+ protected:
+  std::vector<piece_type> pieces_;
+};
+
+// evaluate_piecewise_polynomial()
+//
+// Evaluates the piece of a given piecewise polynomial that applies to the given
+// value, found by binary search over the breakpoints.
+template <typename T, typename U>
+  requires(flatflow::arithmetic<T> && flatflow::arithmetic<U>)
+T evaluate_piecewise_polynomial(const piecewise_polynomial<T> &poly,
+                                U value) {
+  const auto &pieces = poly.pieces();
+  const auto it = std::upper_bound(
+      std::next(pieces.cbegin()), pieces.cend(), value,
+      [](U value, const auto &piece) {
+        return static_cast<T>(value) < piece.first;
+      });
+  return evaluate_polynomial(std::prev(it)->second, value);
+}
+
+}  // namespace internal
+}  // namespace flatflow
+
+#endif  // FLATFLOW_OPS_INTERNAL_PIECEWISE_POLYNOMIAL_H_
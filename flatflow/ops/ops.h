@@ -17,8 +17,15 @@
 
 #include <omp.h>
 
+#include <algorithm>
+#include <cctype>
 #include <cstdint>
 #include <functional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/log/check.h"
@@ -28,6 +35,7 @@
 #include "flatbuffers/vector.h"
 
 #include "flatflow/ops/graph_generated.h"
+#include "flatflow/ops/internal/piecewise_polynomial.h"
 #include "flatflow/ops/internal/polynomial.h"
 #include "flatflow/ops/node_generated.h"
 #include "flatflow/ops/operator_generated.h"
@@ -53,6 +61,169 @@ internal::polynomial<OperatorRegistryBase::value_type> symbolic_trace_impl(
     const flatbuffers::Vector<flatbuffers::Offset<TensorMetadata>> *,
     const TensorMetadata *) = delete;
 
+// flatflow::symbolic_trace_impl<_LOG_SOFTMAX>()
+//
+// Implements a symbolic transformation for `_log_softmax`.
+//
+// func: _log_softmax(Tensor self, int dim, bool half_to_float) -> Tensor
+template <>
+internal::polynomial<OperatorRegistryBase::value_type>
+symbolic_trace_impl<Operator::_LOG_SOFTMAX>(
+    [[maybe_unused]] const flatbuffers::Vector<
+        flatbuffers::Offset<TensorMetadata>> *args,
+    const TensorMetadata *meta) {
+  // _log_softmax applies the softmax function followed by the logarithm to
+  // `self`.
+  //
+  // NOTE: As in the case of _softmax, _log_softmax requires five FLOPs for
+  // each element; it subtracts the log-sum-exp instead of dividing by
+  // the sum of exponentials.
+  CHECK_NE(meta, nullptr);
+
+  auto shape = meta->shape();
+  CHECK_NE(shape, nullptr);
+
+  auto poly = internal::polynomial<OperatorRegistryBase::value_type>(5);
+
+  for (flatbuffers::uoffset_t index = 0; index < shape->size(); ++index) {
+    CHECK_NE(shape->Get(index), nullptr);
+    CHECK_NE(shape->Get(index)->data(), nullptr);
+    poly *= internal::polynomial<OperatorRegistryBase::value_type>(
+        shape->Get(index)->data()->Get(0), shape->Get(index)->data()->Get(1));
+  }
+
+  return poly;
+}
+
+// flatflow::symbolic_trace_attention()
+//
+// Returns the FLOPs of scaled dot product attention over the given query,
+// key and value tensors, shared by the fused attention operators below.
+// If the query is a (b x h x n x d) tensor and the key and value are
+// (b x h x m x d) and (b x h x m x e) tensors, the attention scores take
+// 2 x b x h x n x m x d FLOPs, softmax over the scores takes five FLOPs for
+// each score, and the weighted sum of values takes 2 x b x h x n x m x e FLOPs.
+// An additive attention bias, if any, takes one more FLOP for each score.
+//
+// NOTE: Whether the attention is causal is given as a scalar argument, which
+// is not recorded in the graph; fused kernels skip the masked half of the
+// scores in that case. We count every score as in the decomposed `bmm` and
+// `_softmax` nodes, so that models compare equally with or without fusion.
+internal::polynomial<OperatorRegistryBase::value_type>
+symbolic_trace_attention(
+    const flatbuffers::Vector<flatbuffers::Offset<TensorMetadata>> *args,
+    bool has_bias) {
+  CHECK_NE(args, nullptr);
+  CHECK_LE(static_cast<flatbuffers::uoffset_t>(has_bias ? 4 : 3),
+           args->size());
+
+  CHECK_NE(args->Get(0), nullptr);
+  auto query = args->Get(0)->shape();
+  CHECK_NE(query, nullptr);
+  CHECK_EQ(query->size(), static_cast<flatbuffers::uoffset_t>(4));
+
+  CHECK_NE(args->Get(1), nullptr);
+  auto key = args->Get(1)->shape();
+  CHECK_NE(key, nullptr);
+  CHECK_EQ(key->size(), static_cast<flatbuffers::uoffset_t>(4));
+
+  CHECK_NE(args->Get(2), nullptr);
+  auto value = args->Get(2)->shape();
+  CHECK_NE(value, nullptr);
+  CHECK_EQ(value->size(), static_cast<flatbuffers::uoffset_t>(4));
+
+  auto b = query->Get(0);
+  CHECK_NE(b, nullptr);
+  CHECK_NE(b->data(), nullptr);
+  auto h = query->Get(1);
+  CHECK_NE(h, nullptr);
+  CHECK_NE(h->data(), nullptr);
+  auto n = query->Get(2);
+  CHECK_NE(n, nullptr);
+  CHECK_NE(n->data(), nullptr);
+  auto d = query->Get(3);
+  CHECK_NE(d, nullptr);
+  CHECK_NE(d->data(), nullptr);
+
+  // The last dimension of the query and the key must be symbolically
+  // identical.
+  CHECK_NE(key->Get(3), nullptr);
+  CHECK_NE(key->Get(3)->data(), nullptr);
+  CHECK_EQ(d->data()->Get(0), key->Get(3)->data()->Get(0));
+  CHECK_EQ(d->data()->Get(1), key->Get(3)->data()->Get(1));
+
+  auto m = key->Get(2);
+  CHECK_NE(m, nullptr);
+  CHECK_NE(m->data(), nullptr);
+  auto e = value->Get(3);
+  CHECK_NE(e, nullptr);
+  CHECK_NE(e->data(), nullptr);
+
+  const auto scores = internal::polynomial<OperatorRegistryBase::value_type>(
+                          b->data()->Get(0), b->data()->Get(1)) *
+                      internal::polynomial<OperatorRegistryBase::value_type>(
+                          h->data()->Get(0), h->data()->Get(1)) *
+                      internal::polynomial<OperatorRegistryBase::value_type>(
+                          n->data()->Get(0), n->data()->Get(1)) *
+                      internal::polynomial<OperatorRegistryBase::value_type>(
+                          m->data()->Get(0), m->data()->Get(1));
+
+  const auto flops_per_score =
+      (internal::polynomial<OperatorRegistryBase::value_type>(
+           d->data()->Get(0), d->data()->Get(1)) +
+       internal::polynomial<OperatorRegistryBase::value_type>(
+           e->data()->Get(0), e->data()->Get(1))) *
+          2 +
+      internal::polynomial<OperatorRegistryBase::value_type>(has_bias ? 6 : 5);
+
+  return scores * flops_per_score;
+}
+
+// flatflow::symbolic_trace_impl<_SCALED_DOT_PRODUCT_EFFICIENT_ATTENTION>()
+//
+// Implements a symbolic transformation for
+// `_scaled_dot_product_efficient_attention`.
+//
+// func: _scaled_dot_product_efficient_attention(Tensor query, Tensor key,
+//           Tensor value, Tensor? attn_bias, bool compute_log_sumexp,
+//           float dropout_p=0.0, bool is_causal=False, *,
+//           float? scale=None) -> (Tensor output, Tensor log_sumexp,
+//                                  Tensor philox_seed, Tensor philox_offset)
+template <>
+internal::polynomial<OperatorRegistryBase::value_type>
+symbolic_trace_impl<Operator::_SCALED_DOT_PRODUCT_EFFICIENT_ATTENTION>(
+    const flatbuffers::Vector<flatbuffers::Offset<TensorMetadata>> *args,
+    [[maybe_unused]] const TensorMetadata *meta) {
+  // _scaled_dot_product_efficient_attention computes attention in a single
+  // memory-efficient kernel. `attn_bias` is recorded as the fourth argument
+  // if given.
+  CHECK_NE(args, nullptr);
+  return symbolic_trace_attention(
+      args, static_cast<flatbuffers::uoffset_t>(4) <= args->size());
+}
+
+// flatflow::symbolic_trace_impl<_SCALED_DOT_PRODUCT_FLASH_ATTENTION>()
+//
+// Implements a symbolic transformation for
+// `_scaled_dot_product_flash_attention`.
+//
+// func: _scaled_dot_product_flash_attention(Tensor query, Tensor key,
+//           Tensor value, float dropout_p=0.0, bool is_causal=False,
+//           bool return_debug_mask=False, *, float? scale=None)
+//           -> (Tensor output, Tensor logsumexp, Tensor cum_seq_q,
+//               Tensor cum_seq_k, SymInt max_q, SymInt max_k,
+//               Tensor philox_seed, Tensor philox_offset,
+//               Tensor debug_attn_mask)
+template <>
+internal::polynomial<OperatorRegistryBase::value_type>
+symbolic_trace_impl<Operator::_SCALED_DOT_PRODUCT_FLASH_ATTENTION>(
+    const flatbuffers::Vector<flatbuffers::Offset<TensorMetadata>> *args,
+    [[maybe_unused]] const TensorMetadata *meta) {
+  // _scaled_dot_product_flash_attention computes attention in a single
+  // FlashAttention kernel without materializing the attention scores.
+  return symbolic_trace_attention(args, false);
+}
+
 // flatflow::symbolic_trace_impl<_SOFTMAX>()
 //
 // Implements a symbolic transformation for `_softmax`.
@@ -156,6 +327,66 @@ symbolic_trace_impl<Operator::ADD_TENSOR>(
   return poly;
 }
 
+// flatflow::symbolic_trace_impl<ADDMM>()
+//
+// Implements a symbolic transformation for `addmm`.
+//
+// func: addmm(Tensor self, Tensor mat1, Tensor mat2, *, Scalar beta=1,
+//             Scalar alpha=1) -> Tensor
+template <>
+internal::polynomial<OperatorRegistryBase::value_type>
+symbolic_trace_impl<Operator::ADDMM>(
+    const flatbuffers::Vector<flatbuffers::Offset<TensorMetadata>> *args,
+    [[maybe_unused]] const TensorMetadata *meta) {
+  CHECK_NE(args, nullptr);
+  CHECK_EQ(args->size(), static_cast<flatbuffers::uoffset_t>(3));
+
+  CHECK_NE(args->Get(1), nullptr);
+  auto shape1 = args->Get(1)->shape();
+  CHECK_NE(shape1, nullptr);
+  CHECK_EQ(shape1->size(), static_cast<flatbuffers::uoffset_t>(2));
+
+  CHECK_NE(args->Get(2), nullptr);
+  auto shape2 = args->Get(2)->shape();
+  CHECK_NE(shape2, nullptr);
+  CHECK_EQ(shape2->size(), static_cast<flatbuffers::uoffset_t>(2));
+
+  // addmm performs a matrix multiplication of the matrices `mat1` and `mat2`
+  // and adds `self` to the result, as linear layers with bias do. If `mat1`
+  // is a (n x m) tensor and `mat2` is a (m x p) tensor, then it produces
+  // a (n x p) tensor with 2 x n x m x p FLOPs for the product and n x p FLOPs
+  // for the addition; the scaling by `alpha` and `beta` is ignored.
+  auto n = shape1->Get(0);
+  CHECK_NE(n, nullptr);
+  CHECK_NE(n->data(), nullptr);
+  auto m = shape1->Get(1);
+  CHECK_NE(m, nullptr);
+  CHECK_NE(m->data(), nullptr);
+
+  // The last dimension of `mat1` and the first dimension of `mat2` must be
+  // symbolically identical.
+  CHECK_NE(shape2->Get(0), nullptr);
+  CHECK_NE(shape2->Get(0)->data(), nullptr);
+  CHECK_EQ(m->data()->Get(0), shape2->Get(0)->data()->Get(0));
+  CHECK_EQ(m->data()->Get(1), shape2->Get(0)->data()->Get(1));
+
+  auto p = shape2->Get(1);
+  CHECK_NE(p, nullptr);
+  CHECK_NE(p->data(), nullptr);
+
+  const auto poly =
+      internal::polynomial<OperatorRegistryBase::value_type>(
+          n->data()->Get(0), n->data()->Get(1)) *
+      internal::polynomial<OperatorRegistryBase::value_type>(
+          p->data()->Get(0), p->data()->Get(1)) *
+      (internal::polynomial<OperatorRegistryBase::value_type>(
+           m->data()->Get(0), m->data()->Get(1)) *
+           2 +
+       internal::polynomial<OperatorRegistryBase::value_type>(1));
+
+  return poly;
+}
+
 // flatflow::symbolic_trace_impl<ARANGE>()
 //
 // Implements a symbolic transformation for `arange`.
@@ -189,6 +420,80 @@ symbolic_trace_impl<Operator::ARANGE_START>(
   return internal::polynomial<OperatorRegistryBase::value_type>();
 }
 
+// flatflow::symbolic_trace_impl<BADDBMM>()
+//
+// Implements a symbolic transformation for `baddbmm`.
+//
+// func: baddbmm(Tensor self, Tensor batch1, Tensor batch2, *, Scalar beta=1,
+//               Scalar alpha=1) -> Tensor
+template <>
+internal::polynomial<OperatorRegistryBase::value_type>
+symbolic_trace_impl<Operator::BADDBMM>(
+    const flatbuffers::Vector<flatbuffers::Offset<TensorMetadata>> *args,
+    [[maybe_unused]] const TensorMetadata *meta) {
+  CHECK_NE(args, nullptr);
+  CHECK_EQ(args->size(), static_cast<flatbuffers::uoffset_t>(3));
+
+  CHECK_NE(args->Get(1), nullptr);
+  auto shape1 = args->Get(1)->shape();
+  CHECK_NE(shape1, nullptr);
+  CHECK_EQ(shape1->size(), static_cast<flatbuffers::uoffset_t>(3));
+
+  CHECK_NE(args->Get(2), nullptr);
+  auto shape2 = args->Get(2)->shape();
+  CHECK_NE(shape2, nullptr);
+  CHECK_EQ(shape2->size(), static_cast<flatbuffers::uoffset_t>(3));
+
+  // baddbmm performs a batch matrix-matrix product of matrices `batch1` and
+  // `batch2` and adds `self` to the result, as the attention scores of some
+  // models with ALiBi do. If `batch1` is a (b x n x m) tensor and `batch2` is
+  // a (b x m x p) tensor, then it produces a (b x n x p) tensor with
+  // 2 x b x n x m x p FLOPs for the product and b x n x p FLOPs for
+  // the addition.
+  auto b = shape1->Get(0);
+  CHECK_NE(b, nullptr);
+  CHECK_NE(b->data(), nullptr);
+
+  // The first dimension of `batch1` and `batch2` must be symbolically
+  // identical.
+  CHECK_NE(shape2->Get(0), nullptr);
+  CHECK_NE(shape2->Get(0)->data(), nullptr);
+  CHECK_EQ(b->data()->Get(0), shape2->Get(0)->data()->Get(0));
+  CHECK_EQ(b->data()->Get(1), shape2->Get(0)->data()->Get(1));
+
+  auto n = shape1->Get(1);
+  CHECK_NE(n, nullptr);
+  CHECK_NE(n->data(), nullptr);
+  auto m = shape1->Get(2);
+  CHECK_NE(m, nullptr);
+  CHECK_NE(m->data(), nullptr);
+
+  // The last dimension of `batch1` and the middle dimension of `batch2` must
+  // be symbolically identical.
+  CHECK_NE(shape2->Get(1), nullptr);
+  CHECK_NE(shape2->Get(1)->data(), nullptr);
+  CHECK_EQ(m->data()->Get(0), shape2->Get(1)->data()->Get(0));
+  CHECK_EQ(m->data()->Get(1), shape2->Get(1)->data()->Get(1));
+
+  auto p = shape2->Get(2);
+  CHECK_NE(p, nullptr);
+  CHECK_NE(p->data(), nullptr);
+
+  const auto poly =
+      internal::polynomial<OperatorRegistryBase::value_type>(
+          b->data()->Get(0), b->data()->Get(1)) *
+      internal::polynomial<OperatorRegistryBase::value_type>(
+          n->data()->Get(0), n->data()->Get(1)) *
+      internal::polynomial<OperatorRegistryBase::value_type>(
+          p->data()->Get(0), p->data()->Get(1)) *
+      (internal::polynomial<OperatorRegistryBase::value_type>(
+           m->data()->Get(0), m->data()->Get(1)) *
+           2 +
+       internal::polynomial<OperatorRegistryBase::value_type>(1));
+
+  return poly;
+}
+
 // flatflow::symbolic_trace_impl<BMM>()
 //
 // Implements a symbolic transformation for `bmm`.
@@ -357,6 +662,41 @@ symbolic_trace_impl<Operator::FULL>(
   return internal::polynomial<OperatorRegistryBase::value_type>();
 }
 
+// flatflow::symbolic_trace_impl<GELU>()
+//
+// Implements a symbolic transformation for `gelu`.
+//
+// func: gelu(Tensor self, *, str approximate='none') -> Tensor
+template <>
+internal::polynomial<OperatorRegistryBase::value_type>
+symbolic_trace_impl<Operator::GELU>(
+    [[maybe_unused]] const flatbuffers::Vector<
+        flatbuffers::Offset<TensorMetadata>> *args,
+    const TensorMetadata *meta) {
+  // gelu applies the Gaussian error linear unit (GELU) function to `self`
+  // in element-wise.
+  //
+  // NOTE: The tanh approximation of gelu, i.e.,
+  // 0.5 x (1 + tanh(sqrt(2 / pi) (x + 0.044715 x^3))), requires eight FLOPs
+  // for each element, counting tanh as one as we do for the exponential in
+  // silu. The exact form with erf is approximated likewise.
+  CHECK_NE(meta, nullptr);
+
+  auto shape = meta->shape();
+  CHECK_NE(shape, nullptr);
+
+  auto poly = internal::polynomial<OperatorRegistryBase::value_type>(8);
+
+  for (flatbuffers::uoffset_t index = 0; index < shape->size(); ++index) {
+    CHECK_NE(shape->Get(index), nullptr);
+    CHECK_NE(shape->Get(index)->data(), nullptr);
+    poly *= internal::polynomial<OperatorRegistryBase::value_type>(
+        shape->Get(index)->data()->Get(0), shape->Get(index)->data()->Get(1));
+  }
+
+  return poly;
+}
+
 // flatflow::symbolic_trace_impl<GT_TENSOR>()
 //
 // Implements a symbolic transformation for `gt.Tensor`.
@@ -372,6 +712,54 @@ symbolic_trace_impl<Operator::GT_TENSOR>(
   return internal::polynomial<OperatorRegistryBase::value_type>();
 }
 
+// flatflow::symbolic_trace_impl<INDEX_SELECT>()
+//
+// Implements a symbolic transformation for `index_select`.
+//
+// func: index_select(Tensor self, int dim, Tensor index) -> Tensor
+template <>
+internal::polynomial<OperatorRegistryBase::value_type>
+symbolic_trace_impl<Operator::INDEX_SELECT>(
+    [[maybe_unused]] const flatbuffers::Vector<
+        flatbuffers::Offset<TensorMetadata>> *args,
+    [[maybe_unused]] const TensorMetadata *meta) {
+  // index_select gathers the entries of `self` along `dim` at `index`,
+  // so technically it has zero FLOPs.
+  return internal::polynomial<OperatorRegistryBase::value_type>();
+}
+
+// flatflow::symbolic_trace_impl<MASKED_FILL_SCALAR>()
+//
+// Implements a symbolic transformation for `masked_fill.Scalar`.
+//
+// func: masked_fill.Scalar(Tensor self, Tensor mask, Scalar value) -> Tensor
+template <>
+internal::polynomial<OperatorRegistryBase::value_type>
+symbolic_trace_impl<Operator::MASKED_FILL_SCALAR>(
+    [[maybe_unused]] const flatbuffers::Vector<
+        flatbuffers::Offset<TensorMetadata>> *args,
+    [[maybe_unused]] const TensorMetadata *meta) {
+  // masked_fill.Scalar selects between `self` and `value` by `mask` in
+  // element-wise, so it has zero FLOPs as gt.Tensor does.
+  return internal::polynomial<OperatorRegistryBase::value_type>();
+}
+
+// flatflow::symbolic_trace_impl<MASKED_FILL_TENSOR>()
+//
+// Implements a symbolic transformation for `masked_fill.Tensor`.
+//
+// func: masked_fill.Tensor(Tensor self, Tensor mask, Tensor value) -> Tensor
+template <>
+internal::polynomial<OperatorRegistryBase::value_type>
+symbolic_trace_impl<Operator::MASKED_FILL_TENSOR>(
+    [[maybe_unused]] const flatbuffers::Vector<
+        flatbuffers::Offset<TensorMetadata>> *args,
+    [[maybe_unused]] const TensorMetadata *meta) {
+  // masked_fill.Tensor is masked_fill.Scalar with a zero-dimensional `value`,
+  // so it has zero FLOPs.
+  return internal::polynomial<OperatorRegistryBase::value_type>();
+}
+
 // flatflow::symbolic_trace_impl<MEAN_DIM>()
 //
 // Implements a symbolic transformation for `mean.dim`.
@@ -524,6 +912,49 @@ symbolic_trace_impl<Operator::MUL_TENSOR>(
   return poly;
 }
 
+// flatflow::symbolic_trace_impl<NATIVE_LAYER_NORM>()
+//
+// Implements a symbolic transformation for `native_layer_norm`.
+//
+// func: native_layer_norm(Tensor input, SymInt[] normalized_shape,
+//                         Tensor? weight, Tensor? bias,
+//                         float eps) -> (Tensor, Tensor, Tensor)
+template <>
+internal::polynomial<OperatorRegistryBase::value_type>
+symbolic_trace_impl<Operator::NATIVE_LAYER_NORM>(
+    const flatbuffers::Vector<flatbuffers::Offset<TensorMetadata>> *args,
+    [[maybe_unused]] const TensorMetadata *meta) {
+  // native_layer_norm normalizes `input` over the trailing dimensions given by
+  // `normalized_shape`, then scales and shifts the result by `weight` and
+  // `bias` if given.
+  //
+  // NOTE: Computing the mean takes one FLOP for each element, the variance
+  // three more (subtraction, square and addition), and normalization two more
+  // (subtraction and multiplication by the reciprocal standard deviation);
+  // the affine transformation takes one FLOP for each of `weight` and `bias`.
+  // Since this returns the mean and the reciprocal standard deviation as well,
+  // the output shape is taken from `input`.
+  CHECK_NE(args, nullptr);
+  CHECK_LE(static_cast<flatbuffers::uoffset_t>(1), args->size());
+  CHECK_LE(args->size(), static_cast<flatbuffers::uoffset_t>(3));
+
+  CHECK_NE(args->Get(0), nullptr);
+  auto shape = args->Get(0)->shape();
+  CHECK_NE(shape, nullptr);
+
+  auto poly =
+      internal::polynomial<OperatorRegistryBase::value_type>(5 + args->size());
+
+  for (flatbuffers::uoffset_t index = 0; index < shape->size(); ++index) {
+    CHECK_NE(shape->Get(index), nullptr);
+    CHECK_NE(shape->Get(index)->data(), nullptr);
+    poly *= internal::polynomial<OperatorRegistryBase::value_type>(
+        shape->Get(index)->data()->Get(0), shape->Get(index)->data()->Get(1));
+  }
+
+  return poly;
+}
+
 // flatflow::symbolic_trace_impl<NEG>()
 //
 // Implements a symbolic transformation for `neg`.
@@ -755,6 +1186,94 @@ symbolic_trace_impl<Operator::VIEW>(
   return internal::polynomial<OperatorRegistryBase::value_type>();
 }
 
+// flatflow::symbolic_trace_impl<WHERE_SELF>()
+//
+// Implements a symbolic transformation for `where.self`.
+//
+// func: where.self(Tensor condition, Tensor self, Tensor other) -> Tensor
+template <>
+internal::polynomial<OperatorRegistryBase::value_type>
+symbolic_trace_impl<Operator::WHERE_SELF>(
+    [[maybe_unused]] const flatbuffers::Vector<
+        flatbuffers::Offset<TensorMetadata>> *args,
+    [[maybe_unused]] const TensorMetadata *meta) {
+  // where.self selects between `self` and `other` by `condition` in
+  // element-wise, so it has zero FLOPs as gt.Tensor does.
+  return internal::polynomial<OperatorRegistryBase::value_type>();
+}
+
+// flatflow::symbolic_trace_impl<UNKNOWN>()
+//
+// Implements a generic symbolic transformation for operators that are not
+// yet in the operator set.
+template <>
+internal::polynomial<OperatorRegistryBase::value_type>
+symbolic_trace_impl<Operator::UNKNOWN>(
+    const flatbuffers::Vector<flatbuffers::Offset<TensorMetadata>> *args,
+    const TensorMetadata *meta) {
+  // Without knowing what the operator does, we assume that it takes one FLOP
+  // for each element of its largest tensor; that is, for each output element
+  // if it is elementwise, or for each input element if it is a reduction.
+  // Tensors are compared by the asymptotic growth of their number of elements
+  // in size. This underestimates contractions such as matrix multiplication,
+  // but keeps the cost of unknown operators from vanishing altogether.
+  const auto numel = [](const TensorMetadata *tensor) {
+    auto poly = internal::polynomial<OperatorRegistryBase::value_type>(1);
+    if (tensor == nullptr || tensor->shape() == nullptr) {
+      return poly;
+    }
+    auto shape = tensor->shape();
+    for (flatbuffers::uoffset_t index = 0; index < shape->size(); ++index) {
+      CHECK_NE(shape->Get(index), nullptr);
+      CHECK_NE(shape->Get(index)->data(), nullptr);
+      poly *= internal::polynomial<OperatorRegistryBase::value_type>(
+          shape->Get(index)->data()->Get(0),
+          shape->Get(index)->data()->Get(1));
+    }
+    return poly;
+  };
+
+  const auto is_less =
+      [](const internal::polynomial<OperatorRegistryBase::value_type> &lhs,
+         const internal::polynomial<OperatorRegistryBase::value_type> &rhs) {
+        return std::make_tuple(lhs[2], lhs[1], lhs[0]) <
+               std::make_tuple(rhs[2], rhs[1], rhs[0]);
+      };
+
+  auto poly = numel(meta);
+
+  if (args != nullptr) {
+    for (flatbuffers::uoffset_t index = 0; index < args->size(); ++index) {
+      const auto other = numel(args->Get(index));
+      if (is_less(poly, other)) {
+        poly = other;
+      }
+    }
+  }
+
+  return poly;
+}
+
+// flatflow::clamp_polynomial()
+//
+// Converts the given polynomial of a node whose symbolic size is clamped to
+// `breakpoint` in some of its shapes into a piecewise polynomial. Such a node
+// has a quadratic term of the form `s0 * min(s0, breakpoint)`, which becomes
+// linear from the breakpoint on; a non-positive breakpoint means no clamping.
+internal::piecewise_polynomial<OperatorRegistryBase::value_type>
+clamp_polynomial(
+    const internal::polynomial<OperatorRegistryBase::value_type> &poly,
+    OperatorRegistryBase::value_type breakpoint) {
+  if (breakpoint <= 0) {
+    return internal::piecewise_polynomial<OperatorRegistryBase::value_type>(
+        poly);
+  }
+  return internal::piecewise_polynomial<OperatorRegistryBase::value_type>(
+      poly, breakpoint,
+      internal::polynomial<OperatorRegistryBase::value_type>(
+          poly[0], poly[1] + poly[2] * breakpoint));
+}
+
 // flatflow::OperatorRegistry
 //
 // A `flatflow::OperatorRegistry` holds the key information to identify
@@ -797,12 +1316,22 @@ class OperatorRegistry : public OperatorRegistryBase {
   //
   // We provide only a handful of ATen operator set for now. The operator set
   // is under development and more operators will be added in the future. For
-  // expanding the operator set, please refer to the note above.
+  // expanding the operator set, please refer to the note above. In the
+  // meantime, operators outside the set are costed from their shapes alone.
   OperatorRegistry() {
     constexpr auto kOpsTableSpace =
         sizeof(EnumValuesOperator()) / sizeof(Operator);
     ops_table_.reserve(kOpsTableSpace);
 
+    registerOperator(Operator::_LOG_SOFTMAX,
+                     &symbolic_trace_impl<Operator::_LOG_SOFTMAX>);
+    registerOperator(
+        Operator::_SCALED_DOT_PRODUCT_EFFICIENT_ATTENTION,
+        &symbolic_trace_impl<
+            Operator::_SCALED_DOT_PRODUCT_EFFICIENT_ATTENTION>);
+    registerOperator(
+        Operator::_SCALED_DOT_PRODUCT_FLASH_ATTENTION,
+        &symbolic_trace_impl<Operator::_SCALED_DOT_PRODUCT_FLASH_ATTENTION>);
     registerOperator(Operator::_SOFTMAX,
                      &symbolic_trace_impl<Operator::_SOFTMAX>);
     registerOperator(Operator::_TO_COPY,
@@ -811,9 +1340,12 @@ class OperatorRegistry : public OperatorRegistryBase {
                      &symbolic_trace_impl<Operator::_UNSAFE_VIEW>);
     registerOperator(Operator::ADD_TENSOR,
                      &symbolic_trace_impl<Operator::ADD_TENSOR>);
+    registerOperator(Operator::ADDMM, &symbolic_trace_impl<Operator::ADDMM>);
     registerOperator(Operator::ARANGE, &symbolic_trace_impl<Operator::ARANGE>);
     registerOperator(Operator::ARANGE_START,
                      &symbolic_trace_impl<Operator::ARANGE_START>);
+    registerOperator(Operator::BADDBMM,
+                     &symbolic_trace_impl<Operator::BADDBMM>);
     registerOperator(Operator::BMM, &symbolic_trace_impl<Operator::BMM>);
     registerOperator(Operator::CAT, &symbolic_trace_impl<Operator::CAT>);
     registerOperator(Operator::CLONE, &symbolic_trace_impl<Operator::CLONE>);
@@ -822,8 +1354,15 @@ class OperatorRegistry : public OperatorRegistryBase {
                      &symbolic_trace_impl<Operator::EMBEDDING>);
     registerOperator(Operator::EXPAND, &symbolic_trace_impl<Operator::EXPAND>);
     registerOperator(Operator::FULL, &symbolic_trace_impl<Operator::FULL>);
+    registerOperator(Operator::GELU, &symbolic_trace_impl<Operator::GELU>);
     registerOperator(Operator::GT_TENSOR,
                      &symbolic_trace_impl<Operator::GT_TENSOR>);
+    registerOperator(Operator::INDEX_SELECT,
+                     &symbolic_trace_impl<Operator::INDEX_SELECT>);
+    registerOperator(Operator::MASKED_FILL_SCALAR,
+                     &symbolic_trace_impl<Operator::MASKED_FILL_SCALAR>);
+    registerOperator(Operator::MASKED_FILL_TENSOR,
+                     &symbolic_trace_impl<Operator::MASKED_FILL_TENSOR>);
     registerOperator(Operator::MEAN_DIM,
                      &symbolic_trace_impl<Operator::MEAN_DIM>);
     registerOperator(Operator::MM, &symbolic_trace_impl<Operator::MM>);
@@ -831,6 +1370,8 @@ class OperatorRegistry : public OperatorRegistryBase {
                      &symbolic_trace_impl<Operator::MUL_SCALAR>);
     registerOperator(Operator::MUL_TENSOR,
                      &symbolic_trace_impl<Operator::MUL_TENSOR>);
+    registerOperator(Operator::NATIVE_LAYER_NORM,
+                     &symbolic_trace_impl<Operator::NATIVE_LAYER_NORM>);
     registerOperator(Operator::NEG, &symbolic_trace_impl<Operator::NEG>);
     registerOperator(Operator::POW_TENSOR_SCALAR,
                      &symbolic_trace_impl<Operator::POW_TENSOR_SCALAR>);
@@ -846,6 +1387,10 @@ class OperatorRegistry : public OperatorRegistryBase {
     registerOperator(Operator::UNSQUEEZE,
                      &symbolic_trace_impl<Operator::UNSQUEEZE>);
     registerOperator(Operator::VIEW, &symbolic_trace_impl<Operator::VIEW>);
+    registerOperator(Operator::WHERE_SELF,
+                     &symbolic_trace_impl<Operator::WHERE_SELF>);
+    registerOperator(Operator::UNKNOWN,
+                     &symbolic_trace_impl<Operator::UNKNOWN>);
   }
 
   OperatorRegistry(const OperatorRegistry &other) = default;
@@ -879,12 +1424,28 @@ class OperatorRegistry : public OperatorRegistryBase {
   // OperatorRegistry::dispatch()
   //
   // Executes the symbolic transformation corresponding to the given operator.
+  // Operators without one, such as those deregistered or added to the schema
+  // later, fall back to the generic transformation of `UNKNOWN`.
   internal::polynomial<value_type> dispatch(
       key_type op,
       const flatbuffers::Vector<flatbuffers::Offset<TensorMetadata>> *args,
       const TensorMetadata *meta) const {
-    CHECK(ops_table_.contains(op));
-    return ops_table_.at(op)(args, meta);
+    const auto it = ops_table_.find(op);
+    if (it == ops_table_.cend()) {
+      return symbolic_trace_impl<Operator::UNKNOWN>(args, meta);
+    }
+    return it->second(args, meta);
+  }
+
+  // OperatorRegistry::dispatch()
+  //
+  // Executes the symbolic transformation corresponding to the given node,
+  // taking its breakpoint into account.
+  internal::piecewise_polynomial<value_type> dispatch(const Node *node) const {
+    CHECK_NE(node, nullptr);
+    return clamp_polynomial(
+        dispatch(node->target(), node->args(), node->meta()),
+        node->breakpoint());
   }
 
  protected:
@@ -894,7 +1455,9 @@ class OperatorRegistry : public OperatorRegistryBase {
 // flatflow::symbolic_trace()
 //
 // Generates a perfect forwarding call wrapper for a function that evaluates
-// FLOPs of the graph for a given size upon forward call.
+// FLOPs of the graph for a given size upon forward call. The FLOPs are given as
+// a piecewise polynomial, which reduces to a single polynomial unless any node
+// has a breakpoint.
 decltype(auto) symbolic_trace(const Graph *graph) {
   CHECK_NE(graph, nullptr);
 
@@ -905,33 +1468,234 @@ decltype(auto) symbolic_trace(const Graph *graph) {
 
   const auto registry = OperatorRegistry();
 
-  auto poly = internal::polynomial<OperatorRegistry::value_type>();
+  auto poly = internal::piecewise_polynomial<OperatorRegistry::value_type>();
 
   // clang-format off
-  #pragma omp declare reduction(+ : flatflow::internal::polynomial<    \
-          flatflow::OperatorRegistry::value_type> : omp_out += omp_in) \
+  #pragma omp declare reduction(+ : flatflow::internal::piecewise_polynomial< \
+          flatflow::OperatorRegistry::value_type> : omp_out += omp_in)       \
       initializer(omp_priv = omp_orig)
 
   #pragma omp parallel for reduction(+ : poly)
   for (flatbuffers::uoffset_t index = 0; index < nodes->size(); ++index) {
     auto node = nodes->Get(index);
     CHECK_NE(node, nullptr);
-    poly += registry.dispatch(node->target(), node->args(), node->meta());
+    poly += registry.dispatch(node);
   }
 
   LOG(INFO) << absl::StrFormat("Traversing a graph with %u nodes took %fs", nodes->size(), omp_get_wtime() - now);
   // clang-format on
 
   // Here we ignore the constant term as it has no effect on differencing.
-  poly[0] = 0;
+  poly -= poly[0].second[0];
   poly.normalize();
 
   return std::bind_front(
-      internal::evaluate_polynomial<typename OperatorRegistry::value_type,
-                                    typename OperatorRegistry::value_type>,
+      internal::evaluate_piecewise_polynomial<
+          typename OperatorRegistry::value_type,
+          typename OperatorRegistry::value_type>,
+      poly);
+}
+
+// flatflow::is_view()
+//
+// Returns whether the given operator is a tensor view operation, i.e., its
+// output aliases its input and thus allocates no memory.
+// See https://pytorch.org/docs/stable/tensor_view.html.
+constexpr bool is_view(Operator op) noexcept {
+  switch (op) {
+    case Operator::_UNSAFE_VIEW:
+    case Operator::EXPAND:
+    case Operator::SLICE_TENSOR:
+    case Operator::T:
+    case Operator::TRANSPOSE_INT:
+    case Operator::UNSQUEEZE:
+    case Operator::VIEW:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// flatflow::is_elementwise()
+//
+// Returns whether the given operator maps each output element from the
+// elements at the same position of its inputs, so that a chain of such
+// operators can be fused into a single kernel. Copies are included, as they
+// amount to elementwise casts or layout changes.
+constexpr bool is_elementwise(Operator op) noexcept {
+  switch (op) {
+    case Operator::_TO_COPY:
+    case Operator::ADD_TENSOR:
+    case Operator::CLONE:
+    case Operator::COS:
+    case Operator::GELU:
+    case Operator::GT_TENSOR:
+    case Operator::MASKED_FILL_SCALAR:
+    case Operator::MASKED_FILL_TENSOR:
+    case Operator::MUL_SCALAR:
+    case Operator::MUL_TENSOR:
+    case Operator::NEG:
+    case Operator::POW_TENSOR_SCALAR:
+    case Operator::RSQRT:
+    case Operator::SILU:
+    case Operator::SIN:
+    case Operator::WHERE_SELF:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// flatflow::symbolic_trace_activations()
+//
+// Generates a perfect forwarding call wrapper for a function that evaluates
+// the number of activation elements the graph allocates for a given size upon
+// forward call. This serves as an estimate of activation memory, assuming that
+// every non-view output is kept alive until the backward pass.
+decltype(auto) symbolic_trace_activations(const Graph *graph) {
+  CHECK_NE(graph, nullptr);
+
+  auto nodes = graph->nodes();
+  CHECK_NE(nodes, nullptr);
+
+  auto poly = internal::piecewise_polynomial<OperatorRegistry::value_type>();
+
+  // clang-format off
+  #pragma omp declare reduction(+ : flatflow::internal::piecewise_polynomial< \
+          flatflow::OperatorRegistry::value_type> : omp_out += omp_in)       \
+      initializer(omp_priv = omp_orig)
+
+  #pragma omp parallel for reduction(+ : poly)
+  for (flatbuffers::uoffset_t index = 0; index < nodes->size(); ++index) {
+    auto node = nodes->Get(index);
+    CHECK_NE(node, nullptr);
+
+    if (is_view(node->target())) {
+      continue;
+    }
+
+    auto meta = node->meta();
+    CHECK_NE(meta, nullptr);
+
+    auto shape = meta->shape();
+    CHECK_NE(shape, nullptr);
+
+    auto numel = internal::polynomial<OperatorRegistry::value_type>(1);
+
+    for (flatbuffers::uoffset_t dim = 0; dim < shape->size(); ++dim) {
+      CHECK_NE(shape->Get(dim), nullptr);
+      CHECK_NE(shape->Get(dim)->data(), nullptr);
+      numel *= internal::polynomial<OperatorRegistry::value_type>(
+          shape->Get(dim)->data()->Get(0), shape->Get(dim)->data()->Get(1));
+    }
+
+    poly += clamp_polynomial(numel, node->breakpoint());
+  }
+  // clang-format on
+
+  // As in `symbolic_trace`, the constant term is ignored; unlike FLOPs,
+  // the coefficients are not normalized to keep the absolute number of
+  // elements.
+  poly -= poly[0].second[0];
+
+  return std::bind_front(
+      internal::evaluate_piecewise_polynomial<
+          typename OperatorRegistry::value_type,
+          typename OperatorRegistry::value_type>,
       poly);
 }
 
+// flatflow::layer_of()
+//
+// Returns the layer that the given module path belongs to; that is, the prefix
+// of the path up to its first numeric component, e.g., `model.layers.0` for
+// `model.layers.0.mlp.down_proj`. Modules outside the repeated layers, such as
+// embeddings and output heads, are layers of their own.
+std::string_view layer_of(std::string_view module_path) {
+  auto pos = static_cast<std::string_view::size_type>(0);
+  while (pos < module_path.size()) {
+    auto end = module_path.find('.', pos);
+    if (end == std::string_view::npos) {
+      end = module_path.size();
+    }
+    const auto component = module_path.substr(pos, end - pos);
+    if (!component.empty() &&
+        std::all_of(component.cbegin(), component.cend(), [](char c) {
+          return std::isdigit(static_cast<unsigned char>(c)) != 0;
+        })) {
+      return module_path.substr(0, end);
+    }
+    pos = end + 1;
+  }
+  return module_path;
+}
+
+// flatflow::is_row_parallel()
+//
+// Returns whether the module at the given path is the output projection of
+// an attention or feed-forward block, e.g., `model.layers.0.mlp.down_proj`.
+// With tensor parallelism, such projections are split along their input
+// features as in Megatron's `RowParallelLinear`, so that each rank computes
+// a partial sum of the output to be all-reduced across the group.
+bool is_row_parallel(std::string_view module_path) {
+  const auto pos = module_path.rfind('.');
+  const auto name = pos == std::string_view::npos ? module_path
+                                                  : module_path.substr(pos + 1);
+  return name == "c_proj" || name == "dense" || name == "dense_4h_to_h" ||
+         name == "down_proj" || name == "fc2" || name == "o_proj" ||
+         name == "out_proj" || name == "w2" || name == "wo";
+}
+
+// flatflow::symbolic_trace_layers()
+//
+// Rolls up the FLOPs of the graph by layer, where each layer is a maximal run
+// of consecutive nodes whose module paths belong to the same layer. Nodes
+// without a module path are attributed to the layer before them. The layers
+// are returned in execution order as pairs of their names and FLOPs, which are
+// neither offset nor normalized so that they remain comparable to each other.
+std::vector<std::pair<
+    std::string, internal::piecewise_polynomial<OperatorRegistry::value_type>>>
+symbolic_trace_layers(const Graph *graph) {
+  CHECK_NE(graph, nullptr);
+
+  auto nodes = graph->nodes();
+  CHECK_NE(nodes, nullptr);
+
+  const auto registry = OperatorRegistry();
+
+  auto polys = std::vector<
+      internal::piecewise_polynomial<OperatorRegistry::value_type>>(
+      nodes->size());
+
+  // clang-format off
+  #pragma omp parallel for
+  for (flatbuffers::uoffset_t index = 0; index < nodes->size(); ++index) {
+    auto node = nodes->Get(index);
+    CHECK_NE(node, nullptr);
+    polys[index] = registry.dispatch(node);
+  }
+  // clang-format on
+
+  auto layers = std::vector<std::pair<
+      std::string,
+      internal::piecewise_polynomial<OperatorRegistry::value_type>>>();
+
+  for (flatbuffers::uoffset_t index = 0; index < nodes->size(); ++index) {
+    const auto module_path = nodes->Get(index)->module_path();
+    const auto layer =
+        module_path == nullptr ? std::string() : module_path->str();
+    const auto name = std::string(layer_of(layer));
+
+    if (layers.empty() || (!name.empty() && name != layers.back().first)) {
+      layers.emplace_back(name, polys[index]);
+    } else {
+      layers.back().second += polys[index];
+    }
+  }
+
+  return layers;
+}
+
 }  // namespace flatflow
 
 #endif  // FLATFLOW_OPS_OPS_H_
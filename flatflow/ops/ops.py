@@ -12,10 +12,14 @@
 # See the License for the specific language governing permissions and
 # limitations under the License.
 
+import operator
+import re
 import warnings
 from collections.abc import Mapping, Sequence
+from typing import Union
 
 import flatbuffers
+import sympy
 import torch
 import torch.fx
 from torch._ops import OpOverload
@@ -29,11 +33,15 @@ from flatflow.ops.graph_generated import (
 from flatflow.ops.node_generated import (
     CreateSymInt,
     NodeAddArgs,
+    NodeAddBreakpoint,
     NodeAddMeta,
+    NodeAddModulePath,
+    NodeAddProducers,
     NodeAddTarget,
     NodeEnd,
     NodeStart,
     NodeStartArgsVector,
+    NodeStartProducersVector,
     TensorMetadataAddShape,
     TensorMetadataEnd,
     TensorMetadataStart,
@@ -46,12 +54,21 @@ aten = torch._ops.ops.aten  # type: ignore[has-type]
 __all__ = ["serialize"]
 
 _OPS_TABLE: Mapping[OpOverload, int] = {
+    aten._log_softmax: Operator._LOG_SOFTMAX,
+    aten._scaled_dot_product_efficient_attention: (
+        Operator._SCALED_DOT_PRODUCT_EFFICIENT_ATTENTION
+    ),
+    aten._scaled_dot_product_flash_attention: (
+        Operator._SCALED_DOT_PRODUCT_FLASH_ATTENTION
+    ),
     aten._softmax: Operator._SOFTMAX,
     aten._to_copy: Operator._TO_COPY,
     aten._unsafe_view: Operator._UNSAFE_VIEW,
     aten.add.Tensor: Operator.ADD_TENSOR,
+    aten.addmm: Operator.ADDMM,
     aten.arange: Operator.ARANGE,
     aten.arange.start: Operator.ARANGE_START,
+    aten.baddbmm: Operator.BADDBMM,
     aten.bmm: Operator.BMM,
     aten.cat: Operator.CAT,
     aten.clone: Operator.CLONE,
@@ -59,11 +76,16 @@ _OPS_TABLE: Mapping[OpOverload, int] = {
     aten.embedding: Operator.EMBEDDING,
     aten.expand: Operator.EXPAND,
     aten.full: Operator.FULL,
+    aten.gelu: Operator.GELU,
     aten.gt.Tensor: Operator.GT_TENSOR,
+    aten.index_select: Operator.INDEX_SELECT,
+    aten.masked_fill.Scalar: Operator.MASKED_FILL_SCALAR,
+    aten.masked_fill.Tensor: Operator.MASKED_FILL_TENSOR,
     aten.mean.dim: Operator.MEAN_DIM,
     aten.mm: Operator.MM,
     aten.mul.Scalar: Operator.MUL_SCALAR,
     aten.mul.Tensor: Operator.MUL_TENSOR,
+    aten.native_layer_norm: Operator.NATIVE_LAYER_NORM,
     aten.neg: Operator.NEG,
     aten.pow.Tensor_Scalar: Operator.POW_TENSOR_SCALAR,
     aten.rsqrt: Operator.RSQRT,
@@ -75,18 +97,24 @@ _OPS_TABLE: Mapping[OpOverload, int] = {
     aten.triu: Operator.TRIU,
     aten.unsqueeze: Operator.UNSQUEEZE,
     aten.view: Operator.VIEW,
+    aten.where.self: Operator.WHERE_SELF,
 }
 
 
 class UnsupportedOperatorWarning(UserWarning):
-    """Warning that signals the presence of unsupported operators."""
+    """Warning that signals the presence of unsupported operators.
+
+    Such operators are serialized as ``Operator.UNKNOWN`` and costed by a generic
+    fallback rather than being dropped from the graph.
+    """
 
     def __init__(self, args: Sequence[OpOverload]) -> None:
         self.args = tuple(set(args))
 
     def __str__(self) -> str:
         message = (
-            "The following operators are not supported\n{}\n"
+            "The following operators are not supported and are costed from their "
+            "shapes alone\n{}\n"
             "Please make sure you are using the latest version of FlatFlow\n"
             "or file an issue to https://github.com/9rum/flatflow/issues\n"
             "The latest release can be found at https://github.com/9rum/flatflow/tags"
@@ -119,30 +147,105 @@ def is_accessor_node(node: torch.fx.Node) -> bool:
     )
 
 
+def to_coeffs(expr: sympy.Expr) -> tuple[list[int], int]:
+    """Returns the coefficients of the given symbolic expression in terms of its symbol,
+    and the breakpoint where the expression is clamped or zero if it is not clamped.
+
+    Clamped sizes such as the key length ``Min(s0, window)`` of sliding window attention
+    are recorded as the symbolic size itself along with the breakpoint ``window``, and
+    multiples of them such as ``2*Min(s0, window)`` as the same multiple of it.
+
+    Raises:
+        NotImplementedError: If the expression is clamped by something other than
+            a constant, e.g., ``Min(s0, s1)``.
+    """
+    scale, expr = expr.as_coeff_Mul()
+    threshold = 0
+    if isinstance(expr, sympy.Min):
+        bounds = [arg for arg in expr.args if arg.is_number]
+        exprs = [arg for arg in expr.args if not arg.is_number]
+        if not bounds or len(exprs) != 1:
+            raise NotImplementedError(
+                f"{expr} is not supported; sizes may only be clamped to a constant"
+            )
+        bound = min(bounds)
+        expr = exprs[0]
+        symbol = next(iter(expr.free_symbols))
+        # Solve c0 + c1 * s0 = bound for s0, rounding up to the next integer.
+        threshold = -((expr.coeff(symbol, 0) - bound) // expr.coeff(symbol, 1))
+    if not expr.free_symbols:
+        return [int(scale * expr), 0], 0
+    symbol = next(iter(expr.free_symbols))
+    coeffs = [int(scale * expr.coeff(symbol, 0)), int(scale * expr.coeff(symbol, 1))]
+    return coeffs, int(threshold)
+
+
+def to_sym_int(maybe_sym_int: Union[int, torch.SymInt]) -> tuple[list[int], int]:
+    """Returns the coefficients of the given size in terms of the symbolic size, and
+    the breakpoint where the size is clamped or zero if it is not clamped.
+
+    See :func:`to_coeffs` for how clamped sizes are recorded.
+    """
+    if not isinstance(maybe_sym_int, torch.SymInt):
+        return [maybe_sym_int, 0], 0
+    return to_coeffs(maybe_sym_int.node.expr)
+
+
+def to_module_path(node: torch.fx.Node) -> str:
+    """Returns the qualified name of the innermost module that called the given node,
+    or an empty string if it was called outside any module.
+
+    Module paths recorded by Dynamo such as ``L['self'].model.layers[0].mlp`` are
+    normalized to their qualified names, e.g., ``model.layers.0.mlp``.
+    """
+    stack = node.meta.get("nn_module_stack")
+    if not stack:
+        return ""
+    path, _ = next(reversed(stack.values()))
+    path = re.sub(r"^L\['self'\]\.?", "", path)
+    return re.sub(r"\[(\d+)\]", r".\1", path)
+
+
+def to_producer(arg: torch.fx.Node, positions: Mapping[torch.fx.Node, int]) -> int:
+    """Returns the position of the serialized node that produced the given argument,
+    or -1 if it is an input of the graph.
+
+    Elements of tuples such as the output of layer normalization are taken from the
+    node that returned the tuple.
+    """
+    while (
+        arg not in positions
+        and arg.op == "call_function"
+        and arg.target is operator.getitem
+        and isinstance(arg.args[0], torch.fx.Node)
+    ):
+        arg = arg.args[0]
+    return positions.get(arg, -1)
+
+
 def serialize(builder: flatbuffers.Builder, graph: torch.fx.Graph) -> int:
     """Serializes the given graph."""
     blacklist = []
     nodes = []
+    positions = {}
 
     for node in graph.nodes:
         if not is_accessor_node(node) and isinstance(node.target, OpOverload):
             if node.target not in _OPS_TABLE:
                 blacklist.append(node.target)
-                continue
-            target = _OPS_TABLE[node.target]
+            target = _OPS_TABLE.get(node.target, Operator.UNKNOWN)
             args = []
+            producers = []
+            threshold = 0
 
             for arg in node.args:
                 if isinstance(arg, torch.fx.Node) and "tensor_meta" in arg.meta:
                     shape = []
 
                     for maybe_sym_int in arg.meta["tensor_meta"].shape:
-                        if isinstance(maybe_sym_int, torch.SymInt):
-                            expr = maybe_sym_int.node.expr
-                            symbol = next(iter(expr.free_symbols))
-                            shape.append([expr.coeff(symbol, 0), expr.coeff(symbol, 1)])
-                        else:
-                            shape.append([maybe_sym_int, 0])
+                        sym_int, clamp = to_sym_int(maybe_sym_int)
+                        shape.append(sym_int)
+                        threshold = max(threshold, clamp)
 
                     TensorMetadataStartShapeVector(builder, len(shape))
                     for sym_int in reversed(shape):
@@ -153,22 +256,30 @@ def serialize(builder: flatbuffers.Builder, graph: torch.fx.Graph) -> int:
                     TensorMetadataAddShape(builder, _shape)
                     _arg = TensorMetadataEnd(builder)
                     args.append(_arg)
+                    producers.append(to_producer(arg, positions))
 
             NodeStartArgsVector(builder, len(args))
             for arg in reversed(args):
                 builder.PrependUOffsetTRelative(arg)
             _args = builder.EndVector()
 
+            NodeStartProducersVector(builder, len(producers))
+            for producer in reversed(producers):
+                builder.PrependInt64(producer)
+            _producers = builder.EndVector()
+
             shape = []
 
             if "tensor_meta" in node.meta:
-                for maybe_sym_int in node.meta["tensor_meta"].shape:
-                    if isinstance(maybe_sym_int, torch.SymInt):
-                        expr = maybe_sym_int.node.expr
-                        symbol = next(iter(expr.free_symbols))
-                        shape.append([expr.coeff(symbol, 0), expr.coeff(symbol, 1)])
-                    else:
-                        shape.append([maybe_sym_int, 0])
+                tensor_meta = node.meta["tensor_meta"]
+                # Operators such as fused attention and layer normalization return
+                # a tuple of tensors, the first of which is the actual output.
+                if isinstance(tensor_meta, (list, tuple)):
+                    tensor_meta = tensor_meta[0]
+                for maybe_sym_int in tensor_meta.shape:
+                    sym_int, clamp = to_sym_int(maybe_sym_int)
+                    shape.append(sym_int)
+                    threshold = max(threshold, clamp)
 
             TensorMetadataStartShapeVector(builder, len(shape))
             for sym_int in reversed(shape):
@@ -179,11 +290,21 @@ def serialize(builder: flatbuffers.Builder, graph: torch.fx.Graph) -> int:
             TensorMetadataAddShape(builder, _shape)
             _meta = TensorMetadataEnd(builder)
 
+            module_path = to_module_path(node)
+            if module_path:
+                _module_path = builder.CreateString(module_path)
+
             NodeStart(builder)
             NodeAddTarget(builder, target)
             NodeAddArgs(builder, _args)
             NodeAddMeta(builder, _meta)
+            if 0 < threshold:
+                NodeAddBreakpoint(builder, threshold)
+            if module_path:
+                NodeAddModulePath(builder, _module_path)
+            NodeAddProducers(builder, _producers)
             _node = NodeEnd(builder)
+            positions[node] = len(nodes)
             nodes.append(_node)
 
     if blacklist:
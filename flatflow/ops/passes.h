@@ -0,0 +1,502 @@
+// Copyright 2025 The FlatFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FLATFLOW_OPS_PASSES_H_
+#define FLATFLOW_OPS_PASSES_H_
+
+#include <omp.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/log/check.h"
+#include "absl/log/log.h"
+#include "absl/strings/str_format.h"
+#include "flatbuffers/base.h"
+
+#include "flatflow/ops/adaptors.h"
+#include "flatflow/ops/graph_generated.h"
+#include "flatflow/ops/internal/piecewise_polynomial.h"
+#include "flatflow/ops/internal/polynomial.h"
+#include "flatflow/ops/node_generated.h"
+#include "flatflow/ops/operator_generated.h"
+#include "flatflow/ops/ops.h"
+
+namespace flatflow {
+
+// flatflow::symbolic_numel()
+//
+// Returns the number of elements of a tensor with the given metadata as
+// a piecewise polynomial, clamped at `breakpoint` as in the node it belongs to.
+internal::piecewise_polynomial<OperatorRegistry::value_type> symbolic_numel(
+    const TensorMetadataAdaptor &meta,
+    OperatorRegistry::value_type breakpoint) {
+  auto numel = internal::polynomial<OperatorRegistry::value_type>(1);
+  for (const auto &sym_int : meta.shape()) {
+    numel *= internal::polynomial<OperatorRegistry::value_type>(sym_int[0],
+                                                                 sym_int[1]);
+  }
+  return clamp_polynomial(numel, breakpoint);
+}
+
+// flatflow::CostNode
+//
+// A `flatflow::CostNode` is a node of the cost graph. Each node carries its
+// FLOPs, memory traffic and tensor parallel communication in elements as
+// piecewise polynomials, so that graph passes can merge nodes without
+// revisiting the operator table. A node may stand for several operators fused
+// by the compiler, which are listed in `targets` in execution order; `aliases`
+// holds the shapes of the views taken of its output.
+//
+// `id` is the position in the graph of the node whose output this node yields,
+// and `producers` holds that of the node producing each of `args`, or -1 for
+// the inputs of the graph. `producers` is empty if the graph has no edges.
+struct CostNode {
+  std::vector<Operator> targets;
+  std::vector<TensorMetadataAdaptor> args;
+  std::int64_t id = -1;
+  std::vector<std::int64_t> producers;
+  TensorMetadataAdaptor meta;
+  std::vector<TensorMetadataAdaptor> aliases;
+  OperatorRegistry::value_type breakpoint;
+  internal::piecewise_polynomial<OperatorRegistry::value_type> flops;
+  internal::piecewise_polynomial<OperatorRegistry::value_type> traffic;
+  internal::piecewise_polynomial<OperatorRegistry::value_type> communication;
+};
+
+// flatflow::CostGraph
+//
+// A `flatflow::CostGraph` is the intermediate representation that graph passes
+// operate on, lowered from the given computational graph. Each node is costed
+// on its own upon lowering; the memory traffic of a node is the number of
+// elements it reads and writes, which is zero for tensor views.
+//
+// The communication of a node is the number of elements all-reduced across
+// the tensor parallel group after it, as Megatron does for the outputs of
+// row-parallel projections and vocabulary-parallel embeddings. Projections
+// are recognized by their module paths; batched matrix multiplications in
+// attention run on the local heads of each rank and need no communication.
+class CostGraph {
+ public:
+  using value_type = typename std::vector<CostNode>::value_type;
+  using size_type = typename std::vector<CostNode>::size_type;
+
+  CostGraph() {}
+
+  CostGraph(const Graph *graph) {
+    CHECK_NE(graph, nullptr);
+
+    auto nodes = graph->nodes();
+    CHECK_NE(nodes, nullptr);
+
+    const auto now = omp_get_wtime();
+
+    const auto registry = OperatorRegistry();
+
+    nodes_.resize(nodes->size());
+
+    // clang-format off
+    #pragma omp parallel for
+    for (flatbuffers::uoffset_t index = 0; index < nodes->size(); ++index) {
+      const auto node = nodes->Get(index);
+      CHECK_NE(node, nullptr);
+
+      const auto adaptor = NodeAdaptor(node);
+      auto &cost_node = nodes_[index];
+      cost_node.targets = {adaptor.target()};
+      cost_node.args = adaptor.args();
+      cost_node.id = static_cast<std::int64_t>(index);
+      if (const auto producers = node->producers();
+          producers != nullptr && producers->size() == adaptor.args().size()) {
+        cost_node.producers.assign(producers->begin(), producers->end());
+      }
+      cost_node.meta = adaptor.meta();
+      cost_node.breakpoint = node->breakpoint();
+      cost_node.flops = registry.dispatch(node);
+
+      if (!is_view(adaptor.target())) {
+        cost_node.traffic = symbolic_numel(adaptor.meta(), node->breakpoint());
+        for (const auto &arg : adaptor.args()) {
+          cost_node.traffic += symbolic_numel(arg, node->breakpoint());
+        }
+      }
+
+      // Projections with a bias such as GPT-2's `Conv1D` lower to `addmm`.
+      const auto module_path = node->module_path();
+      if (adaptor.target() == Operator::EMBEDDING ||
+          ((adaptor.target() == Operator::MM ||
+            adaptor.target() == Operator::ADDMM) &&
+           module_path != nullptr &&
+           is_row_parallel(module_path->string_view()))) {
+        cost_node.communication =
+            symbolic_numel(adaptor.meta(), node->breakpoint());
+      }
+    }
+
+    LOG(INFO) << absl::StrFormat("Lowering a graph with %u nodes took %fs", nodes->size(), omp_get_wtime() - now);
+    // clang-format on
+  }
+
+  CostGraph(const CostGraph &other) = default;
+
+  CostGraph &operator=(const CostGraph &other) = default;
+
+  CostGraph(CostGraph &&other) = default;
+
+  CostGraph &operator=(CostGraph &&other) = default;
+
+  size_type size() const noexcept { return nodes_.size(); }
+
+  std::vector<CostNode> &nodes() { return nodes_; }
+
+  const std::vector<CostNode> &nodes() const { return nodes_; }
+
+  value_type &operator[](size_type index) { return nodes_[index]; }
+
+  const value_type &operator[](size_type index) const { return nodes_[index]; }
+
+ protected:
+  std::vector<CostNode> nodes_;
+};
+
+namespace internal {
+
+// internal::is_same_shape()
+//
+// Returns whether the given tensors have the same symbolic shape.
+bool is_same_shape(const TensorMetadataAdaptor &lhs,
+                   const TensorMetadataAdaptor &rhs) {
+  return std::equal(
+      lhs.shape().cbegin(), lhs.shape().cend(), rhs.shape().cbegin(),
+      rhs.shape().cend(),
+      [](const auto &x, const auto &y) { return x.data() == y.data(); });
+}
+
+// internal::find_consumed_arg()
+//
+// Returns the position of the first argument of `consumer` that is the output
+// of `producer` or a view of it, or the number of arguments if there is none.
+//
+// NOTE: Graphs serialized without edges keep the shapes of arguments but not
+// the nodes producing them. A node is then taken to consume the output of
+// the node right before it if one of its arguments has the same shape, which
+// holds for the elementwise chains emitted by tracing in execution order.
+CostGraph::size_type find_consumed_arg(const CostNode &producer,
+                                       const CostNode &consumer) {
+  if (!consumer.producers.empty()) {
+    return static_cast<CostGraph::size_type>(std::distance(
+        consumer.producers.cbegin(),
+        std::find(consumer.producers.cbegin(), consumer.producers.cend(),
+                  producer.id)));
+  }
+
+  const auto it = std::find_if(
+      consumer.args.cbegin(), consumer.args.cend(), [&](const auto &arg) {
+        return is_same_shape(arg, producer.meta) ||
+               std::any_of(producer.aliases.cbegin(), producer.aliases.cend(),
+                           [&](const auto &alias) {
+                             return is_same_shape(arg, alias);
+                           });
+      });
+  return static_cast<CostGraph::size_type>(
+      std::distance(consumer.args.cbegin(), it));
+}
+
+// internal::count_users()
+//
+// Returns the number of nodes in the given cost graph that consume the output
+// of each node, keyed by its ID. Nodes of graphs without edges are not counted.
+absl::flat_hash_map<std::int64_t, CostGraph::size_type> count_users(
+    const CostGraph &graph) {
+  auto users = absl::flat_hash_map<std::int64_t, CostGraph::size_type>();
+  for (const auto &node : graph.nodes()) {
+    const auto producers = absl::flat_hash_set<std::int64_t>(
+        node.producers.cbegin(), node.producers.cend());
+    for (const auto producer : producers) {
+      ++users[producer];
+    }
+  }
+  return users;
+}
+
+// internal::fuse()
+//
+// Fuses `consumer` into `producer` if the former consumes the output of the
+// latter, and returns whether they were fused. The intermediate result then
+// never touches memory, so neither its write by `producer` nor its reads by
+// `consumer` are charged. If the graph has edges, `users` holds the number of
+// consumers of each node as returned by `count_users`; an intermediate result
+// read by any other node still has to be written, so such nodes are not fused.
+bool fuse(
+    CostNode &producer, const CostNode &consumer,
+    const absl::flat_hash_map<std::int64_t, CostGraph::size_type> &users) {
+  if (producer.breakpoint != consumer.breakpoint) {
+    return false;
+  }
+
+  const auto pos = find_consumed_arg(producer, consumer);
+  if (pos == consumer.args.size()) {
+    return false;
+  }
+
+  if (!consumer.producers.empty()) {
+    const auto it = users.find(producer.id);
+    if (it == users.cend() || it->second != 1) {
+      return false;
+    }
+  }
+
+  // Without edges, only the argument found above is taken to be consumed.
+  const auto is_consumed = [&](CostGraph::size_type index) {
+    if (consumer.producers.empty()) {
+      return index == pos;
+    }
+    return consumer.producers[index] == producer.id;
+  };
+
+  producer.traffic += consumer.traffic;
+  producer.traffic += symbolic_numel(producer.meta, producer.breakpoint) * -1;
+  producer.flops += consumer.flops;
+  producer.communication += consumer.communication;
+
+  producer.targets.insert(producer.targets.cend(), consumer.targets.cbegin(),
+                          consumer.targets.cend());
+  const auto has_edges =
+      !producer.producers.empty() && !consumer.producers.empty();
+  for (CostGraph::size_type index = 0; index < consumer.args.size();
+       ++index) {
+    if (is_consumed(index)) {
+      producer.traffic +=
+          symbolic_numel(consumer.args[index], consumer.breakpoint) * -1;
+    } else {
+      producer.args.emplace_back(consumer.args[index]);
+      if (has_edges) {
+        producer.producers.emplace_back(consumer.producers[index]);
+      }
+    }
+  }
+  if (!has_edges) {
+    producer.producers.clear();
+  }
+  producer.id = consumer.id;
+  producer.meta = consumer.meta;
+  producer.aliases = consumer.aliases;
+
+  return true;
+}
+
+// internal::is_fusible()
+//
+// Returns whether the given node consists of elementwise operators alone.
+bool is_fusible(const CostNode &node) {
+  return std::all_of(node.targets.cbegin(), node.targets.cend(),
+                     [](Operator op) { return is_elementwise(op); });
+}
+
+// internal::is_copy()
+//
+// Returns whether the given node is a lone copy.
+bool is_copy(const CostNode &node) {
+  return node.targets.size() == 1 &&
+         (node.targets.front() == Operator::_TO_COPY ||
+          node.targets.front() == Operator::CLONE);
+}
+
+}  // namespace internal
+
+// flatflow::eliminate_views()
+//
+// Drops zero-cost view and copy nodes from the given cost graph. A view is
+// recorded as an alias of the output of the node right before it, so that
+// later passes see through it; if the graph has edges, the consumers of a view
+// are redirected to the node it views instead. A copy is merged into its
+// producer or consumer along with its memory traffic, as the compiler folds it
+// into the adjacent kernel; copies with neither are kept.
+void eliminate_views(CostGraph &graph) {
+  auto nodes = std::vector<CostNode>();
+  nodes.reserve(graph.size());
+
+  // The node viewed by each view, keyed by the ID of the view.
+  auto sources = absl::flat_hash_map<std::int64_t, std::int64_t>();
+
+  for (auto &node : graph.nodes()) {
+    for (auto &producer : node.producers) {
+      if (const auto it = sources.find(producer); it != sources.cend()) {
+        producer = it->second;
+      }
+    }
+
+    if (node.targets.size() == 1 && is_view(node.targets.front())) {
+      if (!nodes.empty() &&
+          internal::find_consumed_arg(nodes.back(), node) < node.args.size()) {
+        nodes.back().aliases.emplace_back(node.meta);
+      }
+      if (!node.producers.empty()) {
+        sources.emplace(node.id, node.producers.front());
+      }
+      continue;
+    }
+
+    nodes.emplace_back(std::move(node));
+  }
+
+  graph.nodes() = std::move(nodes);
+  nodes.clear();
+  nodes.reserve(graph.size());
+
+  const auto users = internal::count_users(graph);
+
+  for (auto &node : graph.nodes()) {
+    if (!nodes.empty() &&
+        (internal::is_copy(node) || internal::is_copy(nodes.back())) &&
+        internal::fuse(nodes.back(), node, users)) {
+      continue;
+    }
+    nodes.emplace_back(std::move(node));
+  }
+
+  graph.nodes() = std::move(nodes);
+}
+
+// flatflow::fuse_elementwise()
+//
+// Fuses chains of elementwise nodes in the given cost graph, such as
+// `mul.Tensor` followed by `add.Tensor` and `silu`, into single nodes.
+// The FLOPs of a fused node add up, while its memory traffic excludes the
+// intermediate results. If the graph has edges, a node is fused into its
+// producer only if it is the sole consumer of the producer's output.
+void fuse_elementwise(CostGraph &graph) {
+  auto nodes = std::vector<CostNode>();
+  nodes.reserve(graph.size());
+
+  const auto users = internal::count_users(graph);
+
+  for (auto &node : graph.nodes()) {
+    if (!nodes.empty() && internal::is_fusible(nodes.back()) &&
+        internal::is_fusible(node) &&
+        internal::fuse(nodes.back(), node, users)) {
+      continue;
+    }
+    nodes.emplace_back(std::move(node));
+  }
+
+  graph.nodes() = std::move(nodes);
+}
+
+// flatflow::PassManager
+//
+// A `flatflow::PassManager` runs a pipeline of graph passes over a cost graph
+// in the order they were added. Each pass is a callable that transforms the
+// cost graph in place.
+class PassManager {
+ public:
+  using pass_type = std::function<void(CostGraph &)>;
+
+  PassManager() {}
+
+  PassManager(const PassManager &other) = default;
+
+  PassManager &operator=(const PassManager &other) = default;
+
+  PassManager(PassManager &&other) = default;
+
+  PassManager &operator=(PassManager &&other) = default;
+
+  // PassManager::addPass()
+  //
+  // Appends `pass` to the pipeline.
+  void addPass(pass_type pass) { passes_.emplace_back(std::move(pass)); }
+
+  // PassManager::run()
+  //
+  // Runs every pass in the pipeline over `graph`.
+  void run(CostGraph &graph) const {
+    const auto now = omp_get_wtime();
+    const auto size = graph.size();
+
+    for (const auto &pass : passes_) {
+      pass(graph);
+    }
+
+    // clang-format off
+    LOG(INFO) << absl::StrFormat("Running %u passes reduced a graph from %u to %u nodes in %fs", passes_.size(), size, graph.size(), omp_get_wtime() - now);
+    // clang-format on
+  }
+
+ protected:
+  std::vector<pass_type> passes_;
+};
+
+// flatflow::default_passes()
+//
+// Returns the default pipeline of graph passes, which drops views and copies
+// and then fuses elementwise chains.
+PassManager default_passes() {
+  auto passes = PassManager();
+  passes.addPass(eliminate_views);
+  passes.addPass(fuse_elementwise);
+  return passes;
+}
+
+// flatflow::symbolic_trace()
+//
+// Generates a perfect forwarding call wrapper for a function that evaluates
+// the cost of the graph for a given size upon forward call, after running
+// the given passes over it. The cost of each node is its FLOPs plus its memory
+// traffic weighted by `memory_cost`, the number of FLOPs that take as long as
+// moving one element; that is, the machine balance of the target device.
+// Since fusion saves memory traffic but not FLOPs, this is where passes make
+// a difference for elementwise-heavy samples. Likewise, communication is
+// weighted by `communication_cost`, which is zero without tensor parallelism.
+decltype(auto) symbolic_trace(
+    const Graph *graph, const PassManager &passes,
+    OperatorRegistry::value_type memory_cost,
+    OperatorRegistry::value_type communication_cost = 0) {
+  auto cost_graph = CostGraph(graph);
+  passes.run(cost_graph);
+
+  auto poly = internal::piecewise_polynomial<OperatorRegistry::value_type>();
+
+  // clang-format off
+  #pragma omp declare reduction(+ : flatflow::internal::piecewise_polynomial< \
+          flatflow::OperatorRegistry::value_type> : omp_out += omp_in)       \
+      initializer(omp_priv = omp_orig)
+
+  #pragma omp parallel for reduction(+ : poly)
+  for (CostGraph::size_type index = 0; index < cost_graph.size(); ++index) {
+    const auto &node = cost_graph[index];
+    poly += node.flops + node.traffic * memory_cost +
+            node.communication * communication_cost;
+  }
+  // clang-format on
+
+  // As in `symbolic_trace` without passes, the constant term is ignored.
+  poly -= poly[0].second[0];
+  poly.normalize();
+
+  return std::bind_front(
+      internal::evaluate_piecewise_polynomial<
+          typename OperatorRegistry::value_type,
+          typename OperatorRegistry::value_type>,
+      poly);
+}
+
+}  // namespace flatflow
+
+#endif  // FLATFLOW_OPS_PASSES_H_
@@ -13,10 +13,83 @@
 // limitations under the License.
 
 #include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
 
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "flatbuffers/flatbuffers.h"
+
+#include "flatflow/ops/graph_generated.h"
 #include "flatflow/rpc/controlplane.h"
+#include "flatflow/scheduler/advisor.h"
+#include "flatflow/scheduler/autotuner.h"
+
+namespace py = pybind11;
 
 PYBIND11_MODULE(_C, m) {
   // This may bind `flatflow::run` to `flatflow._C.run` in the Python frontend.
   m.def("run", &flatflow::run);
+
+  py::class_<flatflow::Configuration>(m, "Configuration")
+      .def_readonly("global_batch_size",
+                    &flatflow::Configuration::global_batch_size)
+      .def_readonly("micro_batch_size",
+                    &flatflow::Configuration::micro_batch_size)
+      .def_readonly("step_time", &flatflow::Configuration::step_time)
+      .def_readonly("time_per_sample",
+                    &flatflow::Configuration::time_per_sample)
+      .def_readonly("memory_headroom",
+                    &flatflow::Configuration::memory_headroom);
+
+  // The graph is passed as a serialized flatbuffer, as built by
+  // `flatflow.ops.serialize`.
+  m.def(
+      "autotune",
+      [](const py::bytes &graph, const std::vector<std::uint32_t> &sizes,
+         std::size_t data_parallel_world_size,
+         std::size_t pipeline_parallel_world_size, std::size_t memory_budget,
+         const std::vector<std::size_t> &global_batch_sizes,
+         const std::vector<std::size_t> &micro_batch_sizes,
+         std::size_t bytes_per_element, double microbatch_overhead) {
+        const auto buffer = static_cast<std::string>(graph);
+        auto options = flatflow::AutotunerOptions();
+        options.bytes_per_element = bytes_per_element;
+        options.microbatch_overhead = microbatch_overhead;
+        const auto autotuner = flatflow::Autotuner(
+            data_parallel_world_size, pipeline_parallel_world_size,
+            sizes.cbegin(), sizes.cend(),
+            flatbuffers::GetRoot<flatflow::Graph>(buffer.data()),
+            memory_budget, options);
+        return autotuner.Tune(global_batch_sizes, micro_batch_sizes);
+      },
+      py::arg("graph"), py::arg("sizes"), py::arg("data_parallel_world_size"),
+      py::arg("pipeline_parallel_world_size"), py::arg("memory_budget"),
+      py::arg("global_batch_sizes"),
+      py::arg("micro_batch_sizes") = std::vector<std::size_t>(),
+      py::arg("bytes_per_element") = 2, py::arg("microbatch_overhead") = 0.0);
+
+  py::class_<flatflow::StageSplit>(m, "StageSplit")
+      .def_readonly("layers", &flatflow::StageSplit::layers)
+      .def_readonly("num_layers", &flatflow::StageSplit::num_layers)
+      .def_readonly("stage_costs", &flatflow::StageSplit::stage_costs)
+      .def_readonly("max_stage_cost", &flatflow::StageSplit::max_stage_cost);
+
+  // Returns the proposed split along with the split by layer count for
+  // comparison.
+  m.def(
+      "advise_stages",
+      [](const py::bytes &graph, const std::vector<std::uint32_t> &sizes,
+         std::size_t pipeline_parallel_world_size) {
+        const auto buffer = static_cast<std::string>(graph);
+        const auto advisor = flatflow::StageAdvisor(
+            pipeline_parallel_world_size, sizes.cbegin(), sizes.cend(),
+            flatbuffers::GetRoot<flatflow::Graph>(buffer.data()));
+        return std::make_pair(advisor.Advise(), advisor.Uniform());
+      },
+      py::arg("graph"), py::arg("sizes"),
+      py::arg("pipeline_parallel_world_size"));
 }
@@ -1,4 +1,4 @@
 from flatflow._C import run  # type: ignore[attr-defined]
-from flatflow.rpc.controlplane import ControlPlaneClient
+from flatflow.rpc.controlplane import ControlPlaneClient, Mode, Policy
 
-__all__ = ["ControlPlaneClient", "run"]
+__all__ = ["ControlPlaneClient", "Mode", "Policy", "run"]
@@ -17,10 +17,14 @@
 
 #include <grpcpp/grpcpp.h>
 
+#include <algorithm>
 #include <csignal>
+#include <cstddef>
 #include <cstdint>
 #include <future>
 #include <iterator>
+#include <numeric>
+#include <string_view>
 #include <vector>
 
 #include "absl/base/log_severity.h"
@@ -30,12 +34,16 @@
 #include "absl/log/internal/globals.h"
 #include "absl/log/log.h"
 #include "absl/strings/str_format.h"
+#include "flatbuffers/flexbuffers.h"
 #include "flatbuffers/grpc.h"
 
 #include "flatflow/rpc/controlplane.grpc.fb.h"
 #include "flatflow/rpc/controlplane_generated.h"
 #include "flatflow/rpc/empty_generated.h"
+#include "flatflow/scheduler/inference.h"
 #include "flatflow/scheduler/internal/scatter.h"
+#include "flatflow/scheduler/policy.h"
+#include "flatflow/scheduler/recompute.h"
 #include "flatflow/scheduler/scheduler.h"
 
 namespace flatflow {
@@ -65,12 +73,16 @@ class ControlPlaneServiceImpl final : public ControlPlane::Service {
 
   ControlPlaneServiceImpl(size_type data_parallel_world_size)
       : data_parallel_world_size_(data_parallel_world_size) {
-    producers_.reserve(data_parallel_world_size);
-    consumers_.reserve(data_parallel_world_size);
+    sessions_.resize(static_cast<std::size_t>(Mode::MAX) + 1);
 
-    for (size_type rank = 0; rank < data_parallel_world_size; ++rank) {
-      producers_.emplace_back();
-      consumers_.emplace_back(producers_[rank].get_future());
+    for (auto &session : sessions_) {
+      session.producers.reserve(data_parallel_world_size);
+      session.consumers.reserve(data_parallel_world_size);
+
+      for (size_type rank = 0; rank < data_parallel_world_size; ++rank) {
+        session.producers.emplace_back();
+        session.consumers.emplace_back(session.producers[rank].get_future());
+      }
     }
   }
 
@@ -94,7 +106,9 @@ class ControlPlaneServiceImpl final : public ControlPlane::Service {
 
   // ControlPlaneServiceImpl::Init()
   //
-  // Initializes the training environment.
+  // Initializes the training environment, or the evaluation environment if
+  // the mode of the request is `Mode::EVAL`. Each mode is a session of its
+  // own, so the evaluation environment can be initialized at any time.
   grpc::Status Init(grpc::ServerContext *context,
                     const flatbuffers::grpc::Message<InitRequest> *request,
                     flatbuffers::grpc::Message<Empty> *response) override {
@@ -110,12 +124,150 @@ class ControlPlaneServiceImpl final : public ControlPlane::Service {
     const auto sizes = args->sizes();
     CHECK_NE(sizes, nullptr);
 
-    global_batch_size_ = args->global_batch_size();
-    scheduler_ = Scheduler(data_parallel_world_size_, global_batch_size_,
-                           args->micro_batch_size(), sizes->begin(),
-                           sizes->end(), args->graph());
+    auto &session = sessions_[static_cast<std::size_t>(args->mode())];
+
+    auto options = SchedulerOptions();
+
+    // The topology is optional; if not given, the data parallel group is
+    // treated as flat.
+    const auto topology = args->topology();
+    if (topology != nullptr) {
+      options.node_ids.resize(data_parallel_world_size_);
+
+      const auto node_ids = topology->node_ids();
+      if (node_ids != nullptr) {
+        CHECK_EQ(node_ids->size(), data_parallel_world_size_);
+        std::copy(node_ids->begin(), node_ids->end(),
+                  options.node_ids.begin());
+      } else {
+        const auto ranks_per_node = topology->ranks_per_node();
+        CHECK_NE(ranks_per_node, static_cast<size_type>(0));
+        for (size_type rank = 0; rank < data_parallel_world_size_; ++rank) {
+          options.node_ids[rank] = rank / ranks_per_node;
+        }
+      }
+    }
+
+    options.context_parallel_world_size = args->context_parallel_world_size();
+    options.context_parallel_threshold = args->context_parallel_threshold();
+    options.pad_to_longest = args->pad_to_longest();
+    options.pipeline_parallel_world_size =
+        args->pipeline_parallel_world_size();
+    options.bound_inflight_activations = args->bound_inflight_activations();
+
+    const auto offsets = args->offsets();
+    if (offsets != nullptr) {
+      options.offsets.assign(offsets->begin(), offsets->end());
+    }
+
+    const auto shard_affinity = args->shard_affinity();
+    if (shard_affinity != nullptr) {
+      CHECK_NE(shard_affinity->shard_ids(), nullptr);
+      CHECK_NE(shard_affinity->node_ids(), nullptr);
+      options.shard_ids.assign(shard_affinity->shard_ids()->begin(),
+                               shard_affinity->shard_ids()->end());
+      options.shard_node_ids.assign(shard_affinity->node_ids()->begin(),
+                                    shard_affinity->node_ids()->end());
+      options.max_balance_penalty = shard_affinity->max_balance_penalty();
+    }
+
+    options.uneven_microbatches = args->uneven_microbatches();
+
+    const auto bucket_capacities = args->bucket_capacities();
+    if (bucket_capacities != nullptr) {
+      options.bucket_capacities.assign(bucket_capacities->begin(),
+                                       bucket_capacities->end());
+    }
+    session.has_buckets = !options.bucket_capacities.empty();
+
+    options.memory_cost = args->memory_cost();
+    options.tensor_parallel_world_size = args->tensor_parallel_world_size();
+    options.communication_cost = args->communication_cost();
+    options.forward_only = args->mode() != Mode::TRAIN;
+
+    // Recomputation is planned apart from scheduling, as it does not affect
+    // the order of samples. There is nothing to recompute without backward
+    // passes.
+    session.has_planner =
+        args->memory_budget() != 0 && !options.forward_only;
+    if (session.has_planner) {
+      auto recompute_options = RecomputeOptions();
+      recompute_options.pipeline_parallel_world_size =
+          args->pipeline_parallel_world_size();
+      recompute_options.bytes_per_element = args->bytes_per_element();
+      recompute_options.pad_to_longest = args->pad_to_longest();
+      session.planner = RecomputePlanner(sizes->begin(), sizes->end(),
+                                         args->graph(), args->memory_budget(),
+                                         recompute_options);
+    }
+
+    session.mode = args->mode();
+    session.global_batch_size = args->global_batch_size();
+    session.micro_batch_size = args->micro_batch_size();
+    session.indices.clear();
+
+    if (session.mode == Mode::INFER) {
+      const auto output_sizes = args->output_sizes();
+      CHECK_NE(output_sizes, nullptr);
+      CHECK_EQ(output_sizes->size(), sizes->size());
+      session.inference = InferenceScheduler(
+          data_parallel_world_size_, sizes->begin(), sizes->end(),
+          output_sizes->begin(), args->graph(), args->kv_cache_budget(),
+          session.micro_batch_size);
+    } else {
+      // Policy parameters are given as a FlexBuffers map, so that each policy
+      // can take its own parameters without changing the schema. Parameters
+      // unknown to the selected policy are ignored with a warning rather than
+      // rejected, so that the same request can be sent to older control
+      // planes.
+      const auto params = args->policy_params();
+      if (params != nullptr && params->size() != 0) {
+        const auto map = args->policy_params_flexbuffer_root().AsMap();
+        const auto keys = map.Keys();
+        for (std::size_t index = 0; index < keys.size(); ++index) {
+          const auto key = keys[index].AsKey();
+          if (args->policy() == Policy::BLDM &&
+              std::string_view(key) == "max_gap") {
+            options.max_partition_gap = map[key].AsDouble();
+          } else if (args->policy() == Policy::BLDM &&
+                     std::string_view(key) == "time_limit") {
+            options.partition_time_limit = map[key].AsDouble();
+          } else if (args->policy() == Policy::BLDM &&
+                     std::string_view(key) == "memoize") {
+            options.memoize_schedule = map[key].AsBool();
+          } else if (args->policy() == Policy::BLDM &&
+                     std::string_view(key) == "exact") {
+            options.exact_partition = map[key].AsBool();
+          } else {
+            LOG(WARNING) << absl::StrFormat(
+                "Ignoring unknown parameter %s of policy %s", key,
+                EnumNamePolicy(args->policy()));
+          }
+        }
+      }
 
-    _call_callbacks_on_train_begin();
+      switch (args->policy()) {
+        case Policy::SEQUENTIAL:
+          session.scheduler = SequentialScheduler(
+              data_parallel_world_size_, session.global_batch_size,
+              session.micro_batch_size, sizes->begin(), sizes->end(),
+              args->graph(), options);
+          break;
+        default:
+          session.scheduler = Scheduler(
+              data_parallel_world_size_, session.global_batch_size,
+              session.micro_batch_size, sizes->begin(), sizes->end(),
+              args->graph(), options);
+          break;
+      }
+
+      LOG(INFO) << absl::StrFormat("Using %s scheduling policy",
+                                   EnumNamePolicy(args->policy()));
+    }
+
+    if (session.mode == Mode::TRAIN) {
+      _call_callbacks_on_train_begin();
+    }
 
     auto builder = flatbuffers::grpc::MessageBuilder();
     const auto empty = CreateEmpty(builder);
@@ -142,44 +294,115 @@ class ControlPlaneServiceImpl final : public ControlPlane::Service {
 
     const auto rank = args->rank();
 
+    auto &session = sessions_[static_cast<std::size_t>(args->mode())];
+
     // clang-format off
     LOG(INFO) << absl::StrFormat("Broadcast called from %s (rank %u)", context->peer(), rank);
     // clang-format on
 
     if (rank == 0) {
-      if (!indices_.empty()) {
+      // Evaluation does not mark an epoch of training, so callbacks are only
+      // called for the training session.
+      const auto is_train = session.mode == Mode::TRAIN;
+
+      if (is_train && !session.indices.empty()) {
         _call_callbacks_on_epoch_end();
       }
 
-      epoch_ = args->epoch();
-      _call_callbacks_on_epoch_begin();
+      if (is_train) {
+        epoch_ = args->epoch();
+        _call_callbacks_on_epoch_begin();
+      }
 
       const auto indices = args->indices();
       CHECK_NE(indices, nullptr);
 
-      indices_.resize(indices->size());
-      scheduler_.Schedule(indices->begin(), indices->end(), indices_.begin());
+      session.indices.resize(indices->size());
+      if (session.mode == Mode::INFER) {
+        session.batch_sizes = session.inference.Schedule(
+            indices->begin(), indices->end(), session.indices.begin());
+      } else {
+        session.batch_sizes.resize(
+            (session.indices.size() + session.global_batch_size - 1) /
+            session.global_batch_size * data_parallel_world_size_);
+        session.scheduler.Schedule(indices->begin(), indices->end(),
+                                   session.indices.begin(),
+                                   session.batch_sizes.begin());
+      }
 
       for (size_type rank = 0; rank < data_parallel_world_size_; ++rank) {
-        producers_[rank].set_value();
+        session.producers[rank].set_value();
       }
     }
 
-    consumers_[rank].get();
+    session.consumers[rank].get();
 
     // The promise-future communication channel is disposable; each worker
     // should reset its own channel after receiving a fanout signal.
-    producers_[rank] = std::promise<void>();
-    consumers_[rank] = producers_[rank].get_future();
+    session.producers[rank] = std::promise<void>();
+    session.consumers[rank] = session.producers[rank].get_future();
+
+    auto batch_sizes = std::vector<size_type>(session.batch_sizes.size() /
+                                              data_parallel_world_size_);
+    for (size_type index = 0; index < batch_sizes.size(); ++index) {
+      batch_sizes[index] =
+          session.batch_sizes[data_parallel_world_size_ * index + rank];
+    }
 
-    auto indices =
-        std::vector<size_type>(indices_.size() / data_parallel_world_size_);
-    internal::Scatter(indices_.begin(), indices_.end(), indices.begin(),
-                      data_parallel_world_size_, rank, global_batch_size_);
+    // The per-rank batches differ in size if micro-batch counts are uneven,
+    // so the reordered schedule is scattered by the sizes of the per-rank
+    // batches rather than by a fixed stride.
+    auto indices = std::vector<size_type>(std::reduce(
+        batch_sizes.cbegin(), batch_sizes.cend(), static_cast<size_type>(0)));
+    internal::Scatterv(session.indices.begin(), session.indices.end(),
+                       indices.begin(), session.batch_sizes.begin(),
+                       data_parallel_world_size_, rank);
+
+    auto split = std::vector<bool>(indices.size());
+    std::transform(
+        indices.cbegin(), indices.cend(), split.begin(),
+        [&](size_type index) { return session.scheduler.IsSplit(index); });
+
+    // Every per-rank batch consists of whole micro-batches, except that the
+    // last one may end with a smaller micro-batch. Batches for inference are
+    // bounded by the KV-cache budget instead, so each is a micro-batch.
+    const auto is_infer = session.mode == Mode::INFER;
+    auto boundaries = std::vector<size_type>({0});
+    auto num_tokens = std::vector<size_type>();
+    auto costs = std::vector<typename AnyScheduler::value_type>();
+    auto buckets = std::vector<size_type>();
+    auto recompute = std::vector<size_type>();
+
+    auto offset = static_cast<size_type>(0);
+    for (const auto batch_size : batch_sizes) {
+      const auto step_size = is_infer ? batch_size : session.micro_batch_size;
+      for (size_type step = 0; step < batch_size; step += step_size) {
+        const auto first = std::next(indices.cbegin(), offset + step);
+        const auto last = std::next(
+            indices.cbegin(), offset + std::min(step + step_size, batch_size));
+
+        boundaries.emplace_back(std::distance(indices.cbegin(), last));
+        num_tokens.emplace_back(is_infer
+                                    ? session.inference.NumTokens(first, last)
+                                    : session.scheduler.NumTokens(first, last));
+        costs.emplace_back(is_infer ? session.inference.Cost(first, last)
+                                    : session.scheduler.Cost(first, last));
+        if (session.has_buckets) {
+          buckets.emplace_back(session.scheduler.Bucket(first, last));
+        }
+        if (session.has_planner) {
+          recompute.emplace_back(session.planner.Plan(first, last));
+        }
+      }
+      offset += batch_size;
+    }
 
     auto builder = flatbuffers::grpc::MessageBuilder();
-    const auto resp =
-        CreateBroadcastResponse(builder, builder.CreateVector(indices));
+    const auto resp = CreateBroadcastResponse(
+        builder, builder.CreateVector(indices), builder.CreateVector(split),
+        builder.CreateVector(batch_sizes), builder.CreateVector(boundaries),
+        builder.CreateVector(num_tokens), builder.CreateVector(costs),
+        builder.CreateVector(buckets), builder.CreateVector(recompute));
     builder.Finish(resp);
     *response = builder.ReleaseMessage<BroadcastResponse>();
 
@@ -212,42 +435,64 @@ class ControlPlaneServiceImpl final : public ControlPlane::Service {
   }
 
  private:
+  // ControlPlaneServiceImpl::Session
+  //
+  // A `Session` holds the schedule of each mode along with the communication
+  // channels to fan it out to the data plane.
+  struct Session {
+    Mode mode;
+    size_type global_batch_size;
+    size_type micro_batch_size;
+    bool has_buckets;
+    bool has_planner;
+    std::vector<size_type> batch_sizes;
+    std::vector<size_type> indices;
+    std::vector<std::promise<void>> producers;
+    std::vector<std::future<void>> consumers;
+    AnyScheduler scheduler;
+    InferenceScheduler inference;
+    RecomputePlanner planner;
+  };
+
+  // ControlPlaneServiceImpl::training()
+  //
+  // Returns the training session, whose scheduler receives the callbacks.
+  const Session &training() const noexcept {
+    return sessions_[static_cast<std::size_t>(Mode::TRAIN)];
+  }
+
   // ControlPlaneServiceImpl::_call_callbacks_on_epoch_begin()
   //
   // Calls every callback's `on_epoch_begin` hook.
   void _call_callbacks_on_epoch_begin() const noexcept {
-    scheduler_.on_epoch_begin(epoch_);
+    training().scheduler.on_epoch_begin(epoch_);
   }
 
   // ControlPlaneServiceImpl::_call_callbacks_on_epoch_end()
   //
   // Calls every callback's `on_epoch_end` hook.
   void _call_callbacks_on_epoch_end() const noexcept {
-    scheduler_.on_epoch_end(epoch_);
+    training().scheduler.on_epoch_end(epoch_);
   }
 
   // ControlPlaneServiceImpl::_call_callbacks_on_train_begin()
   //
   // Calls every callback's `on_train_begin` hook.
   void _call_callbacks_on_train_begin() const noexcept {
-    scheduler_.on_train_begin();
+    training().scheduler.on_train_begin();
   }
 
   // ControlPlaneServiceImpl::_call_callbacks_on_train_end()
   //
   // Calls every callback's `on_train_end` hook.
   void _call_callbacks_on_train_end() const noexcept {
-    scheduler_.on_train_end();
+    training().scheduler.on_train_end();
   }
 
   size_type data_parallel_world_size_;
   size_type epoch_;
-  size_type global_batch_size_;
-  std::vector<size_type> indices_;
-  std::vector<std::promise<void>> producers_;
-  std::vector<std::future<void>> consumers_;
+  std::vector<Session> sessions_;
   std::future<int> signal_;
-  Scheduler scheduler_;
 };
 
 // flatflow::run()
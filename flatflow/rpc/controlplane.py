@@ -12,35 +12,74 @@
 # See the License for the specific language governing permissions and
 # limitations under the License.
 
-from collections.abc import Sequence
-from typing import Optional
+from collections.abc import Mapping, Sequence
+from typing import Any, Optional
 
 import flatbuffers
 import grpc
 import torch.fx
+from flatbuffers import flexbuffers
 from numpy.typing import ArrayLike
 
 from flatflow.ops import serialize
 from flatflow.rpc.controlplane_generated import (
     BroadcastRequestAddEpoch,
     BroadcastRequestAddIndices,
+    BroadcastRequestAddMode,
     BroadcastRequestAddRank,
     BroadcastRequestEnd,
     BroadcastRequestStart,
     BroadcastRequestStartIndicesVector,
     BroadcastResponse,
+    InitRequestAddBoundInflightActivations,
+    InitRequestAddBucketCapacities,
+    InitRequestAddBytesPerElement,
+    InitRequestAddCommunicationCost,
+    InitRequestAddContextParallelThreshold,
+    InitRequestAddContextParallelWorldSize,
     InitRequestAddGlobalBatchSize,
     InitRequestAddGraph,
+    InitRequestAddKvCacheBudget,
+    InitRequestAddMemoryBudget,
+    InitRequestAddMemoryCost,
     InitRequestAddMicroBatchSize,
+    InitRequestAddMode,
+    InitRequestAddOffsets,
+    InitRequestAddOutputSizes,
+    InitRequestAddPadToLongest,
+    InitRequestAddPipelineParallelWorldSize,
+    InitRequestAddPolicy,
+    InitRequestAddPolicyParams,
+    InitRequestAddShardAffinity,
     InitRequestAddSizes,
+    InitRequestAddTensorParallelWorldSize,
+    InitRequestAddTopology,
+    InitRequestAddUnevenMicrobatches,
     InitRequestEnd,
     InitRequestStart,
+    InitRequestStartBucketCapacitiesVector,
+    InitRequestStartOffsetsVector,
+    InitRequestStartOutputSizesVector,
     InitRequestStartSizesVector,
+    Mode,
+    Policy,
+    ShardAffinityAddMaxBalancePenalty,
+    ShardAffinityAddNodeIds,
+    ShardAffinityAddShardIds,
+    ShardAffinityEnd,
+    ShardAffinityStart,
+    ShardAffinityStartNodeIdsVector,
+    ShardAffinityStartShardIdsVector,
+    TopologyAddNodeIds,
+    TopologyAddRanksPerNode,
+    TopologyEnd,
+    TopologyStart,
+    TopologyStartNodeIdsVector,
 )
 from flatflow.rpc.controlplane_grpc_fb import ControlPlaneStub
 from flatflow.rpc.empty_generated import EmptyEnd, EmptyStart
 
-__all__ = ["ControlPlaneClient"]
+__all__ = ["ControlPlaneClient", "Mode", "Policy"]
 
 
 class ControlPlaneClient(object):
@@ -49,13 +88,23 @@ class ControlPlaneClient(object):
     Args:
         rank (int): Rank of the current process within the data-parallel group.
         channel (grpc.Channel): A channel object.
+        mode (int, optional): The session to communicate with. ``Mode.EVAL``
+            schedules forward passes only, and ``Mode.INFER`` packs samples into
+            batches within a KV-cache budget for offline batch inference. Neither
+            finalizes the control plane.
     """
 
     rank: int
+    mode: int
     stub: ControlPlaneStub
+    response: Optional[BroadcastResponse]
 
-    def __init__(self, rank: int, channel: grpc.Channel) -> None:
+    def __init__(
+        self, rank: int, channel: grpc.Channel, mode: int = Mode.TRAIN
+    ) -> None:
         self.rank = rank
+        self.mode = mode
+        self.response = None
         # Block until the control plane is ready.
         grpc.channel_ready_future(channel).result()
         self.stub = ControlPlaneStub(channel)
@@ -66,8 +115,30 @@ class ControlPlaneClient(object):
         micro_batch_size: int,
         graph: torch.fx.Graph,
         sizes: Sequence[int],
+        ranks_per_node: Optional[int] = None,
+        node_ids: Optional[Sequence[int]] = None,
+        context_parallel_world_size: int = 1,
+        context_parallel_threshold: Optional[int] = None,
+        pad_to_longest: bool = False,
+        pipeline_parallel_world_size: int = 1,
+        bound_inflight_activations: bool = False,
+        offsets: Optional[Sequence[int]] = None,
+        shard_ids: Optional[Sequence[int]] = None,
+        shard_node_ids: Optional[Sequence[int]] = None,
+        max_balance_penalty: float = 0.0,
+        uneven_microbatches: bool = False,
+        bucket_capacities: Optional[Sequence[int]] = None,
+        memory_cost: int = 0,
+        tensor_parallel_world_size: int = 1,
+        communication_cost: int = 0,
+        memory_budget: int = 0,
+        bytes_per_element: int = 2,
+        output_sizes: Optional[Sequence[int]] = None,
+        kv_cache_budget: int = 0,
+        policy: int = Policy.BLDM,
+        policy_params: Optional[Mapping[str, Any]] = None,
     ) -> None:
-        """Initializes the training environment.
+        """Initializes the environment of this session.
 
         Args:
             global_batch_size (int): The global batch size.
@@ -75,6 +146,89 @@ class ControlPlaneClient(object):
             graph (torch.fx.Graph): A computational graph traced from the given model.
             sizes (Sequence[int]): A vector representing the mapping from an index to
                 the user-defined size of the corresponding data sample.
+            ranks_per_node (int, optional): The number of data-parallel ranks on each
+                node, assuming that consecutive ranks reside on the same node.
+                If given, micro-batches are partitioned hierarchically across nodes
+                and then across the ranks within each node.
+            node_ids (Sequence[int], optional): A vector representing the mapping from
+                a data-parallel rank to the node it resides on. This takes precedence
+                over ``ranks_per_node``.
+            context_parallel_world_size (int, optional): The context-parallel size.
+            context_parallel_threshold (int, optional): The minimum size of a data
+                sample to be split across the context-parallel group. Such samples are
+                costed as ``1 / context_parallel_world_size`` of their original cost,
+                and are flagged in the response of :meth:`Broadcast`.
+            pad_to_longest (bool, optional): Whether samples in each micro-batch are
+                padded to the longest one rather than concatenated. If ``True``, the
+                cost of a micro-batch is that of its longest sample times its size.
+            pipeline_parallel_world_size (int, optional): The pipeline-parallel size.
+            bound_inflight_activations (bool, optional): Whether to order micro-batches
+                so that the activations held in flight by 1F1B pipeline schedules stay
+                balanced across every ``pipeline_parallel_world_size`` consecutive
+                micro-batches, rather than peaking at the end of each iteration.
+            offsets (Sequence[int], optional): A vector representing the mapping from
+                an index to the storage offset of the corresponding data sample.
+                If given, samples in each micro-batch are ordered by their offsets.
+            shard_ids (Sequence[int], optional): A vector representing the mapping from
+                an index to the dataset shard of the corresponding data sample.
+            shard_node_ids (Sequence[int], optional): A vector representing the mapping
+                from a shard to the node that holds it locally. If given along with
+                ``shard_ids`` and the topology, samples are exchanged between ranks so
+                that each rank mostly reads local data.
+            max_balance_penalty (float, optional): The maximum fraction by which the
+                cost of the slowest rank may grow for locality.
+            uneven_microbatches (bool, optional): Whether data-parallel ranks may take
+                different numbers of micro-batches from each global batch. If ``True``,
+                the per-rank batch sizes are given in the response of :meth:`Broadcast`,
+                and losses should be normalized by the mean number of micro-batches
+                per rank to keep gradient accumulation unbiased. Experimental and for
+                internal use only; the NeMo sampler does not support this.
+            bucket_capacities (Sequence[int], optional): The capacities of shape
+                buckets in tokens, in ascending order. If given, each micro-batch is
+                assigned to the smallest bucket that holds it, so that it can be
+                padded to the bucket capacity to reuse compiled graphs; the bucket
+                of each micro-batch is given in the response of :meth:`Broadcast`.
+            memory_cost (int, optional): The number of FLOPs that take as long as
+                moving one element to or from memory, e.g., about 300 for bf16 on
+                A100. If nonzero, the graph is costed after fusing elementwise chains
+                and dropping views and copies, with memory traffic charged at this
+                rate on top of FLOPs.
+            tensor_parallel_world_size (int, optional): The tensor-parallel size.
+            communication_cost (int, optional): The number of FLOPs that take as long
+                as sending one element between tensor-parallel ranks, i.e., the peak
+                FLOP/s of each rank times ``bytes_per_element`` over the link
+                bandwidth; e.g., about 19500 for bf16 on A100 over PCIe 4.0. If
+                nonzero along with ``tensor_parallel_world_size``, the all-reduces
+                after row-parallel projections are charged on top of FLOPs.
+            memory_budget (int, optional): The activation memory budget of each rank
+                in bytes. If nonzero, the number of layers of each pipeline stage to
+                recompute is planned for each micro-batch so that its activations fit
+                in an equal share of the budget among the micro-batches in flight;
+                the plan is given in the response of :meth:`Broadcast`.
+            bytes_per_element (int, optional): The number of bytes per activation
+                element, e.g., 2 for bf16.
+            output_sizes (Sequence[int], optional): A vector representing the mapping
+                from an index to the expected output length of the corresponding data
+                sample. Required for ``Mode.INFER``.
+            kv_cache_budget (int, optional): The number of tokens the KV cache of each
+                rank holds. Required for ``Mode.INFER``, where each batch is bounded
+                by this budget and by ``micro_batch_size`` samples, and
+                ``global_batch_size`` is ignored.
+            policy (int, optional): The scheduling policy. ``Policy.BLDM`` balances
+                micro-batches across data-parallel ranks, while ``Policy.SEQUENTIAL``
+                keeps the given order as a baseline to measure the effect of
+                reordering. Ignored for ``Mode.INFER``.
+            policy_params (Mapping[str, Any], optional): The parameters of the
+                scheduling policy, which are ignored with a warning if unknown to it.
+                ``Policy.BLDM`` takes ``max_gap`` and ``time_limit``; if the latter
+                is nonzero, partitions whose cost of the slowest rank exceeds a lower
+                bound by more than a fraction of ``max_gap`` are refined by local
+                search for up to ``time_limit`` seconds per global batch. It also
+                takes ``exact``, off by default, to solve small partitions exactly
+                where possible, and ``memoize``, off by default, to reuse the
+                schedules of global batches that were also in the previous call to
+                :meth:`Broadcast`. Partitioning gaps are reported only if
+                ``max_gap``, ``time_limit`` or ``exact`` is set.
         """
         assert self.rank == 0
 
@@ -87,11 +241,92 @@ class ControlPlaneClient(object):
             builder.PrependUint32(size)
         _sizes = builder.EndVector()
 
+        if offsets is not None:
+            InitRequestStartOffsetsVector(builder, len(offsets))
+            for offset in reversed(offsets):
+                builder.PrependUint64(offset)
+            _offsets = builder.EndVector()
+
+        if output_sizes is not None:
+            InitRequestStartOutputSizesVector(builder, len(output_sizes))
+            for size in reversed(output_sizes):
+                builder.PrependUint32(size)
+            _output_sizes = builder.EndVector()
+
+        if bucket_capacities is not None:
+            InitRequestStartBucketCapacitiesVector(builder, len(bucket_capacities))
+            for capacity in reversed(bucket_capacities):
+                builder.PrependUint64(capacity)
+            _bucket_capacities = builder.EndVector()
+
+        if policy_params is not None:
+            _policy_params = builder.CreateByteVector(flexbuffers.Dumps(policy_params))
+
+        has_topology = ranks_per_node is not None or node_ids is not None
+        if has_topology:
+            if node_ids is not None:
+                TopologyStartNodeIdsVector(builder, len(node_ids))
+                for node_id in reversed(node_ids):
+                    builder.PrependUint64(node_id)
+                _node_ids = builder.EndVector()
+
+            TopologyStart(builder)
+            if ranks_per_node is not None:
+                TopologyAddRanksPerNode(builder, ranks_per_node)
+            if node_ids is not None:
+                TopologyAddNodeIds(builder, _node_ids)
+            _topology = TopologyEnd(builder)
+
+        has_shard_affinity = shard_ids is not None and shard_node_ids is not None
+        if has_shard_affinity:
+            ShardAffinityStartShardIdsVector(builder, len(shard_ids))
+            for shard_id in reversed(shard_ids):
+                builder.PrependUint32(shard_id)
+            _shard_ids = builder.EndVector()
+
+            ShardAffinityStartNodeIdsVector(builder, len(shard_node_ids))
+            for node_id in reversed(shard_node_ids):
+                builder.PrependUint64(node_id)
+            _shard_node_ids = builder.EndVector()
+
+            ShardAffinityStart(builder)
+            ShardAffinityAddShardIds(builder, _shard_ids)
+            ShardAffinityAddNodeIds(builder, _shard_node_ids)
+            ShardAffinityAddMaxBalancePenalty(builder, max_balance_penalty)
+            _shard_affinity = ShardAffinityEnd(builder)
+
         InitRequestStart(builder)
+        InitRequestAddMode(builder, self.mode)
         InitRequestAddGlobalBatchSize(builder, global_batch_size)
         InitRequestAddMicroBatchSize(builder, micro_batch_size)
         InitRequestAddGraph(builder, _graph)
         InitRequestAddSizes(builder, _sizes)
+        if has_topology:
+            InitRequestAddTopology(builder, _topology)
+        InitRequestAddContextParallelWorldSize(builder, context_parallel_world_size)
+        if context_parallel_threshold is not None:
+            InitRequestAddContextParallelThreshold(builder, context_parallel_threshold)
+        InitRequestAddPadToLongest(builder, pad_to_longest)
+        InitRequestAddPipelineParallelWorldSize(builder, pipeline_parallel_world_size)
+        InitRequestAddBoundInflightActivations(builder, bound_inflight_activations)
+        if offsets is not None:
+            InitRequestAddOffsets(builder, _offsets)
+        if has_shard_affinity:
+            InitRequestAddShardAffinity(builder, _shard_affinity)
+        InitRequestAddUnevenMicrobatches(builder, uneven_microbatches)
+        if bucket_capacities is not None:
+            InitRequestAddBucketCapacities(builder, _bucket_capacities)
+        InitRequestAddMemoryCost(builder, memory_cost)
+        InitRequestAddTensorParallelWorldSize(builder, tensor_parallel_world_size)
+        InitRequestAddCommunicationCost(builder, communication_cost)
+        InitRequestAddMemoryBudget(builder, memory_budget)
+        InitRequestAddBytesPerElement(builder, bytes_per_element)
+        if output_sizes is not None:
+            InitRequestAddOutputSizes(builder, _output_sizes)
+        InitRequestAddKvCacheBudget(builder, kv_cache_budget)
+        InitRequestAddPolicy(builder, policy)
+        if policy_params is not None:
+            InitRequestAddPolicyParams(builder, _policy_params)
         request = InitRequestEnd(builder)
         builder.Finish(request)
 
@@ -102,6 +337,19 @@ class ControlPlaneClient(object):
     ) -> ArrayLike:
         """Returns the reordered computation schedule for the next training epoch.
 
+        The decoded response is kept in :attr:`response` to access per-sample
+        metadata, e.g., ``response.SplitAsNumpy()`` for whether each sample is split
+        across the context-parallel group, and ``response.SizesAsNumpy()`` for the
+        number of samples taken from each global batch. Each micro-batch spans
+        the range of ``indices`` between two consecutive entries of
+        ``response.BoundariesAsNumpy()``, and ``response.NumTokensAsNumpy()`` and
+        ``response.CostsAsNumpy()`` give its number of tokens and predicted cost.
+        If shape buckets are given, ``response.BucketsAsNumpy()`` gives the bucket
+        of each micro-batch, which is the number of buckets if none holds it.
+        If a memory budget is given, ``response.RecomputeAsNumpy()`` gives the number
+        of layers of each pipeline stage to recompute for each micro-batch.
+        For ``Mode.INFER``, each micro-batch is a whole batch to generate at once.
+
         Args:
             epoch (int): The epoch number.
             indices (Sequence[int], optional): The original computation schedule.
@@ -119,6 +367,7 @@ class ControlPlaneClient(object):
             _indices = builder.EndVector()
 
         BroadcastRequestStart(builder)
+        BroadcastRequestAddMode(builder, self.mode)
         BroadcastRequestAddEpoch(builder, epoch)
         BroadcastRequestAddRank(builder, self.rank)
         if self.rank == 0:
@@ -127,11 +376,13 @@ class ControlPlaneClient(object):
         builder.Finish(request)
 
         response = self.stub.Broadcast(bytes(builder.Output()))
-        return BroadcastResponse.GetRootAs(response).IndicesAsNumpy()  # type: ignore[call-arg]
+        self.response = BroadcastResponse.GetRootAs(response)  # type: ignore[call-arg]
+        return self.response.IndicesAsNumpy()
 
     def Finalize(self) -> None:
         """Terminates the training environment."""
         assert self.rank == 0
+        assert self.mode == Mode.TRAIN
 
         builder = flatbuffers.Builder()
 
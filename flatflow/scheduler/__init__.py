@@ -0,0 +1,4 @@
+from flatflow.scheduler.advisor import advise_stages
+from flatflow.scheduler.autotuner import autotune
+
+__all__ = ["advise_stages", "autotune"]
@@ -0,0 +1,283 @@
+// Copyright 2025 The FlatFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FLATFLOW_SCHEDULER_ADVISOR_H_
+#define FLATFLOW_SCHEDULER_ADVISOR_H_
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "absl/log/check.h"
+#include "absl/log/log.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_join.h"
+
+#include "flatflow/ops/graph_generated.h"
+#include "flatflow/ops/internal/piecewise_polynomial.h"
+#include "flatflow/ops/ops.h"
+
+namespace flatflow {
+
+// flatflow::StageSplit
+//
+// A `flatflow::StageSplit` assigns consecutive layers to each pipeline stage.
+// The cost of each stage is given as its share of the total cost over the
+// dataset, so the ideal split has a maximum stage cost of one over the number
+// of stages.
+struct StageSplit {
+  std::vector<std::string> layers;
+  std::vector<std::size_t> num_layers;
+  std::vector<double> stage_costs;
+  double max_stage_cost;
+};
+
+// flatflow::StageAdvisor
+//
+// A `flatflow::StageAdvisor` proposes how to split the layers of the given
+// model into pipeline stages. Layers are identified by the module paths of
+// the nodes, and each layer is costed over the sizes of the whole dataset,
+// since the slowest stage bounds the throughput of the pipeline over all
+// micro-batches. Layers such as embeddings and output heads differ in cost
+// from the repeated layers and may even grow differently with size, which
+// splitting by layer count does not account for.
+//
+// Graphs with fewer layers than stages, such as those traced without module
+// paths, are split by node instead, where each node is taken as a layer named
+// after its position in the graph.
+class StageAdvisor {
+ public:
+  using value_type = typename OperatorRegistry::value_type;
+  using size_type = std::size_t;
+
+  // Constructors and assignment operators
+  //
+  // The graph is traced once upon construction and need not outlive the
+  // advisor.
+  template <typename InputIterator>
+  StageAdvisor(size_type pipeline_parallel_world_size, InputIterator first,
+               InputIterator last, const Graph *graph)
+      : pipeline_parallel_world_size_(pipeline_parallel_world_size) {
+    constexpr auto kZero = static_cast<size_type>(0);
+    CHECK_NE(pipeline_parallel_world_size, kZero);
+    CHECK_NE(graph, nullptr);
+
+    const auto sizes = std::vector<value_type>(first, last);
+    CHECK_NE(sizes.size(), kZero);
+
+    auto layers = symbolic_trace_layers(graph);
+    if (layers.size() < pipeline_parallel_world_size) {
+      const auto nodes = graph->nodes();
+      CHECK_NE(nodes, nullptr);
+
+      // clang-format off
+      LOG(WARNING) << absl::StrFormat("Found %u layers for %u pipeline stages; splitting %u nodes instead", layers.size(), pipeline_parallel_world_size, nodes->size());
+      // clang-format on
+
+      const auto registry = OperatorRegistry();
+      layers.clear();
+      for (flatbuffers::uoffset_t index = 0; index < nodes->size(); ++index) {
+        layers.emplace_back(std::to_string(index),
+                            registry.dispatch(nodes->Get(index)));
+      }
+    }
+    CHECK_LE(pipeline_parallel_world_size, layers.size());
+
+    layers_.reserve(layers.size());
+    for (const auto &[name, poly] : layers) {
+      layers_.emplace_back(name);
+    }
+
+    costs_.resize(layers.size());
+
+    // clang-format off
+    #pragma omp parallel for
+    for (size_type index = 0; index < layers.size(); ++index) {
+      const auto &poly = layers[index].second;
+      auto cost = 0.0;
+      for (const auto size : sizes) {
+        cost += static_cast<double>(
+            internal::evaluate_piecewise_polynomial(poly, size));
+      }
+      costs_[index] = cost;
+    }
+    // clang-format on
+
+    const auto total = std::reduce(costs_.cbegin(), costs_.cend());
+    CHECK_GT(total, 0.0);
+    for (auto &cost : costs_) {
+      cost /= total;
+    }
+  }
+
+  StageAdvisor(const StageAdvisor &other) = default;
+
+  StageAdvisor &operator=(const StageAdvisor &other) = default;
+
+  StageAdvisor(StageAdvisor &&other) = default;
+
+  StageAdvisor &operator=(StageAdvisor &&other) = default;
+
+  // Accessors
+  //
+  // The layers are given in execution order, along with their shares of
+  // the total cost.
+  const std::vector<std::string> &layers() const noexcept { return layers_; }
+
+  const std::vector<double> &costs() const noexcept { return costs_; }
+
+  // StageAdvisor::Evaluate()
+  //
+  // Returns the split that assigns the given numbers of consecutive layers to
+  // the pipeline stages in order.
+  StageSplit Evaluate(const std::vector<size_type> &num_layers) const {
+    CHECK_EQ(num_layers.size(), pipeline_parallel_world_size_);
+    CHECK_EQ(std::reduce(num_layers.cbegin(), num_layers.cend(),
+                         static_cast<size_type>(0)),
+             layers_.size());
+
+    auto split = StageSplit{layers_, num_layers,
+                            std::vector<double>(num_layers.size()), 0.0};
+
+    auto offset = static_cast<size_type>(0);
+    for (size_type stage = 0; stage < num_layers.size(); ++stage) {
+      split.stage_costs[stage] =
+          std::reduce(std::next(costs_.cbegin(), offset),
+                      std::next(costs_.cbegin(), offset + num_layers[stage]));
+      offset += num_layers[stage];
+    }
+
+    split.max_stage_cost =
+        *std::max_element(split.stage_costs.cbegin(), split.stage_costs.cend());
+
+    return split;
+  }
+
+  // StageAdvisor::Uniform()
+  //
+  // Returns the split by layer count, as done by Megatron; the repeated
+  // layers are spread evenly over the stages with the first stages taking
+  // the remainder, while the layers before them go to the first stage and
+  // those after them go to the last stage. If there are fewer repeated layers
+  // than stages, all the layers are spread evenly instead.
+  StageSplit Uniform() const {
+    // A repeated layer is named after its index, e.g., `model.layers.0`.
+    const auto is_repeated = [](const std::string &layer) {
+      const auto pos = layer.rfind('.');
+      const auto index = pos == std::string::npos ? 0 : pos + 1;
+      return index < layer.size() &&
+             std::all_of(std::next(layer.cbegin(), index), layer.cend(),
+                         [](char c) {
+                           return std::isdigit(static_cast<unsigned char>(c)) !=
+                                  0;
+                         });
+    };
+
+    auto first = std::find_if(layers_.cbegin(), layers_.cend(), is_repeated);
+    auto last =
+        std::find_if(layers_.crbegin(), layers_.crend(), is_repeated).base();
+    if (last <= first || static_cast<size_type>(std::distance(first, last)) <
+                             pipeline_parallel_world_size_) {
+      first = layers_.cbegin();
+      last = layers_.cend();
+    }
+    const auto num_repeated =
+        static_cast<size_type>(std::distance(first, last));
+
+    auto num_layers = std::vector<size_type>(pipeline_parallel_world_size_);
+    for (size_type stage = 0; stage < pipeline_parallel_world_size_; ++stage) {
+      num_layers[stage] = num_repeated / pipeline_parallel_world_size_ +
+                          (stage < num_repeated % pipeline_parallel_world_size_
+                               ? 1
+                               : 0);
+    }
+    num_layers.front() +=
+        static_cast<size_type>(std::distance(layers_.cbegin(), first));
+    num_layers.back() +=
+        static_cast<size_type>(std::distance(last, layers_.cend()));
+
+    return Evaluate(num_layers);
+  }
+
+  // StageAdvisor::Advise()
+  //
+  // Returns the split that minimizes the maximum stage cost, where each stage
+  // takes at least one layer. This is the linear partition problem, solved
+  // exactly by dynamic programming over the prefix sums of the layer costs.
+  StageSplit Advise() const {
+    const auto num_stages = pipeline_parallel_world_size_;
+    const auto num_layers = layers_.size();
+
+    auto prefix = std::vector<double>(num_layers + 1);
+    std::partial_sum(costs_.cbegin(), costs_.cend(), std::next(prefix.begin()));
+
+    // `table[stage][index]` is the minimum of the maximum stage cost to split
+    // the first `index` layers into `stage + 1` stages, and `choices` holds
+    // the number of layers before the last of those stages.
+    constexpr auto kInfinity = std::numeric_limits<double>::infinity();
+    auto table = std::vector<std::vector<double>>(
+        num_stages, std::vector<double>(num_layers + 1, kInfinity));
+    auto choices = std::vector<std::vector<size_type>>(
+        num_stages, std::vector<size_type>(num_layers + 1));
+
+    for (size_type index = 1; index <= num_layers; ++index) {
+      table[0][index] = prefix[index];
+    }
+
+    for (size_type stage = 1; stage < num_stages; ++stage) {
+      for (size_type index = stage + 1; index <= num_layers; ++index) {
+        for (size_type pos = stage; pos < index; ++pos) {
+          const auto cost =
+              std::max(table[stage - 1][pos], prefix[index] - prefix[pos]);
+          if (cost < table[stage][index]) {
+            table[stage][index] = cost;
+            choices[stage][index] = pos;
+          }
+        }
+      }
+    }
+
+    auto split = std::vector<size_type>(num_stages);
+    auto index = num_layers;
+    for (size_type stage = num_stages - 1; 0 < stage; --stage) {
+      const auto pos = choices[stage][index];
+      split[stage] = index - pos;
+      index = pos;
+    }
+    split.front() = index;
+
+    const auto advice = Evaluate(split);
+
+    LOG(INFO) << absl::StrFormat(
+        "Proposed layers per stage: [%s] (maximum stage cost: %f, ideal: %f)",
+        absl::StrJoin(advice.num_layers, ", "), advice.max_stage_cost,
+        1.0 / static_cast<double>(num_stages));
+
+    return advice;
+  }
+
+ protected:
+  size_type pipeline_parallel_world_size_;
+  std::vector<std::string> layers_;
+  std::vector<double> costs_;
+};
+
+}  // namespace flatflow
+
+#endif  // FLATFLOW_SCHEDULER_ADVISOR_H_
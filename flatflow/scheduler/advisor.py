@@ -0,0 +1,58 @@
+# Copyright 2025 The FlatFlow Authors
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+from collections.abc import Sequence
+
+import flatbuffers
+import torch.fx
+
+from flatflow._C import StageSplit  # type: ignore[attr-defined]
+from flatflow._C import advise_stages as _advise_stages  # type: ignore[attr-defined]
+from flatflow.ops import serialize
+
+__all__ = ["advise_stages"]
+
+
+def advise_stages(
+    graph: torch.fx.Graph,
+    sizes: Sequence[int],
+    pipeline_parallel_world_size: int,
+) -> tuple[StageSplit, StageSplit]:
+    """Proposes how to split the layers of the model into pipeline stages.
+
+    Layers are identified by the module paths recorded in the graph, e.g.,
+    ``model.layers.0``, with embeddings and output heads as layers of their own.
+    Each layer is costed over the sizes of the whole dataset, and consecutive layers
+    are assigned to the stages so that the maximum stage cost is minimized.
+    Stage costs are given as shares of the total cost, so the ideal maximum stage
+    cost is ``1 / pipeline_parallel_world_size``.
+
+    Args:
+        graph (torch.fx.Graph): Exported computational graph of the model.
+        sizes (Sequence[int]): Sizes of the data samples in the dataset.
+        pipeline_parallel_world_size (int): Number of pipeline stages.
+
+    Returns:
+        The proposed split, and the split by layer count as done by Megatron for
+        comparison. ``num_layers`` of a split gives the number of layers of each
+        stage, e.g., to set the number of layers of the first and last pipeline
+        stages in Megatron.
+    """
+    builder = flatbuffers.Builder()
+    _graph = serialize(builder, graph)
+    builder.Finish(_graph)
+
+    return _advise_stages(
+        bytes(builder.Output()), list(sizes), pipeline_parallel_world_size
+    )
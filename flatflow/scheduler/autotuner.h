@@ -0,0 +1,307 @@
+// Copyright 2025 The FlatFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FLATFLOW_SCHEDULER_AUTOTUNER_H_
+#define FLATFLOW_SCHEDULER_AUTOTUNER_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <numeric>
+#include <vector>
+
+#include "absl/log/check.h"
+#include "absl/log/log.h"
+#include "absl/strings/str_format.h"
+
+#include "flatflow/ops/graph_generated.h"
+#include "flatflow/ops/ops.h"
+#include "flatflow/scheduler/scheduler.h"
+
+namespace flatflow {
+
+// flatflow::AutotunerOptions
+//
+// A `flatflow::AutotunerOptions` holds optional knobs for the cost model of
+// the autotuner.
+struct AutotunerOptions {
+  // The number of bytes per activation element, e.g., two for bf16.
+  std::size_t bytes_per_element = 2;
+
+  // The fixed cost of each micro-batch on top of its samples, such as weight
+  // loads and kernel launches, relative to the cost of a data sample of mean
+  // size. Without it, the cost model always favors the smallest micro-batches
+  // as they minimize pipeline bubbles.
+  double microbatch_overhead = 0.0;
+};
+
+// flatflow::Configuration
+//
+// A `flatflow::Configuration` is a candidate batching configuration along with
+// its predicted step time and memory headroom. Step times are given in units
+// of the cost of a data sample of mean size, so only their ratios are
+// meaningful.
+struct Configuration {
+  std::size_t global_batch_size;
+  std::size_t micro_batch_size;
+  double step_time;
+  double time_per_sample;
+  std::int64_t memory_headroom;
+};
+
+// flatflow::Autotuner
+//
+// A `flatflow::Autotuner` recommends the global batch size and micro-batch size
+// for the given model and dataset without trial runs. Each candidate is
+// evaluated by scheduling the dataset as the scheduler would, and then
+// predicting:
+//
+// * the step time of each global batch as the slowest replica, where each
+//   replica runs a one-forward-one-backward (1F1B) pipeline schedule; that is,
+//   the sum of its micro-batches spread over the pipeline stages plus
+//   a bubble of `pp - 1` largest micro-batches spread likewise, and
+// * the peak activation memory of the first pipeline stage, which holds up to
+//   `pp` consecutive micro-batches in flight.
+class Autotuner {
+ public:
+  using value_type = typename Scheduler::value_type;
+  using size_type = typename Scheduler::size_type;
+
+  // Constructors and assignment operators
+  //
+  // The graph should outlive the autotuner, since it is retraced for each
+  // candidate by the scheduler.
+  template <typename InputIterator>
+  Autotuner(size_type data_parallel_world_size,
+            size_type pipeline_parallel_world_size, InputIterator first,
+            InputIterator last, const Graph *graph, std::size_t memory_budget,
+            const AutotunerOptions &options = AutotunerOptions())
+      : data_parallel_world_size_(data_parallel_world_size),
+        pipeline_parallel_world_size_(pipeline_parallel_world_size),
+        memory_budget_(memory_budget),
+        options_(options),
+        graph_(graph) {
+    constexpr auto kZero = static_cast<size_type>(0);
+    CHECK_NE(data_parallel_world_size, kZero);
+    CHECK_NE(pipeline_parallel_world_size, kZero);
+    CHECK_NE(graph, nullptr);
+
+    sizes_.assign(first, last);
+    CHECK_NE(sizes_.size(), kZero);
+
+    preds_.resize(sizes_.size());
+    mems_.resize(sizes_.size());
+
+    const auto trace = symbolic_trace(graph);
+    const auto trace_activations = symbolic_trace_activations(graph);
+
+    // clang-format off
+    #pragma omp parallel for
+    for (size_type index = 0; index < sizes_.size(); ++index) {
+      preds_[index] = trace(sizes_[index]);
+      mems_[index] = trace_activations(sizes_[index]);
+    }
+    // clang-format on
+
+    mean_ = static_cast<double>(std::reduce(preds_.cbegin(), preds_.cend())) /
+            static_cast<double>(preds_.size());
+  }
+
+  Autotuner(const Autotuner &other) = default;
+
+  Autotuner &operator=(const Autotuner &other) = default;
+
+  Autotuner(Autotuner &&other) = default;
+
+  Autotuner &operator=(Autotuner &&other) = default;
+
+  // Autotuner::Evaluate()
+  //
+  // Predicts the step time and memory headroom of the given configuration,
+  // averaged and maximized over the global batches, respectively. The last
+  // global batch is excluded if incomplete.
+  Configuration Evaluate(size_type global_batch_size,
+                         size_type micro_batch_size) const {
+    constexpr auto kZero = static_cast<size_type>(0);
+    CHECK_NE(micro_batch_size, kZero);
+    CHECK_EQ(global_batch_size % (data_parallel_world_size_ * micro_batch_size),
+             kZero);
+
+    const auto total_size =
+        sizes_.size() / global_batch_size * global_batch_size;
+    CHECK_NE(total_size, kZero);
+
+    // Each configuration is scheduled once, so there is nothing to memoize.
+    auto scheduler_options = SchedulerOptions();
+    scheduler_options.pipeline_parallel_world_size =
+        pipeline_parallel_world_size_;
+    scheduler_options.memoize_schedule = false;
+
+    const auto scheduler =
+        Scheduler(data_parallel_world_size_, global_batch_size,
+                  micro_batch_size, sizes_.cbegin(),
+                  std::next(sizes_.cbegin(), total_size), graph_,
+                  scheduler_options);
+
+    auto indices = std::vector<size_type>(total_size);
+    std::iota(indices.begin(), indices.end(), 0);
+
+    auto schedule = std::vector<size_type>(total_size);
+    scheduler.Schedule(indices.begin(), indices.end(), schedule.begin());
+
+    const auto pp = pipeline_parallel_world_size_;
+    const auto per_replica_batch_size =
+        global_batch_size / data_parallel_world_size_;
+    const auto num_microbatches = per_replica_batch_size / micro_batch_size;
+    const auto window = std::min(pp, num_microbatches);
+    const auto overhead = options_.microbatch_overhead * mean_;
+
+    auto step_time = 0.0;
+    auto peak = static_cast<value_type>(0);
+
+    auto costs = std::vector<double>(num_microbatches);
+    auto mems = std::vector<value_type>(num_microbatches);
+
+    for (size_type offset = 0; offset < total_size;
+         offset += global_batch_size) {
+      auto max_step_time = 0.0;
+
+      for (size_type rank = 0; rank < data_parallel_world_size_; ++rank) {
+        const auto base = offset + per_replica_batch_size * rank;
+
+        for (size_type microbatch_id = 0; microbatch_id < num_microbatches;
+             ++microbatch_id) {
+          const auto first = std::next(
+              schedule.cbegin(), base + micro_batch_size * microbatch_id);
+          const auto last = std::next(first, micro_batch_size);
+          costs[microbatch_id] =
+              overhead + static_cast<double>(std::transform_reduce(
+                             first, last, static_cast<value_type>(0),
+                             std::plus<>(),
+                             [&](size_type index) { return preds_[index]; }));
+          mems[microbatch_id] = std::transform_reduce(
+              first, last, static_cast<value_type>(0), std::plus<>(),
+              [&](size_type index) { return mems_[index]; });
+        }
+
+        const auto sum = std::reduce(costs.cbegin(), costs.cend());
+        const auto max = *std::max_element(costs.cbegin(), costs.cend());
+        max_step_time = std::max(
+            max_step_time, (sum + static_cast<double>(pp - 1) * max) /
+                               static_cast<double>(pp));
+
+        auto inflight = std::reduce(mems.cbegin(),
+                                    std::next(mems.cbegin(), window));
+        peak = std::max(peak, inflight);
+        for (size_type microbatch_id = window;
+             microbatch_id < num_microbatches; ++microbatch_id) {
+          inflight += mems[microbatch_id] - mems[microbatch_id - window];
+          peak = std::max(peak, inflight);
+        }
+      }
+
+      step_time += max_step_time;
+    }
+
+    step_time /= static_cast<double>(total_size / global_batch_size) * mean_;
+
+    // Each pipeline stage holds the activations of about `1 / pp` of the
+    // layers.
+    const auto stages = static_cast<value_type>(pp);
+    const auto peak_bytes =
+        static_cast<std::int64_t>((peak + stages - 1) / stages) *
+        static_cast<std::int64_t>(options_.bytes_per_element);
+
+    return Configuration{
+        global_batch_size, micro_batch_size, step_time,
+        step_time / static_cast<double>(global_batch_size),
+        static_cast<std::int64_t>(memory_budget_) - peak_bytes};
+  }
+
+  // Autotuner::Tune()
+  //
+  // Evaluates every valid combination of the given candidates and returns the
+  // configurations ranked by their time per sample, with those that fit in
+  // the memory budget first; the first one is the recommendation. If no
+  // micro-batch size is given, powers of two dividing the per-replica batch
+  // size are tried.
+  std::vector<Configuration> Tune(
+      const std::vector<size_type> &global_batch_sizes,
+      const std::vector<size_type> &micro_batch_sizes = {}) const {
+    auto configs = std::vector<Configuration>();
+
+    for (const auto global_batch_size : global_batch_sizes) {
+      if (global_batch_size == 0 || sizes_.size() < global_batch_size ||
+          global_batch_size % data_parallel_world_size_ != 0) {
+        continue;
+      }
+
+      const auto per_replica_batch_size =
+          global_batch_size / data_parallel_world_size_;
+
+      auto candidates = micro_batch_sizes;
+      if (candidates.empty()) {
+        for (size_type micro_batch_size = 1;
+             micro_batch_size <= per_replica_batch_size;
+             micro_batch_size <<= 1) {
+          candidates.emplace_back(micro_batch_size);
+        }
+      }
+
+      for (const auto micro_batch_size : candidates) {
+        if (micro_batch_size != 0 &&
+            per_replica_batch_size % micro_batch_size == 0) {
+          configs.emplace_back(Evaluate(global_batch_size, micro_batch_size));
+        }
+      }
+    }
+
+    std::stable_sort(configs.begin(), configs.end(),
+                     [](const Configuration &lhs, const Configuration &rhs) {
+                       if ((0 <= lhs.memory_headroom) !=
+                           (0 <= rhs.memory_headroom)) {
+                         return 0 <= lhs.memory_headroom;
+                       }
+                       return lhs.time_per_sample < rhs.time_per_sample;
+                     });
+
+    if (!configs.empty()) {
+      const auto &config = configs.front();
+      LOG(INFO) << absl::StrFormat(
+          "Recommended global_batch_size: %u, micro_batch_size: %u "
+          "(predicted step time: %f, memory headroom: %d bytes)",
+          config.global_batch_size, config.micro_batch_size, config.step_time,
+          config.memory_headroom);
+    }
+
+    return configs;
+  }
+
+ protected:
+  size_type data_parallel_world_size_;
+  size_type pipeline_parallel_world_size_;
+  std::size_t memory_budget_;
+  AutotunerOptions options_;
+  const Graph *graph_;
+  double mean_;
+  std::vector<size_type> sizes_;
+  std::vector<value_type> mems_;
+  std::vector<value_type> preds_;
+};
+
+}  // namespace flatflow
+
+#endif  // FLATFLOW_SCHEDULER_AUTOTUNER_H_
@@ -0,0 +1,81 @@
+# Copyright 2025 The FlatFlow Authors
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+from collections.abc import Sequence
+from typing import Optional
+
+import flatbuffers
+import torch.fx
+
+from flatflow._C import Configuration  # type: ignore[attr-defined]
+from flatflow._C import autotune as _autotune  # type: ignore[attr-defined]
+from flatflow.ops import serialize
+
+__all__ = ["autotune"]
+
+
+def autotune(
+    graph: torch.fx.Graph,
+    sizes: Sequence[int],
+    data_parallel_world_size: int,
+    pipeline_parallel_world_size: int,
+    memory_budget: int,
+    global_batch_sizes: Sequence[int],
+    micro_batch_sizes: Optional[Sequence[int]] = None,
+    bytes_per_element: int = 2,
+    microbatch_overhead: float = 0.0,
+) -> list[Configuration]:
+    """Recommends the global batch size and micro-batch size without trial runs.
+
+    Each combination of the given candidates is evaluated by scheduling the
+    dataset as the control plane would and predicting its step time under
+    a one-forward-one-backward pipeline schedule along with the peak activation
+    memory of the first pipeline stage. Step times are given in units of the
+    cost of a data sample of mean size, so only their ratios are meaningful.
+
+    Args:
+        graph (torch.fx.Graph): Exported computational graph of the model.
+        sizes (Sequence[int]): Sizes of the data samples in the dataset.
+        data_parallel_world_size (int): Size of the data-parallel group.
+        pipeline_parallel_world_size (int): Number of pipeline stages.
+        memory_budget (int): Memory available for activations on each rank,
+            in bytes.
+        global_batch_sizes (Sequence[int]): Candidate global batch sizes.
+        micro_batch_sizes (Sequence[int], optional): Candidate micro-batch sizes.
+            If not given, powers of two dividing the per-replica batch size are
+            tried.
+        bytes_per_element (int, optional): Number of bytes per activation
+            element, e.g., two for bf16.
+        microbatch_overhead (float, optional): Fixed cost of each micro-batch
+            relative to the cost of a data sample of mean size.
+
+    Returns:
+        The evaluated configurations ranked by their time per sample, with those
+        that fit in the memory budget first. The first one is the recommendation.
+    """
+    builder = flatbuffers.Builder()
+    _graph = serialize(builder, graph)
+    builder.Finish(_graph)
+
+    return _autotune(
+        bytes(builder.Output()),
+        list(sizes),
+        data_parallel_world_size,
+        pipeline_parallel_world_size,
+        memory_budget,
+        list(global_batch_sizes),
+        [] if micro_batch_sizes is None else list(micro_batch_sizes),
+        bytes_per_element,
+        microbatch_overhead,
+    )
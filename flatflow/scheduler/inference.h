@@ -0,0 +1,248 @@
+// Copyright 2025 The FlatFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FLATFLOW_SCHEDULER_INFERENCE_H_
+#define FLATFLOW_SCHEDULER_INFERENCE_H_
+
+#include <omp.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <vector>
+
+#include "absl/log/check.h"
+#include "absl/log/log.h"
+#include "absl/strings/str_format.h"
+
+#include "flatflow/ops/graph_generated.h"
+#include "flatflow/ops/ops.h"
+#include "flatflow/scheduler/internal/partition.h"
+#include "flatflow/scheduler/scheduler.h"
+
+namespace flatflow {
+
+// flatflow::InferenceScheduler
+//
+// A `flatflow::InferenceScheduler` balances offline batch inference, such as
+// scoring and generation over a fixed set of prompts, across the data parallel
+// replicas. Each sample is costed as a forward pass over its prompt followed
+// by its expected output; incremental decoding with a key-value (KV) cache
+// performs the same FLOPs as a forward pass over the whole sequence, so this
+// is the cost model evaluated at the sum of the two lengths.
+//
+// Unlike training, there is no global batch; the samples are first packed into
+// batches whose KV caches fit in the given token budget, and the batches are
+// then partitioned across the replicas. Every replica takes the same number of
+// batches, some of which may be empty.
+class InferenceScheduler {
+ public:
+  using value_type = typename Scheduler::value_type;
+  using size_type = typename Scheduler::size_type;
+
+  // Constructors and assignment operators
+  //
+  // In addition to the constructor to set up scheduling,
+  // `flatflow::InferenceScheduler` supports a default constructor, as well as
+  // copy/move constructors and assignment operators. The prompt and expected
+  // output lengths are given in the ranges starting from `first` and
+  // `output_first`, respectively. If `max_batch_size` is nonzero, it also
+  // bounds the number of samples in each batch.
+  InferenceScheduler() {}
+
+  template <typename InputIterator>
+  InferenceScheduler(size_type data_parallel_world_size, InputIterator first,
+                     InputIterator last, InputIterator output_first,
+                     const Graph *graph, size_type kv_cache_budget,
+                     size_type max_batch_size = 0)
+      : data_parallel_world_size_(data_parallel_world_size),
+        kv_cache_budget_(kv_cache_budget),
+        max_batch_size_(max_batch_size) {
+    constexpr auto kZero = static_cast<size_type>(0);
+    CHECK_NE(data_parallel_world_size, kZero);
+    CHECK_NE(kv_cache_budget, kZero);
+    CHECK_NE(graph, nullptr);
+
+    const auto total_size = static_cast<size_type>(std::distance(first, last));
+    CHECK_NE(total_size, kZero);
+
+    LOG(INFO) << absl::StrFormat(
+        "Initializing inference scheduler with the following arguments:\n"
+        "  data_parallel_world_size: %u\n"
+        "  kv_cache_budget:          %u\n"
+        "  max_batch_size:           %u",
+        data_parallel_world_size, kv_cache_budget, max_batch_size);
+
+    preds_.resize(total_size);
+    tokens_.resize(total_size);
+
+    const auto trace = symbolic_trace(graph);
+
+    // clang-format off
+    #pragma omp parallel for
+    for (size_type index = 0; index < total_size; ++index) {
+      tokens_[index] = static_cast<size_type>(*std::next(first, index)) +
+                       static_cast<size_type>(*std::next(output_first, index));
+      preds_[index] = trace(tokens_[index]);
+    }
+    // clang-format on
+  }
+
+  InferenceScheduler(const InferenceScheduler &other) = default;
+
+  InferenceScheduler &operator=(const InferenceScheduler &other) = default;
+
+  InferenceScheduler(InferenceScheduler &&other) = default;
+
+  InferenceScheduler &operator=(InferenceScheduler &&other) = default;
+
+  // InferenceScheduler::Schedule()
+  //
+  // Reorders the given samples in the range [`first`, `last`) into batches
+  // and stores the resulting indices in an output range starting from
+  // `result`. The batches are laid out round by round and then rank by rank,
+  // where each replica takes one batch per round; the returned sizes are
+  // indexed likewise, so that they can be scattered as the sizes of per-rank
+  // batches from the training scheduler.
+  template <typename InputIterator, typename OutputIterator>
+  std::vector<size_type> Schedule(InputIterator first, InputIterator last,
+                                  OutputIterator result) const {
+    using batch_type = internal::Subset<value_type, size_type>;
+
+    const auto now = omp_get_wtime();
+
+    // Samples of similar lengths are packed together, so that the sequences
+    // in each batch finish generation at about the same time.
+    auto samples = std::vector<size_type>(first, last);
+    std::stable_sort(samples.begin(), samples.end(),
+                     [&](size_type lhs, size_type rhs) {
+                       return tokens_[lhs] < tokens_[rhs];
+                     });
+
+    auto batches = std::vector<batch_type>();
+    auto num_tokens = static_cast<size_type>(0);
+    auto num_overflows = static_cast<size_type>(0);
+
+    for (const auto sample : samples) {
+      const auto is_full =
+          !batches.empty() &&
+          (kv_cache_budget_ < num_tokens + tokens_[sample] ||
+           (max_batch_size_ != 0 &&
+            batches.back().items().size() == max_batch_size_));
+      if (batches.empty() || is_full) {
+        batches.emplace_back(static_cast<value_type>(0),
+                             std::vector<size_type>());
+        num_tokens = 0;
+      }
+
+      // A sample that alone exceeds the budget is still given a batch of its
+      // own, as it cannot be split.
+      if (kv_cache_budget_ < tokens_[sample]) {
+        ++num_overflows;
+      }
+
+      batches.back().sum() += preds_[sample];
+      batches.back().items().emplace_back(sample);
+      num_tokens += tokens_[sample];
+    }
+
+    // Every replica should take the same number of batches, so the batches
+    // are padded with empty ones before partitioning.
+    const auto dp = data_parallel_world_size_;
+    const auto num_rounds = (batches.size() + dp - 1) / dp;
+    batches.resize(num_rounds * dp,
+                   batch_type(static_cast<value_type>(0),
+                              std::vector<size_type>()));
+    std::sort(batches.begin(), batches.end());
+
+    auto replicas =
+        std::vector<internal::Subset<value_type, batch_type>>(dp);
+    internal::Partition(
+        batches.begin(), batches.end(), replicas.begin(),
+        [](const batch_type &batch) { return batch.sum(); }, std::identity(),
+        dp);
+
+    // The heaviest batches go first, so that no replica trails behind with
+    // a heavy batch at the end.
+    for (auto &replica : replicas) {
+      std::sort(replica.begin(), replica.end(),
+                [](const batch_type &lhs, const batch_type &rhs) {
+                  return rhs < lhs;
+                });
+    }
+
+    auto sizes = std::vector<size_type>(num_rounds * dp);
+    auto base = static_cast<size_type>(0);
+
+    for (size_type round = 0; round < num_rounds; ++round) {
+      for (size_type rank = 0; rank < dp; ++rank) {
+        const auto &batch = replicas[rank][round];
+        std::copy(batch.begin(), batch.end(), std::next(result, base));
+        base += batch.items().size();
+        sizes[dp * round + rank] = batch.items().size();
+      }
+    }
+
+    // clang-format off
+    LOG(INFO) << absl::StrFormat("Packing %u samples into %u rounds of batches took %fs", samples.size(), num_rounds, omp_get_wtime() - now);
+    // clang-format on
+
+    if (num_overflows != 0) {
+      LOG(WARNING) << absl::StrFormat(
+          "%u samples exceed the KV-cache budget of %u tokens on their own",
+          num_overflows, kv_cache_budget_);
+    }
+
+    return sizes;
+  }
+
+  // InferenceScheduler::Cost()
+  //
+  // Returns the predicted cost of the batch consisting of the samples at the
+  // indices in the range [`first`, `last`).
+  template <typename InputIterator>
+  value_type Cost(InputIterator first, InputIterator last) const {
+    auto cost = static_cast<value_type>(0);
+    for (auto it = first; it != last; ++it) {
+      cost += preds_[*it];
+    }
+    return cost;
+  }
+
+  // InferenceScheduler::NumTokens()
+  //
+  // Returns the number of tokens the KV cache holds for the batch consisting
+  // of the samples at the indices in the range [`first`, `last`) once every
+  // output is generated.
+  template <typename InputIterator>
+  size_type NumTokens(InputIterator first, InputIterator last) const {
+    auto num_tokens = static_cast<size_type>(0);
+    for (auto it = first; it != last; ++it) {
+      num_tokens += tokens_[*it];
+    }
+    return num_tokens;
+  }
+
+ protected:
+  size_type data_parallel_world_size_;
+  size_type kv_cache_budget_;
+  size_type max_batch_size_;
+  std::vector<size_type> tokens_;
+  std::vector<value_type> preds_;
+};
+
+}  // namespace flatflow
+
+#endif  // FLATFLOW_SCHEDULER_INFERENCE_H_
@@ -0,0 +1,151 @@
+// Copyright 2025 The FlatFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FLATFLOW_SCHEDULER_INTERNAL_DICTIONARY_H_
+#define FLATFLOW_SCHEDULER_INTERNAL_DICTIONARY_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/log/check.h"
+
+namespace flatflow {
+namespace internal {
+
+// Dictionary<>
+//
+// Represents a sequence of keys in dictionary encoding. Each key is stored as
+// its ID among the distinct keys, in 16 bits if there are at most 65536
+// distinct keys and in 32 bits otherwise. IDs are assigned in ascending order
+// of keys, so that any value derived from the keys alone can be stored once
+// per distinct key, in a table indexed by their IDs.
+template <typename T>
+class Dictionary {
+ public:
+  using key_type = std::remove_cvref_t<T>;
+  using size_type = std::size_t;
+
+  Dictionary() {}
+
+  template <typename InputIterator>
+  Dictionary(InputIterator first, InputIterator last) {
+    auto ids = absl::flat_hash_map<key_type, std::uint32_t>();
+    for (auto it = first; it != last; ++it) {
+      ids.try_emplace(static_cast<key_type>(*it), 0);
+    }
+
+    CHECK_LE(ids.size(),
+             static_cast<size_type>(std::numeric_limits<std::uint32_t>::max()));
+
+    keys_.reserve(ids.size());
+    for (const auto &[key, id] : ids) {
+      keys_.emplace_back(key);
+    }
+    std::sort(keys_.begin(), keys_.end());
+
+    for (size_type id = 0; id < keys_.size(); ++id) {
+      ids[keys_[id]] = static_cast<std::uint32_t>(id);
+    }
+
+    const auto total_size = static_cast<size_type>(std::distance(first, last));
+
+    if (keys_.size() <= kMaxNarrowKeys) {
+      narrow_ids_.resize(total_size);
+      // clang-format off
+      #pragma omp parallel for
+      for (size_type index = 0; index < total_size; ++index) {
+        narrow_ids_[index] = static_cast<std::uint16_t>(
+            ids.find(static_cast<key_type>(*std::next(first, index)))->second);
+      }
+      // clang-format on
+    } else {
+      wide_ids_.resize(total_size);
+      // clang-format off
+      #pragma omp parallel for
+      for (size_type index = 0; index < total_size; ++index) {
+        wide_ids_[index] =
+            ids.find(static_cast<key_type>(*std::next(first, index)))->second;
+      }
+      // clang-format on
+    }
+  }
+
+  Dictionary(const Dictionary &other) = default;
+
+  Dictionary &operator=(const Dictionary &other) = default;
+
+  Dictionary(Dictionary &&other) = default;
+
+  Dictionary &operator=(Dictionary &&other) = default;
+
+  // Dictionary::operator[]()
+  //
+  // Returns the key at the given index.
+  key_type operator[](size_type index) const { return keys_[id(index)]; }
+
+  // Dictionary::id()
+  //
+  // Returns the ID of the key at the given index.
+  size_type id(size_type index) const {
+    return wide_ids_.empty() ? narrow_ids_[index] : wide_ids_[index];
+  }
+
+  // Dictionary::keys()
+  //
+  // Returns the distinct keys in order of their IDs.
+  const std::vector<key_type> &keys() const { return keys_; }
+
+  // Dictionary::size()
+  //
+  // Returns the number of keys in the sequence.
+  size_type size() const { return narrow_ids_.size() + wide_ids_.size(); }
+
+  // Dictionary::empty()
+  //
+  // Returns whether the sequence is empty.
+  bool empty() const { return size() == 0; }
+
+  // Dictionary::id_width()
+  //
+  // Returns the number of bits each ID takes.
+  size_type id_width() const { return wide_ids_.empty() ? 16 : 32; }
+
+  // Dictionary::num_bytes()
+  //
+  // Returns the number of bytes taken by the IDs and the distinct keys.
+  size_type num_bytes() const {
+    return narrow_ids_.size() * sizeof(std::uint16_t) +
+           wide_ids_.size() * sizeof(std::uint32_t) +
+           keys_.size() * sizeof(key_type);
+  }
+
+ private:
+  static constexpr auto kMaxNarrowKeys = static_cast<size_type>(
+      std::numeric_limits<std::uint16_t>::max()) + 1;
+
+  std::vector<key_type> keys_;
+  std::vector<std::uint16_t> narrow_ids_;
+  std::vector<std::uint32_t> wide_ids_;
+};
+
+}  // namespace internal
+}  // namespace flatflow
+
+#endif  // FLATFLOW_SCHEDULER_INTERNAL_DICTIONARY_H_
@@ -16,8 +16,14 @@
 #define FLATFLOW_SCHEDULER_INTERNAL_PARTITION_H_
 
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <functional>
 #include <iterator>
+#include <numeric>
 #include <queue>
+#include <string_view>
 #include <type_traits>
 #include <utility>
 #include <vector>
@@ -238,18 +244,377 @@ OutputIterator BLDM(InputIterator first, InputIterator last,
                    solutions.top().subsets().end(), result);
 }
 
+// PartitionOptions
+//
+// Optional knobs for `Partition()`. The gap of a partition is the relative
+// excess of its largest subset sum over a lower bound on that of any balanced
+// partition. If `exact` is set, small instances are solved exactly where
+// possible. If `time_limit` is positive, a partition obtained by BLDM whose
+// gap exceeds `max_gap` is refined by local search for up to `time_limit`
+// seconds; otherwise BLDM is used as is.
+struct PartitionOptions {
+  double max_gap = 0.0;
+  double time_limit = 0.0;
+  bool exact = false;
+};
+
+// The limits on the instances that `Partition()` solves exactly, and on
+// the number of nodes to visit in doing so. Beyond the node limit, the best
+// partition found so far is used.
+inline constexpr auto kMaxExactSubsets = 8;
+inline constexpr auto kMaxExactItems = 64;
+inline constexpr auto kMaxExactNodes = static_cast<std::size_t>(1 << 16);
+
+// PartitionStats
+//
+// Reports which solver produced a partition and its gap.
+struct PartitionStats {
+  std::string_view solver = "BLDM";
+  double gap = 0.0;
+};
+
+// LowerBound()
+//
+// Returns a lower bound on the largest subset sum of any partition of the given
+// predicates, in any order, into `m` subsets of the same cardinality `k`.
+// Besides the average subset sum, the subset holding the largest item holds at
+// least the `k - 1` smallest items along with it.
+template <typename T>
+T LowerBound(const std::vector<T> &preds, std::size_t m) {
+  const auto k = preds.size() / m;
+  const auto sum = std::reduce(preds.cbegin(), preds.cend(), T());
+
+  auto average = sum / static_cast<T>(m);
+  if constexpr (std::is_integral_v<T>) {
+    if (average * static_cast<T>(m) < sum) {
+      ++average;
+    }
+  }
+
+  // The `k - 1` smallest items are selected rather than taken from the front,
+  // so that the bound holds for unsorted predicates as well.
+  auto smallest = preds;
+  std::nth_element(smallest.begin(), std::next(smallest.begin(), k - 1),
+                   smallest.end());
+  const auto largest =
+      std::reduce(smallest.cbegin(), std::next(smallest.cbegin(), k - 1),
+                  *std::max_element(preds.cbegin(), preds.cend()));
+
+  return std::max(average, largest);
+}
+
+// Gap()
+//
+// Returns the relative excess of `sum` over `lower_bound`.
+template <typename T>
+double Gap(T sum, T lower_bound) {
+  if (lower_bound <= T()) {
+    return 0.0;
+  }
+  return static_cast<double>(sum - lower_bound) /
+         static_cast<double>(lower_bound);
+}
+
+// Exact()
+//
+// Partitions the given predicates, sorted in ascending order, into subsets of
+// the same cardinality by depth-first branch and bound, improving on the given
+// partition if possible. Items are assigned in descending order of their
+// predicates, each to the subsets in ascending order of their sums, which
+// quickly finds good partitions to prune others. Placing an item is pruned if
+// the subset would reach the largest sum of the best partition so far even
+// with the smallest items left, and subsets with the same sum and cardinality
+// are tried only once since they are interchangeable.
+//
+// The search stops early once the best partition meets `lower_bound`, or after
+// visiting `max_nodes` nodes. Returns whether the resulting partition is known
+// to be optimal.
+template <typename T>
+bool Exact(std::vector<Subset<T, std::size_t>> &subsets,
+           const std::vector<T> &preds, T lower_bound, std::size_t max_nodes) {
+  const auto n = preds.size();
+  const auto m = subsets.size();
+  const auto k = n / m;
+
+  auto best = std::max_element(subsets.cbegin(), subsets.cend())->sum();
+  if (!(lower_bound < best)) {
+    return true;
+  }
+
+  // `tails[r]` is the sum of the `r` smallest items, which are assigned last.
+  auto tails = std::vector<T>(k, T());
+  for (std::size_t r = 1; r < k; ++r) {
+    tails[r] = tails[r - 1] + preds[r - 1];
+  }
+
+  auto sums = std::vector<T>(m, T());
+  auto counts = std::vector<std::size_t>(m, 0);
+  auto assignment = std::vector<std::size_t>(n);
+  auto orders = std::vector<std::size_t>(n * m);
+  auto best_assignment = std::vector<std::size_t>();
+  auto num_nodes = static_cast<std::size_t>(0);
+  auto is_truncated = false;
+
+  const auto search = [&](const auto &self, std::size_t depth) -> bool {
+    if (depth == n) {
+      best = *std::max_element(sums.cbegin(), sums.cend());
+      best_assignment = assignment;
+      return !(lower_bound < best);
+    }
+
+    if (max_nodes <= ++num_nodes) {
+      is_truncated = true;
+      return true;
+    }
+
+    const auto position = n - 1 - depth;
+    const auto pred = preds[position];
+
+    const auto order = std::next(orders.begin(), depth * m);
+    const auto order_last = std::next(order, m);
+    std::iota(order, order_last, 0);
+    std::sort(order, order_last,
+              [&](auto lhs, auto rhs) { return sums[lhs] < sums[rhs]; });
+
+    for (auto it = order; it != order_last; ++it) {
+      const auto index = *it;
+      if (counts[index] == k ||
+          !(sums[index] + pred + tails[k - counts[index] - 1] < best)) {
+        continue;
+      }
+      if (std::any_of(order, it, [&](auto other) {
+            return sums[other] == sums[index] && counts[other] == counts[index];
+          })) {
+        continue;
+      }
+
+      sums[index] += pred;
+      ++counts[index];
+      assignment[position] = index;
+
+      if (self(self, depth + 1)) {
+        return true;
+      }
+
+      sums[index] -= pred;
+      --counts[index];
+    }
+
+    return false;
+  };
+
+  search(search, 0);
+
+  if (!best_assignment.empty()) {
+    for (auto &subset : subsets) {
+      subset = Subset<T, std::size_t>(T(), std::vector<std::size_t>());
+    }
+    for (std::size_t position = 0; position < n; ++position) {
+      auto &subset = subsets[best_assignment[position]];
+      subset.sum() += preds[position];
+      subset.items().emplace_back(position);
+    }
+    std::sort(subsets.begin(), subsets.end());
+  }
+
+  return !is_truncated;
+}
+
+// Refine()
+//
+// Improves the given partition by local search, which repeatedly swaps an item
+// of the subset with the largest sum with an item of another subset. Among
+// the swaps that reduce the largest sum without making the other subset the
+// new largest, the one that brings the two sums closest is taken, trying the
+// other subsets in ascending order of their sums. This keeps cardinalities
+// intact, and stops once the gap is at most `max_gap`, no swap improves the
+// partition, or `deadline` is reached.
+template <typename T>
+void Refine(std::vector<Subset<T, std::size_t>> &subsets,
+            const std::vector<T> &preds, T lower_bound, double max_gap,
+            std::chrono::steady_clock::time_point deadline) {
+  auto order = std::vector<std::size_t>(subsets.size());
+  auto candidates = std::vector<std::pair<T, std::size_t>>();
+
+  while (std::chrono::steady_clock::now() < deadline) {
+    auto &largest = *std::max_element(subsets.begin(), subsets.end());
+    if (Gap(largest.sum(), lower_bound) <= max_gap) {
+      return;
+    }
+
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](auto lhs, auto rhs) {
+      return subsets[lhs] < subsets[rhs];
+    });
+
+    auto improved = false;
+
+    for (const auto index : order) {
+      auto &other = subsets[index];
+      if (!(other.sum() < largest.sum())) {
+        break;
+      }
+
+      // Swapping an item of `a` with an item of `c` where `c < a` changes
+      // the sums by `a - c`, which should be less than their difference.
+      const auto difference = largest.sum() - other.sum();
+      const auto target = static_cast<double>(difference) / 2.0;
+
+      candidates.clear();
+      for (std::size_t position = 0; position < other.items().size();
+           ++position) {
+        candidates.emplace_back(preds[other[position]], position);
+      }
+      std::sort(candidates.begin(), candidates.end());
+
+      auto best = std::pair<std::size_t, std::size_t>(0, 0);
+      auto best_score = -1.0;
+
+      for (std::size_t position = 0; position < largest.items().size();
+           ++position) {
+        const auto a = preds[largest[position]];
+        const auto it = std::lower_bound(
+            candidates.cbegin(), candidates.cend(),
+            static_cast<double>(a) - target, [](const auto &lhs, double rhs) {
+              return static_cast<double>(lhs.first) < rhs;
+            });
+
+        // The score is unimodal in `c`, so only the neighbors of the target
+        // need to be examined.
+        for (auto candidate = it == candidates.cbegin() ? it : std::prev(it);
+             candidate != candidates.cend() && candidate <= it; ++candidate) {
+          const auto c = candidate->first;
+          if (!(c < a) || !(a - c < difference)) {
+            continue;
+          }
+          const auto score = std::abs(static_cast<double>(a - c) - target);
+          if (best_score < 0.0 || score < best_score) {
+            best = std::make_pair(position, candidate->second);
+            best_score = score;
+          }
+        }
+      }
+
+      if (0.0 <= best_score) {
+        const auto delta =
+            preds[largest[best.first]] - preds[other[best.second]];
+        std::swap(largest[best.first], other[best.second]);
+        largest.sum() -= delta;
+        other.sum() += delta;
+        improved = true;
+        break;
+      }
+    }
+
+    if (!improved) {
+      return;
+    }
+  }
+}
+
 // Partition()
 //
 // Reorders the given items in the range [`first`, `last`) into `m` subsets
 // where each subset contains items with projection `proj` applied, which are
 // evaluated via predicate `pred`. The resulting subsets are stored in an output
 // range starting from `result`.
+//
+// Partitions are obtained by BLDM. If `options.exact` is set, small instances
+// of up to `kMaxExactSubsets` subsets and `kMaxExactItems` items are then
+// solved by `Exact()` unless BLDM already meets the lower bound. Partitions
+// not known to be optimal may then be refined by `Refine()` as per `options`.
+//
+// If `stats` is given, the solver and gap of the resulting partition are
+// stored in it. The gap is measured against `LowerBound()`.
 template <typename InputIterator, typename OutputIterator, typename Proj,
           typename Pred>
 OutputIterator Partition(InputIterator first, InputIterator last,
                          OutputIterator result, Pred pred, Proj proj,
-                         std::iter_difference_t<InputIterator> m) {
-  return BLDM(first, last, result, pred, proj, m);
+                         std::iter_difference_t<InputIterator> m,
+                         const PartitionOptions &options = PartitionOptions(),
+                         PartitionStats *stats = nullptr) {
+  using first_type = std::remove_cvref_t<
+      std::invoke_result_t<Pred, std::iter_value_t<InputIterator>>>;
+  using second_type = std::remove_cvref_t<
+      std::invoke_result_t<Proj, std::iter_value_t<InputIterator>>>;
+
+  const auto n = std::distance(first, last);
+
+  // Small instances, as in partitioning a few dozen micro-batches into a few
+  // data parallel replicas, are solved exactly where possible if requested.
+  const auto is_small = options.exact && 1 < m && m <= kMaxExactSubsets &&
+                        n <= kMaxExactItems;
+
+  if ((options.time_limit <= 0.0 && stats == nullptr && !is_small) || n == 0) {
+    return BLDM(first, last, result, pred, proj, m);
+  }
+
+  CHECK_NE(m, 0);
+  CHECK_EQ(n % m, 0);
+
+  const auto deadline =
+      std::chrono::steady_clock::now() +
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::duration<double>(options.time_limit));
+
+  // Both the bound and local search evaluate the predicates repeatedly, so
+  // the items are partitioned by their positions and projected at the end.
+  auto preds = std::vector<first_type>();
+  preds.reserve(n);
+  for (auto it = first; it != last; ++it) {
+    preds.emplace_back(pred(*it));
+  }
+
+  const auto lower_bound = LowerBound(preds, static_cast<std::size_t>(m));
+
+  auto positions = std::vector<std::size_t>(n);
+  std::iota(positions.begin(), positions.end(), 0);
+
+  auto subsets = std::vector<Subset<first_type, std::size_t>>(m);
+  BLDM(positions.cbegin(), positions.cend(), subsets.begin(),
+       [&](std::size_t position) { return preds[position]; }, std::identity(),
+       m);
+
+  auto solver = std::string_view("BLDM");
+  auto gap = Gap(std::max_element(subsets.cbegin(), subsets.cend())->sum(),
+                 lower_bound);
+  auto is_optimal = gap <= 0.0;
+
+  if (is_small && !is_optimal) {
+    const auto sum = std::max_element(subsets.cbegin(), subsets.cend())->sum();
+    is_optimal = Exact(subsets, preds, lower_bound, kMaxExactNodes);
+    if (is_optimal) {
+      solver = "exact";
+    } else if (subsets.back().sum() < sum) {
+      solver = "branch and bound";
+    }
+    gap = Gap(std::max_element(subsets.cbegin(), subsets.cend())->sum(),
+              lower_bound);
+  }
+
+  if (0.0 < options.time_limit && options.max_gap < gap && !is_optimal) {
+    Refine(subsets, preds, lower_bound, options.max_gap, deadline);
+    std::sort(subsets.begin(), subsets.end());
+    solver = "local search";
+    gap = Gap(subsets.back().sum(), lower_bound);
+  }
+
+  if (stats != nullptr) {
+    stats->solver = solver;
+    stats->gap = gap;
+  }
+
+  for (auto &subset : subsets) {
+    auto items = std::vector<second_type>();
+    items.reserve(subset.items().size());
+    for (const auto position : subset) {
+      items.emplace_back(proj(*std::next(first, position)));
+    }
+    *result = Subset<first_type, second_type>(subset.sum(), std::move(items));
+    ++result;
+  }
+
+  return result;
 }
 
 }  // namespace internal
@@ -17,6 +17,7 @@
 
 #include <algorithm>
 #include <iterator>
+#include <numeric>
 
 #include "absl/log/check.h"
 
@@ -58,6 +59,36 @@ OutputIterator Scatter(InputIterator first, InputIterator last,
   return std::next(result, total_size / n);
 }
 
+// Scatterv()
+//
+// Sends data in the range [`first`, `last`) to the calling process with rank
+// `rank` in a group of size `n`, storing the result in an output range
+// starting from `result`. Unlike `Scatter`, each process may receive
+// a different number of elements; the range is a sequence of strides, each of
+// which is laid out rank by rank, and `counts` holds the number of elements
+// for every rank in every stride.
+template <typename InputIterator, typename OutputIterator,
+          typename CountIterator>
+OutputIterator Scatterv(InputIterator first, InputIterator last,
+                        OutputIterator result, CountIterator counts,
+                        std::iter_difference_t<InputIterator> n,
+                        std::iter_difference_t<InputIterator> rank) {
+  CHECK_NE(n, 0);
+
+  while (first != last) {
+    const auto base = std::next(
+        first, std::reduce(counts, std::next(counts, rank),
+                           static_cast<std::iter_value_t<CountIterator>>(0)));
+    result = std::move(base, std::next(base, *std::next(counts, rank)), result);
+    first = std::next(
+        first, std::reduce(counts, std::next(counts, n),
+                           static_cast<std::iter_value_t<CountIterator>>(0)));
+    counts = std::next(counts, n);
+  }
+
+  return result;
+}
+
 }  // namespace internal
 }  // namespace flatflow
 
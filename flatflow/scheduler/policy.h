@@ -0,0 +1,250 @@
+// Copyright 2025 The FlatFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FLATFLOW_SCHEDULER_POLICY_H_
+#define FLATFLOW_SCHEDULER_POLICY_H_
+
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "flatflow/ops/graph_generated.h"
+#include "flatflow/scheduler/scheduler.h"
+
+namespace flatflow {
+
+// flatflow::SchedulingPolicy
+//
+// A `flatflow::SchedulingPolicy` is a scheduler implementation that can be
+// driven by the control plane. It is constructed from the same arguments as
+// `flatflow::Scheduler`, reorders the computation schedule of each epoch via
+// `Schedule`, reports the context parallel splitting, cost, number of tokens
+// and shape bucket of the resulting micro-batches, and exposes the
+// `on_epoch_begin`, `on_epoch_end`, `on_train_begin` and `on_train_end`
+// callbacks.
+template <typename T>
+concept SchedulingPolicy =
+    std::semiregular<T> &&
+    std::constructible_from<T, typename Scheduler::size_type,
+                            typename Scheduler::size_type,
+                            typename Scheduler::size_type,
+                            const std::uint32_t *, const std::uint32_t *,
+                            const Graph *, const SchedulerOptions &> &&
+    requires(const T &policy, const typename Scheduler::size_type *first,
+             typename Scheduler::size_type *result,
+             typename Scheduler::size_type index) {
+      {
+        policy.Schedule(first, first, result, result)
+      } -> std::same_as<typename Scheduler::size_type *>;
+      { policy.IsSplit(index) } -> std::convertible_to<bool>;
+      {
+        policy.Cost(first, first)
+      } -> std::convertible_to<typename Scheduler::value_type>;
+      {
+        policy.NumTokens(first, first)
+      } -> std::convertible_to<typename Scheduler::size_type>;
+      {
+        policy.Bucket(first, first)
+      } -> std::convertible_to<typename Scheduler::size_type>;
+      policy.on_epoch_begin(index);
+      policy.on_epoch_end(index);
+      policy.on_train_begin();
+      policy.on_train_end();
+    };
+
+// flatflow::SequentialScheduler
+//
+// A `flatflow::SequentialScheduler` keeps the computation schedule of the data
+// plane as is; each rank takes a contiguous slice of every global batch, which
+// is split into micro-batches in order. It serves as a baseline to measure the
+// effect of reordering, while the resulting micro-batches are still costed and
+// bucketed in the same way as with `flatflow::Scheduler`.
+class SequentialScheduler : public Scheduler {
+ public:
+  using Scheduler::Scheduler;
+
+  // SequentialScheduler::Schedule()
+  //
+  // Copies the given computation schedule in the range [`first`, `last`) to
+  // an output range starting from `result`, and stores the number of samples
+  // each rank takes from each global batch in an output range starting from
+  // `sizes` as with `Scheduler::Schedule()`. If a global batch does not divide
+  // evenly, its remainder goes to the first ranks one sample each, so that no
+  // sample is left out.
+  template <typename InputIterator, typename OutputIterator>
+  OutputIterator Schedule(InputIterator first, InputIterator last,
+                          OutputIterator result) const {
+    const auto total_size = static_cast<size_type>(std::distance(first, last));
+    auto sizes = std::vector<size_type>(
+        (total_size + global_batch_size_ - 1) / global_batch_size_ *
+        data_parallel_world_size_);
+    return Schedule(first, last, result, sizes.begin());
+  }
+
+  template <typename InputIterator, typename OutputIterator,
+            typename SizeOutputIterator>
+  OutputIterator Schedule(InputIterator first, InputIterator last,
+                          OutputIterator result,
+                          SizeOutputIterator sizes) const {
+    const auto total_size = static_cast<size_type>(std::distance(first, last));
+
+    for (size_type offset = 0; offset < total_size;
+         offset += global_batch_size_) {
+      const auto num_samples =
+          std::min(global_batch_size_, total_size - offset);
+      const auto quotient = num_samples / data_parallel_world_size_;
+      const auto remainder = num_samples % data_parallel_world_size_;
+      sizes = std::fill_n(sizes, remainder, quotient + 1);
+      sizes = std::fill_n(sizes, data_parallel_world_size_ - remainder,
+                          quotient);
+    }
+
+    return std::copy(first, last, result);
+  }
+};
+
+// flatflow::AnyScheduler
+//
+// A `flatflow::AnyScheduler` holds one of the scheduling policies and forwards
+// calls to it, so that the policy can be selected at runtime. It defaults to
+// `flatflow::Scheduler`, which balances the micro-batches using the balanced
+// largest differencing method.
+//
+// To add a new policy, implement it as a `flatflow::SchedulingPolicy`, append
+// it to the alternatives below, and declare a matching enumerator of `Policy`
+// in `flatflow/rpc/controlplane.fbs`.
+class AnyScheduler {
+ public:
+  using value_type = typename Scheduler::value_type;
+  using size_type = typename Scheduler::size_type;
+
+  // Constructors and assignment operators
+  //
+  // A `flatflow::AnyScheduler` is implicitly constructible from any scheduling
+  // policy, and supports a default constructor as well as copy/move
+  // constructors and assignment operators.
+  AnyScheduler() {}
+
+  template <typename T>
+    requires(!std::same_as<std::remove_cvref_t<T>, AnyScheduler> &&
+             SchedulingPolicy<std::remove_cvref_t<T>>)
+  AnyScheduler(T &&policy) : policy_(std::forward<T>(policy)) {}
+
+  AnyScheduler(const AnyScheduler &other) = default;
+
+  AnyScheduler &operator=(const AnyScheduler &other) = default;
+
+  AnyScheduler(AnyScheduler &&other) = default;
+
+  AnyScheduler &operator=(AnyScheduler &&other) = default;
+
+  // AnyScheduler::Schedule()
+  //
+  // Reorders the given computation schedule using the selected policy.
+  template <typename InputIterator, typename OutputIterator,
+            typename SizeOutputIterator>
+  OutputIterator Schedule(InputIterator first, InputIterator last,
+                          OutputIterator result,
+                          SizeOutputIterator sizes) const {
+    return std::visit(
+        [&](const auto &policy) {
+          return policy.Schedule(first, last, result, sizes);
+        },
+        policy_);
+  }
+
+  // AnyScheduler::IsSplit()
+  //
+  // Returns whether the sample at the given index is split across the context
+  // parallel group.
+  bool IsSplit(size_type index) const {
+    return std::visit(
+        [&](const auto &policy) { return policy.IsSplit(index); }, policy_);
+  }
+
+  // AnyScheduler::Cost()
+  //
+  // Returns the predicted cost of the micro-batch consisting of the samples at
+  // the indices in the range [`first`, `last`).
+  template <typename InputIterator>
+  value_type Cost(InputIterator first, InputIterator last) const {
+    return std::visit(
+        [&](const auto &policy) { return policy.Cost(first, last); }, policy_);
+  }
+
+  // AnyScheduler::NumTokens()
+  //
+  // Returns the number of tokens in the micro-batch consisting of the samples
+  // at the indices in the range [`first`, `last`), including any padding.
+  template <typename InputIterator>
+  size_type NumTokens(InputIterator first, InputIterator last) const {
+    return std::visit(
+        [&](const auto &policy) { return policy.NumTokens(first, last); },
+        policy_);
+  }
+
+  // AnyScheduler::Bucket()
+  //
+  // Returns the shape bucket of the micro-batch consisting of the samples at
+  // the indices in the range [`first`, `last`).
+  template <typename InputIterator>
+  size_type Bucket(InputIterator first, InputIterator last) const {
+    return std::visit(
+        [&](const auto &policy) { return policy.Bucket(first, last); },
+        policy_);
+  }
+
+  // AnyScheduler::on_epoch_begin()
+  //
+  // A callback to be called at the beginning of an epoch.
+  void on_epoch_begin(size_type epoch) const noexcept {
+    std::visit([&](const auto &policy) { policy.on_epoch_begin(epoch); },
+               policy_);
+  }
+
+  // AnyScheduler::on_epoch_end()
+  //
+  // A callback to be called at the end of an epoch.
+  void on_epoch_end(size_type epoch) const noexcept {
+    std::visit([&](const auto &policy) { policy.on_epoch_end(epoch); },
+               policy_);
+  }
+
+  // AnyScheduler::on_train_begin()
+  //
+  // A callback to be called at the beginning of training.
+  void on_train_begin() const noexcept {
+    std::visit([](const auto &policy) { policy.on_train_begin(); }, policy_);
+  }
+
+  // AnyScheduler::on_train_end()
+  //
+  // A callback to be called at the end of training.
+  void on_train_end() const noexcept {
+    std::visit([](const auto &policy) { policy.on_train_end(); }, policy_);
+  }
+
+ protected:
+  std::variant<Scheduler, SequentialScheduler> policy_;
+};
+
+}  // namespace flatflow
+
+#endif  // FLATFLOW_SCHEDULER_POLICY_H_
@@ -0,0 +1,192 @@
+// Copyright 2025 The FlatFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FLATFLOW_SCHEDULER_RECOMPUTE_H_
+#define FLATFLOW_SCHEDULER_RECOMPUTE_H_
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <iterator>
+#include <vector>
+
+#include "absl/log/check.h"
+#include "absl/log/log.h"
+#include "absl/strings/str_format.h"
+
+#include "flatflow/ops/graph_generated.h"
+#include "flatflow/ops/ops.h"
+#include "flatflow/scheduler/scheduler.h"
+
+namespace flatflow {
+
+// flatflow::RecomputeOptions
+//
+// A `flatflow::RecomputeOptions` holds optional knobs for the memory model of
+// the recompute planner.
+struct RecomputeOptions {
+  // The number of pipeline stages. Each stage holds the activations of about
+  // `1 / pp` of the layers for up to `pp` micro-batches in flight, as the
+  // first stage of one-forward-one-backward (1F1B) pipeline schedules does.
+  std::size_t pipeline_parallel_world_size = 1;
+
+  // The number of bytes per activation element, e.g., two for bf16.
+  std::size_t bytes_per_element = 2;
+
+  // Whether the data samples in each micro-batch are padded to the longest
+  // one, as in `flatflow::SchedulerOptions`.
+  bool pad_to_longest = false;
+};
+
+// flatflow::RecomputePlanner
+//
+// A `flatflow::RecomputePlanner` decides how many layers of each pipeline
+// stage to recompute for each micro-batch, rather than applying activation
+// checkpointing uniformly. Each micro-batch in flight is given an equal share
+// of the per-rank memory budget, and recomputes just enough layers for its
+// activations to fit in that share; short micro-batches thus recompute
+// nothing, while long ones recompute up to every layer of the stage.
+//
+// Activations are assumed to be spread evenly over the repeated layers of the
+// model, identified by their module paths, and the inputs of recomputed layers
+// that are kept for recomputation are not counted.
+class RecomputePlanner {
+ public:
+  using value_type = typename Scheduler::value_type;
+  using size_type = typename Scheduler::size_type;
+
+  // Constructors and assignment operators
+  //
+  // In addition to the constructor to set up planning,
+  // `flatflow::RecomputePlanner` supports a default constructor, as well as
+  // copy/move constructors and assignment operators. The graph is traced once
+  // upon construction and need not outlive the planner.
+  RecomputePlanner() {}
+
+  template <typename InputIterator>
+  RecomputePlanner(InputIterator first, InputIterator last, const Graph *graph,
+                   std::size_t memory_budget,
+                   const RecomputeOptions &options = RecomputeOptions())
+      : pad_to_longest_(options.pad_to_longest) {
+    constexpr auto kZero = static_cast<size_type>(0);
+    constexpr auto kOne = static_cast<size_type>(1);
+    CHECK_NE(options.pipeline_parallel_world_size, kZero);
+    CHECK_NE(options.bytes_per_element, kZero);
+    CHECK_NE(graph, nullptr);
+
+    const auto total_size = static_cast<size_type>(std::distance(first, last));
+    CHECK_NE(total_size, kZero);
+
+    const auto pp = options.pipeline_parallel_world_size;
+
+    // A repeated layer is named after its index, e.g., `model.layers.0`; if
+    // the graph carries no module paths, the whole model is taken as a single
+    // layer.
+    auto num_layers = kZero;
+    for (const auto &[layer, poly] : symbolic_trace_layers(graph)) {
+      if (!layer.empty() &&
+          std::isdigit(static_cast<unsigned char>(layer.back())) != 0) {
+        ++num_layers;
+      }
+    }
+    num_layers_ = std::max((num_layers + pp - 1) / pp, kOne);
+
+    budget_ = static_cast<value_type>(memory_budget /
+                                      options.bytes_per_element / pp);
+
+    mems_.resize(total_size);
+
+    const auto trace_activations = symbolic_trace_activations(graph);
+    const auto stages = static_cast<value_type>(pp);
+
+    // clang-format off
+    #pragma omp parallel for
+    for (size_type index = 0; index < total_size; ++index) {
+      mems_[index] =
+          (trace_activations(*std::next(first, index)) + stages - 1) / stages;
+    }
+    // clang-format on
+
+    LOG(INFO) << absl::StrFormat(
+        "Planning recomputation of up to %u layers per stage within %u bytes",
+        num_layers_, memory_budget);
+  }
+
+  RecomputePlanner(const RecomputePlanner &other) = default;
+
+  RecomputePlanner &operator=(const RecomputePlanner &other) = default;
+
+  RecomputePlanner(RecomputePlanner &&other) = default;
+
+  RecomputePlanner &operator=(RecomputePlanner &&other) = default;
+
+  // Accessors
+  //
+  // The number of layers of each pipeline stage, which bounds the number of
+  // layers to recompute.
+  size_type num_layers() const noexcept { return num_layers_; }
+
+  // RecomputePlanner::Plan()
+  //
+  // Returns the number of layers of each pipeline stage to recompute for the
+  // micro-batch consisting of the samples at the indices in the range
+  // [`first`, `last`). If the activations of the micro-batch do not fit even
+  // with every layer recomputed, every layer is recomputed anyway.
+  template <typename InputIterator>
+  size_type Plan(InputIterator first, InputIterator last) const {
+    const auto mem = Memory(first, last);
+    if (mem <= budget_) {
+      return 0;
+    }
+
+    // Recomputing `r` out of `L` layers drops `r / L` of the activations, so
+    // the smallest such `r` is the ceiling of `L * excess / mem`.
+    const auto layers = static_cast<value_type>(num_layers_);
+    const auto excess = mem - budget_;
+    return static_cast<size_type>(
+        std::min((layers * excess + mem - 1) / mem, layers));
+  }
+
+ protected:
+  // RecomputePlanner::Memory()
+  //
+  // Returns the number of activation elements of each pipeline stage for the
+  // micro-batch consisting of the samples at the indices in the range
+  // [`first`, `last`).
+  template <typename InputIterator>
+  value_type Memory(InputIterator first, InputIterator last) const {
+    if (pad_to_longest_) {
+      auto mem = static_cast<value_type>(0);
+      for (auto it = first; it != last; ++it) {
+        mem = std::max(mem, mems_[*it]);
+      }
+      return mem * static_cast<value_type>(std::distance(first, last));
+    }
+
+    auto mem = static_cast<value_type>(0);
+    for (auto it = first; it != last; ++it) {
+      mem += mems_[*it];
+    }
+    return mem;
+  }
+
+  bool pad_to_longest_;
+  size_type num_layers_;
+  value_type budget_;
+  std::vector<value_type> mems_;
+};
+
+}  // namespace flatflow
+
+#endif  // FLATFLOW_SCHEDULER_RECOMPUTE_H_
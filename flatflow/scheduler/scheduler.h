@@ -18,20 +18,160 @@
 #include <omp.h>
 
 #include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
 #include <functional>
 #include <iterator>
+#include <map>
+#include <numeric>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
 #include <vector>
 
+#include "absl/container/flat_hash_map.h"
+#include "absl/hash/hash.h"
 #include "absl/log/check.h"
 #include "absl/log/log.h"
 #include "absl/strings/str_format.h"
 
 #include "flatflow/ops/graph_generated.h"
 #include "flatflow/ops/ops.h"
+#include "flatflow/ops/passes.h"
+#include "flatflow/scheduler/internal/dictionary.h"
 #include "flatflow/scheduler/internal/partition.h"
 
 namespace flatflow {
 
+// flatflow::SchedulerOptions
+//
+// A `flatflow::SchedulerOptions` holds optional knobs for the scheduler.
+// Default-constructed options reproduce the default scheduling policy, so that
+// each knob can be enabled independently of the others.
+struct SchedulerOptions {
+  // Maps each data parallel rank to the node it resides on. If given, the
+  // per-replica batches are partitioned hierarchically; micro-batches are first
+  // balanced across nodes and then across the ranks within each node.
+  // Every node should hold the same number of ranks.
+  std::vector<std::size_t> node_ids;
+
+  // The number of ranks in each context parallel group, and the minimum size
+  // of a data sample to be split across them. Samples whose size is not less
+  // than `context_parallel_threshold` are marked for context parallel
+  // splitting, and their cost is divided across the context parallel group.
+  // Splitting is disabled if the threshold is zero.
+  std::size_t context_parallel_world_size = 1;
+  std::size_t context_parallel_threshold = 0;
+
+  // Whether the data samples in each micro-batch are padded to the longest one
+  // instead of being concatenated. If set, the cost of a micro-batch is the
+  // cost of its longest sample times the number of samples in it.
+  bool pad_to_longest = false;
+
+  // The number of pipeline stages, and whether to bound the activation memory
+  // held in flight by one-forward-one-backward (1F1B) pipeline schedules.
+  // If set, the micro-batches of each replica are ordered so that every window
+  // of `pipeline_parallel_world_size` consecutive micro-batches holds about
+  // the same amount of activations, rather than in ascending order of cost
+  // where the last window holds the largest micro-batches altogether.
+  std::size_t pipeline_parallel_world_size = 1;
+  bool bound_inflight_activations = false;
+
+  // Maps each data sample to its storage offset, e.g., its byte offset in
+  // a memory-mapped dataset file. If given, the samples in each micro-batch are
+  // ordered by their offsets once partitioning is done, so that data loaders
+  // read them mostly sequentially. This has no effect on balance.
+  std::vector<std::uint64_t> offsets;
+
+  // Maps each data sample to the dataset shard it belongs to, and each shard
+  // to the node that holds it locally. If given along with `node_ids`, samples
+  // are exchanged between the data parallel replicas after partitioning so
+  // that each rank mostly reads local data. Samples of the same cost are
+  // exchanged freely; the others only as long as the cost of the slowest
+  // replica grows by at most a fraction of `max_balance_penalty`.
+  std::vector<std::size_t> shard_ids;
+  std::vector<std::size_t> shard_node_ids;
+  double max_balance_penalty = 0.0;
+
+  // Whether the data parallel replicas may take different numbers of
+  // micro-batches from each global batch. If set, micro-batches are moved from
+  // the slowest replica to the fastest one after partitioning for as long as
+  // this narrows the gap between them, which helps on heavy-tailed data where
+  // equal cardinalities leave the slowest replica with too many heavy
+  // micro-batches. Losses should then be normalized by the mean number of
+  // micro-batches per replica, not by the number on each replica, to keep
+  // gradient accumulation unbiased.
+  //
+  // This is experimental and for internal use only. Trainers that reduce the
+  // loss of each micro-batch across replicas, such as NeMo, cannot run uneven
+  // micro-batch counts, so none of the bundled integrations set this.
+  bool uneven_microbatches = false;
+
+  // The capacities of shape buckets in tokens, in ascending order. If given,
+  // each micro-batch is assigned to the smallest bucket that holds all of its
+  // tokens including any padding, so that ranks can pad every micro-batch to
+  // the capacity of its bucket and reuse one compiled graph per bucket.
+  // Samples are swapped between the micro-batches of each replica to fit
+  // those that exceed the largest bucket where possible; this keeps the
+  // balance across replicas intact.
+  std::vector<std::size_t> bucket_capacities;
+
+  // The number of FLOPs that take as long as moving one element to or from
+  // memory on the target device. If nonzero, the graph is costed after fusing
+  // elementwise chains and dropping views and copies, with memory traffic
+  // charged at this rate on top of FLOPs.
+  std::int64_t memory_cost = 0;
+
+  // The number of tensor parallel ranks, and the number of FLOPs that take as
+  // long as sending one element over the links between them; e.g., the peak
+  // FLOP/s of each rank times the bytes per element over the link bandwidth.
+  // If both are set, the all-reduces after row-parallel projections are
+  // charged on top of FLOPs. A ring all-reduce over `tp` ranks sends each
+  // element `2 * (tp - 1) / tp` times per rank, while each rank computes only
+  // `1 / tp` of the FLOPs, so each element costs `2 * (tp - 1)` times this
+  // rate relative to the FLOPs of the whole model. Since the all-reduced
+  // activations grow linearly with sequence length while attention grows
+  // quadratically, this shifts the balance toward short samples.
+  std::size_t tensor_parallel_world_size = 1;
+  std::int64_t communication_cost = 0;
+
+  // The maximum optimality gap of partitioning micro-batches into the data
+  // parallel replicas, and the time limit in seconds to close it. The gap of
+  // each global batch is the relative excess of the cost of its slowest
+  // replica over a lower bound on that of any partition. If the time limit is
+  // nonzero, partitions obtained by the differencing method whose gap exceeds
+  // `max_partition_gap` are refined by local search; otherwise they are used
+  // as is. If `exact_partition` is set, small instances of a few dozen
+  // micro-batches over a few replicas are solved exactly where possible.
+  // The solver and gap of each global batch are measured and reported only if
+  // any of these is set, so that the default takes the differencing method
+  // alone.
+  double max_partition_gap = 0.0;
+  double partition_time_limit = 0.0;
+  bool exact_partition = false;
+
+  // Whether the schedule is for forward passes only, as in evaluation. If set,
+  // in-flight activations are not bounded, since none are held for backward
+  // passes. Micro-batch counts stay even across the data parallel replicas,
+  // as the evaluation loop runs a fixed number of micro-batches per step and
+  // reduces losses across replicas for each of them. The cost model is left
+  // as is; it already counts forward FLOPs, and the backward pass would only
+  // scale them.
+  bool forward_only = false;
+
+  // Whether to memoize the schedule of each global batch across calls to
+  // `Schedule`, keyed by a hash of the data sample indices in it. Global
+  // batches that were also scheduled in the previous call, e.g., all of them
+  // when the data plane sends the same order every epoch, are then copied
+  // from the cache instead of being reordered again. The cache holds two
+  // indices per data sample, as the indices given to each global batch are
+  // kept to tell hash collisions apart.
+  bool memoize_schedule = false;
+};
+
 // flatflow::Scheduler
 //
 // A common base class for all scheduler implementations. There may be
@@ -39,11 +179,11 @@ namespace flatflow {
 //
 // Note that this scheduler implementation is optimized for balancing
 // computational workloads, i.e., floating point operations. To this end,
-// we provide an operator set and an associated operator registry; models
-// containing operators not yet defined in the operator set may fail to run.
-// See the note on how to register a new operator in `flatflow/ops/ops.h`.
-// Other optimization objectives such as memory footprint may require separate
-// scheduler implementations.
+// we provide an operator set and an associated operator registry; operators
+// not yet defined in the operator set are costed by a generic fallback, which
+// may be less accurate. See the note on how to register a new operator in
+// `flatflow/ops/ops.h`. Other optimization objectives such as memory footprint
+// may require separate scheduler implementations.
 class Scheduler {
  public:
   using value_type =
@@ -61,10 +201,21 @@ class Scheduler {
   template <typename InputIterator>
   Scheduler(size_type data_parallel_world_size, size_type global_batch_size,
             size_type micro_batch_size, InputIterator first, InputIterator last,
-            const Graph *graph)
+            const Graph *graph,
+            const SchedulerOptions &options = SchedulerOptions())
       : data_parallel_world_size_(data_parallel_world_size),
         global_batch_size_(global_batch_size),
-        micro_batch_size_(micro_batch_size) {
+        micro_batch_size_(micro_batch_size),
+        pipeline_parallel_world_size_(options.pipeline_parallel_world_size),
+        pad_to_longest_(options.pad_to_longest),
+        uneven_microbatches_(options.uneven_microbatches),
+        max_balance_penalty_(options.max_balance_penalty),
+        partition_options_(internal::PartitionOptions{
+            options.max_partition_gap, options.partition_time_limit,
+            options.exact_partition}),
+        report_partitions_(0.0 < options.max_partition_gap ||
+                           0.0 < options.partition_time_limit ||
+                           options.exact_partition) {
     constexpr auto kZero = static_cast<size_type>(0);
     CHECK_NE(data_parallel_world_size, kZero);
     CHECK_NE(global_batch_size, kZero);
@@ -75,6 +226,7 @@ class Scheduler {
     const auto total_size = static_cast<size_type>(std::distance(first, last));
     CHECK_NE(total_size, kZero);
     CHECK_EQ(total_size % data_parallel_world_size, kZero);
+    CHECK_NE(options.pipeline_parallel_world_size, kZero);
     CHECK_NE(graph, nullptr);
 
     LOG(INFO) << absl::StrFormat(
@@ -84,6 +236,91 @@ class Scheduler {
         "  micro_batch_size:         %u",
         data_parallel_world_size, global_batch_size, micro_batch_size);
 
+    if (options.forward_only) {
+      LOG(INFO) << "Scheduling forward passes only";
+    }
+
+    if (options.memoize_schedule) {
+      cache_ = ScheduleCache();
+    }
+
+    CHECK_GE(options.max_partition_gap, 0.0);
+    CHECK_GE(options.partition_time_limit, 0.0);
+
+    if (options.partition_time_limit != 0.0) {
+      LOG(INFO) << absl::StrFormat(
+          "Refining partitions with a gap above %f for up to %fs",
+          options.max_partition_gap, options.partition_time_limit);
+    }
+
+    if (!options.offsets.empty()) {
+      CHECK_EQ(options.offsets.size(), total_size);
+      offsets_ = options.offsets;
+    }
+
+    if (!options.bucket_capacities.empty()) {
+      CHECK_NE(options.bucket_capacities.front(), kZero);
+      CHECK(std::is_sorted(options.bucket_capacities.cbegin(),
+                           options.bucket_capacities.cend()));
+      bucket_capacities_.assign(options.bucket_capacities.cbegin(),
+                                options.bucket_capacities.cend());
+
+      LOG(INFO) << absl::StrFormat("Using %u shape buckets of up to %u tokens",
+                                   bucket_capacities_.size(),
+                                   bucket_capacities_.back());
+    }
+
+    if (!options.node_ids.empty()) {
+      CHECK_EQ(options.node_ids.size(), data_parallel_world_size);
+
+      // Ranks are grouped by node in order of their node IDs; the order of
+      // the nodes themselves has no effect on partitioning.
+      auto groups = std::map<size_type, std::vector<size_type>>();
+      for (size_type rank = 0; rank < data_parallel_world_size; ++rank) {
+        groups[options.node_ids[rank]].emplace_back(rank);
+      }
+
+      // The balanced differencing method requires that each subset has the
+      // same cardinality, so there should be the same number of ranks on
+      // every node.
+      const auto ranks_per_node = data_parallel_world_size / groups.size();
+      for (const auto &[node_id, ranks] : groups) {
+        CHECK_EQ(ranks.size(), ranks_per_node);
+      }
+
+      // Hierarchical partitioning degenerates into flat partitioning if there
+      // is only one node or only one rank per node.
+      if (1 < groups.size() && 1 < ranks_per_node) {
+        nodes_.reserve(groups.size());
+        for (auto &[node_id, ranks] : groups) {
+          nodes_.emplace_back(std::move(ranks));
+        }
+
+        LOG(INFO) << absl::StrFormat(
+            "Using hierarchical partitioning over %u nodes with %u ranks each",
+            nodes_.size(), ranks_per_node);
+      }
+    }
+
+    if (!options.shard_ids.empty()) {
+      CHECK_EQ(options.shard_ids.size(), total_size);
+      CHECK_EQ(options.node_ids.size(), data_parallel_world_size);
+      CHECK_GE(options.max_balance_penalty, 0.0);
+
+      node_ids_ = options.node_ids;
+      homes_.resize(total_size);
+
+      for (size_type index = 0; index < total_size; ++index) {
+        CHECK_LT(options.shard_ids[index], options.shard_node_ids.size());
+        homes_[index] = options.shard_node_ids[options.shard_ids[index]];
+      }
+
+      LOG(INFO) << absl::StrFormat(
+          "Using shard affinity over %u shards with a maximum balance penalty "
+          "of %f",
+          options.shard_node_ids.size(), options.max_balance_penalty);
+    }
+
     // (x - 1) % y + 1 is always equal to x % y == 0 ? y : x % y without any
     // branch instructions.
     last_global_batch_size_ = (total_size - 1) % global_batch_size + 1;
@@ -100,16 +337,110 @@ class Scheduler {
         ((total_size / data_parallel_world_size - 1) / micro_batch_size + 1) *
         data_parallel_world_size;
 
-    preds_.resize(total_size);
+    // The cost of a sample depends on its size alone, so the sizes are stored
+    // in dictionary encoding and the predicates are stored once per distinct
+    // size rather than once per sample. This is lossless, and takes two or
+    // four bytes per sample instead of eight, since there are far fewer
+    // distinct sizes than samples in practice.
+    sizes_ = internal::Dictionary<size_type>(first, last);
+    const auto &keys = sizes_.keys();
 
-    const auto trace = symbolic_trace(graph);
+    preds_.resize(keys.size());
+
+    const auto tp = options.tensor_parallel_world_size;
+    CHECK_NE(tp, static_cast<size_type>(0));
+
+    const auto communication_cost =
+        static_cast<value_type>(2 * (tp - 1)) * options.communication_cost;
+
+    const auto trace =
+        options.memory_cost == 0 && communication_cost == 0
+            ? symbolic_trace(graph)
+            : symbolic_trace(graph, default_passes(), options.memory_cost,
+                             communication_cost);
+
+    if (communication_cost != 0) {
+      LOG(INFO) << absl::StrFormat(
+          "Charging all-reduces across %u tensor parallel ranks at %d FLOPs "
+          "per element",
+          tp, communication_cost);
+    }
 
     // clang-format off
     #pragma omp parallel for
-    for (size_type index = 0; index < total_size; ++index) {
-      preds_[index] = trace(*std::next(first, index));
+    for (size_type id = 0; id < keys.size(); ++id) {
+      preds_[id] = trace(keys[id]);
     }
     // clang-format on
+
+    // A sample that alone exceeds the cost of a balanced micro-batch cannot be
+    // balanced by any reordering, as long as samples are indivisible. Such
+    // samples are instead split into pieces across the context parallel group
+    // and processed concurrently, so each piece takes `1 / cp` of the cost.
+    // Since the cost model is monotonic in size, the size threshold is
+    // equivalent to a cost threshold.
+    const auto cp = options.context_parallel_world_size;
+    CHECK_NE(cp, static_cast<size_type>(0));
+
+    if (1 < cp && options.context_parallel_threshold != 0) {
+      const auto threshold = trace(options.context_parallel_threshold);
+      auto num_splits = static_cast<size_type>(0);
+
+      splits_.resize(keys.size());
+
+      for (size_type id = 0; id < keys.size(); ++id) {
+        if (threshold <= preds_[id]) {
+          splits_[id] = true;
+          preds_[id] = (preds_[id] - 1) / static_cast<value_type>(cp) + 1;
+        }
+      }
+
+      for (size_type index = 0; index < total_size; ++index) {
+        if (IsSplit(index)) {
+          ++num_splits;
+        }
+      }
+
+      LOG(INFO) << absl::StrFormat(
+          "Marked %u out of %u samples for splitting across %u context "
+          "parallel ranks",
+          num_splits, total_size, cp);
+    }
+
+    // In 1F1B pipeline schedules, the first stage holds the activations of up
+    // to `pp` micro-batches before their backward passes begin; the peak
+    // activation memory thus depends on the order of micro-batches.
+    // Activations are estimated only if this is taken into account.
+    if (options.bound_inflight_activations && !options.forward_only &&
+        1 < options.pipeline_parallel_world_size) {
+      mems_.resize(keys.size());
+
+      const auto trace_activations = symbolic_trace_activations(graph);
+
+      // clang-format off
+      #pragma omp parallel for
+      for (size_type id = 0; id < keys.size(); ++id) {
+        mems_[id] = trace_activations(keys[id]);
+        if (!splits_.empty() && splits_[id]) {
+          mems_[id] = (mems_[id] - 1) / static_cast<value_type>(cp) + 1;
+        }
+      }
+      // clang-format on
+
+      LOG(INFO) << absl::StrFormat(
+          "Bounding in-flight activations over %u pipeline stages",
+          options.pipeline_parallel_world_size);
+    }
+
+    const auto num_tables = static_cast<size_type>(mems_.empty() ? 1 : 2);
+    LOG(INFO) << absl::StrFormat(
+        "Storing the predicates of %u samples in %u bytes instead of %u bytes "
+        "(%u distinct sizes with %u-bit IDs)",
+        total_size,
+        sizes_.num_bytes() + num_tables * keys.size() * sizeof(value_type) +
+            (splits_.size() + 7) / 8,
+        num_tables * total_size * sizeof(value_type), keys.size(),
+        sizes_.id_width());
   }
 
   Scheduler(const Scheduler &other) = default;
@@ -126,6 +457,15 @@ class Scheduler {
   // the next training epoch. The resulting indices are stored in an output
   // range starting from `result`.
   //
+  // The samples of each global batch are laid out rank by rank, and the number
+  // of samples each rank takes from each global batch is stored in an output
+  // range starting from `sizes`, indexed by global batch and then by rank.
+  // These are all the same unless micro-batch counts may be uneven.
+  //
+  // If `memoize_schedule` is set, this updates the schedule cache and thus is
+  // not reentrant; concurrent calls on the same scheduler must be serialized
+  // by the caller.
+  //
   // CAVEATS
   //
   // This scheduler implementation iteratively reorders the training sequence
@@ -137,28 +477,101 @@ class Scheduler {
   template <typename InputIterator, typename OutputIterator>
   OutputIterator Schedule(InputIterator first, InputIterator last,
                           OutputIterator result) const {
+    const auto total_size = static_cast<size_type>(std::distance(first, last));
+    auto sizes = std::vector<size_type>(
+        (total_size + global_batch_size_ - 1) / global_batch_size_ *
+        data_parallel_world_size_);
+    return Schedule(first, last, result, sizes.begin());
+  }
+
+  template <typename InputIterator, typename OutputIterator,
+            typename SizeOutputIterator>
+  OutputIterator Schedule(InputIterator first, InputIterator last,
+                          OutputIterator result,
+                          SizeOutputIterator sizes) const {
     const auto now = omp_get_wtime();
 
     const auto total_size = static_cast<size_type>(std::distance(first, last));
 
-    const auto comp = std::bind_front(&Scheduler::CompareForSchedule, this);
     const auto pred = std::bind_front(&Scheduler::PredForSchedule, this);
     const auto bpred = std::bind_front(&Scheduler::BatchPredForSchedule, this);
-    const auto proj = std::identity();
 
+    const auto num_global_batches =
+        (total_size + global_batch_size_ - 1) / global_batch_size_;
+
+    // Bucket utilization is the fraction of bucket capacity filled by tokens,
+    // over the micro-batches that fit in any bucket. It is accounted for each
+    // global batch, so that memoized global batches can restore their own.
+    auto usages = std::vector<BucketUsage>(num_global_batches);
+    auto stats = std::vector<internal::PartitionStats>(
+        report_partitions_ ? num_global_batches : 0);
+
+    // Each global batch is looked up in the cache by the hash of its indices;
+    // the schedules of those not found are kept in `entries` to be cached.
+    auto hashes = std::vector<std::uint64_t>(num_global_batches);
+    auto entries = std::vector<std::optional<ScheduleEntry>>(
+        cache_.has_value() ? num_global_batches : 0);
+
+    // Global batches take uneven time to schedule, e.g., the last one is
+    // usually smaller than the others, so each is scheduled as a task of its
+    // own rather than in static chunks. The work within each global batch is
+    // further divided into nested tasks, so that idle threads can take them
+    // over when there are fewer global batches than threads.
     // clang-format off
-    #pragma omp parallel for
+    #pragma omp parallel
+    #pragma omp single
+    #pragma omp taskloop grainsize(1)
     for (size_type offset = 0; offset < total_size;
          offset += global_batch_size_) {
       const auto num_samples = offset + global_batch_size_ < total_size
                                    ? global_batch_size_
                                    : last_global_batch_size_;
+      const auto index = offset / global_batch_size_;
+
+      auto &usage = usages[index];
+      const auto account =
+          [&](const internal::Subset<value_type, size_type> &microbatch) {
+            if (bucket_capacities_.empty()) {
+              return;
+            }
+            const auto bucket = Bucket(microbatch.begin(), microbatch.end());
+            if (bucket < bucket_capacities_.size()) {
+              const auto size = NumTokensForSchedule(microbatch);
+              #pragma omp atomic
+              usage.num_tokens += size;
+              #pragma omp atomic
+              usage.capacity += bucket_capacities_[bucket];
+            } else {
+              #pragma omp atomic
+              ++usage.num_overflows;
+            }
+          };
+      const auto per_replica_sizes =
+          std::next(sizes, index * data_parallel_world_size_);
 
-      // `samples` may not be sorted in order of their predicates; sort them
-      // first for partitioning.
       auto samples = std::vector<size_type>(
           std::next(first, offset), std::next(first, offset + num_samples));
-      std::sort(samples.begin(), samples.end(), comp);
+
+      if (cache_.has_value()) {
+        hashes[index] = absl::Hash<std::vector<size_type>>()(samples);
+        const auto it = cache_->entries.find(hashes[index]);
+        if (it != cache_->entries.end() && it->second.samples == samples) {
+          const auto &entry = it->second;
+          std::copy(entry.indices.cbegin(), entry.indices.cend(),
+                    std::next(result, offset));
+          std::copy(entry.sizes.cbegin(), entry.sizes.cend(),
+                    per_replica_sizes);
+          if (report_partitions_) {
+            stats[index] = entry.stats;
+          }
+          usage = entry.usage;
+          continue;
+        }
+      }
+
+      // `samples` may not be sorted in order of their predicates; sort them
+      // first for partitioning.
+      SortForSchedule(samples.begin(), samples.end());
 
       if (num_samples % (data_parallel_world_size_ * micro_batch_size_) == 0) {
         // If the given batch size is a multiple of both data parallel world
@@ -185,42 +598,49 @@ class Scheduler {
         //   schedules such as GPipe and asynchronous pipeline schedules such as
         //   PipeDream), so we re-partition the resulting micro-batches into
         //   each of the pipelines, which we call coarse-grained partitioning.
+        //   With a few replicas and a few dozen micro-batches, this is small
+        //   enough to be solved exactly where possible, if requested.
         //
         // Note that these kinds of problems do not occur in tensor parallelism,
         // since it always equally distributes the given tensors such as
         // attention heads.
         auto num_microbatches = num_samples / micro_batch_size_;
-        auto microbatches =
-            std::vector<internal::Subset<value_type, size_type>>(
-                num_microbatches);
-        internal::Partition(samples.begin(), samples.end(),
-                            microbatches.begin(), pred, proj, num_microbatches);
-
-        num_microbatches /= data_parallel_world_size_;
-        auto batch = std::vector<internal::Subset<
-            value_type, internal::Subset<value_type, size_type>>>(
-            data_parallel_world_size_);
-        internal::Partition(microbatches.begin(), microbatches.end(),
-                            batch.begin(), bpred, proj,
-                            data_parallel_world_size_);
+        auto microbatches = MicrobatchesForSchedule(
+            samples.begin(), samples.end(), num_microbatches);
+
+        auto batch = PartitionForSchedule(
+            microbatches.begin(), microbatches.end(), bpred,
+            report_partitions_ ? &stats[index] : nullptr);
+        AffinityForSchedule(batch);
+        RebalanceForSchedule(batch);
 
+        // The per-replica batches are finished independently of each other,
+        // each at its own offset in the output range.
+        auto bases = std::vector<size_type>(data_parallel_world_size_ + 1);
+        bases.front() = offset;
+        for (size_type rank = 0; rank < data_parallel_world_size_; ++rank) {
+          bases[rank + 1] = bases[rank] + NumSamplesForSchedule(batch[rank]);
+        }
+
+        #pragma omp taskloop shared(batch, bases, account)
         for (size_type rank = 0; rank < data_parallel_world_size_; ++rank) {
           // The partitioned per-replica batches are guaranteed to be sorted in
           // order of their predicates, while the micro-batches in each of the
-          // replicas are not; they must be sorted to prevent pipeline bubbles.
+          // replicas are not; they must be ordered to prevent pipeline bubbles.
           auto &per_replica_batch = batch[rank];
-          std::sort(per_replica_batch.begin(), per_replica_batch.end());
+          BucketForSchedule(per_replica_batch);
+          OrderForSchedule(per_replica_batch);
 
-          const auto base =
-              offset + num_samples / data_parallel_world_size_ * rank;
+          auto base = bases[rank];
 
-          for (size_type microbatch_id = 0; microbatch_id < num_microbatches;
-               ++microbatch_id) {
-            std::move(
-                per_replica_batch[microbatch_id].begin(),
-                per_replica_batch[microbatch_id].end(),
-                std::next(result, base + micro_batch_size_ * microbatch_id));
+          for (auto &microbatch : per_replica_batch) {
+            account(microbatch);
+            std::move(microbatch.begin(), microbatch.end(),
+                      std::next(result, base));
+            base += microbatch.items().size();
           }
+
+          *std::next(per_replica_sizes, rank) = bases[rank + 1] - bases[rank];
         }
       } else {
         // When the given batch size is not a multiple of both data parallel
@@ -228,68 +648,202 @@ class Scheduler {
         // and the last micro-batch size is different from the others), the
         // corresponding batch cannot be directly reordered. The remainders are
         // first reordered and then the quotients are in the same way as above.
+        // Each replica takes its remainders after its quotients.
+        // If samples are padded, the remainders are grouped into micro-batches
+        // of similar sizes first, which are then balanced across the replicas
+        // by their padded costs like the other micro-batches.
         const auto num_remainders =
             data_parallel_world_size_ * last_micro_batch_size_;
         auto last_microbatches =
-            std::vector<internal::Subset<value_type, size_type>>(
-                data_parallel_world_size_);
-        internal::Partition(std::prev(samples.end(), num_remainders),
-                            samples.end(), last_microbatches.begin(), pred,
-                            proj, data_parallel_world_size_);
+            std::vector<internal::Subset<value_type, size_type>>();
+        if (pad_to_longest_) {
+          auto remainders = MicrobatchesForSchedule(
+              std::prev(samples.end(), num_remainders), samples.end(),
+              data_parallel_world_size_);
+          auto per_replica_remainders = PartitionForSchedule(
+              remainders.begin(), remainders.end(), bpred);
+          last_microbatches.reserve(data_parallel_world_size_);
+          for (auto &per_replica_remainder : per_replica_remainders) {
+            last_microbatches.emplace_back(
+                std::move(per_replica_remainder.items().front()));
+          }
+        } else {
+          last_microbatches = PartitionForSchedule(
+              std::prev(samples.end(), num_remainders), samples.end(), pred);
+        }
 
-        for (size_type rank = 0; rank < data_parallel_world_size_; ++rank) {
-          auto &per_replica_microbatch = last_microbatches[rank];
+        auto num_microbatches =
+            (num_samples - num_remainders) / micro_batch_size_;
+        auto microbatches = MicrobatchesForSchedule(
+            samples.begin(), std::prev(samples.end(), num_remainders),
+            num_microbatches);
 
-          const auto base = offset + (num_samples - num_remainders) /
-                                         data_parallel_world_size_;
+        auto batch = PartitionForSchedule(
+            microbatches.begin(), microbatches.end(), bpred,
+            report_partitions_ ? &stats[index] : nullptr);
 
-          std::move(
-              per_replica_microbatch.begin(), per_replica_microbatch.end(),
-              std::next(result,
-                        base + num_samples / data_parallel_world_size_ * rank));
+        // The remainders are exchanged along with the other samples of each
+        // replica, so that they are also placed on the nodes of their shards.
+        if (!homes_.empty()) {
+          for (size_type rank = 0; rank < data_parallel_world_size_; ++rank) {
+            batch[rank].sum() += last_microbatches[rank].sum();
+            batch[rank].items().emplace_back(
+                std::move(last_microbatches[rank]));
+          }
+          AffinityForSchedule(batch);
+          for (size_type rank = 0; rank < data_parallel_world_size_; ++rank) {
+            last_microbatches[rank] = std::move(batch[rank].items().back());
+            batch[rank].items().pop_back();
+            batch[rank].sum() -= last_microbatches[rank].sum();
+          }
         }
+        RebalanceForSchedule(batch);
 
-        auto num_microbatches =
-            (num_samples - num_remainders) / micro_batch_size_;
-        auto microbatches =
-            std::vector<internal::Subset<value_type, size_type>>(
-                num_microbatches);
-        internal::Partition(samples.begin(),
-                            std::prev(samples.end(), num_remainders),
-                            microbatches.begin(), pred, proj, num_microbatches);
-
-        num_microbatches /= data_parallel_world_size_;
-        auto batch = std::vector<internal::Subset<
-            value_type, internal::Subset<value_type, size_type>>>(
-            data_parallel_world_size_);
-        internal::Partition(microbatches.begin(), microbatches.end(),
-                            batch.begin(), bpred, proj,
-                            data_parallel_world_size_);
+        auto bases = std::vector<size_type>(data_parallel_world_size_ + 1);
+        bases.front() = offset;
+        for (size_type rank = 0; rank < data_parallel_world_size_; ++rank) {
+          bases[rank + 1] = bases[rank] + NumSamplesForSchedule(batch[rank]) +
+                            last_microbatches[rank].items().size();
+        }
 
+        #pragma omp taskloop shared(batch, bases, account, last_microbatches)
         for (size_type rank = 0; rank < data_parallel_world_size_; ++rank) {
           auto &per_replica_batch = batch[rank];
-          std::sort(per_replica_batch.begin(), per_replica_batch.end());
+          BucketForSchedule(per_replica_batch);
+          OrderForSchedule(per_replica_batch);
 
-          const auto base =
-              offset + num_samples / data_parallel_world_size_ * rank;
+          auto base = bases[rank];
 
-          for (size_type microbatch_id = 0; microbatch_id < num_microbatches;
-               ++microbatch_id) {
-            std::move(
-                per_replica_batch[microbatch_id].begin(),
-                per_replica_batch[microbatch_id].end(),
-                std::next(result, base + micro_batch_size_ * microbatch_id));
+          for (auto &microbatch : per_replica_batch) {
+            account(microbatch);
+            std::move(microbatch.begin(), microbatch.end(),
+                      std::next(result, base));
+            base += microbatch.items().size();
           }
+
+          auto &per_replica_microbatch = last_microbatches[rank];
+          LocalizeForSchedule(per_replica_microbatch);
+          account(per_replica_microbatch);
+
+          std::move(per_replica_microbatch.begin(),
+                    per_replica_microbatch.end(), std::next(result, base));
+
+          *std::next(per_replica_sizes, rank) = bases[rank + 1] - bases[rank];
         }
       }
+
+      if (cache_.has_value()) {
+        entries[index] = ScheduleEntry{
+            std::vector<size_type>(std::next(first, offset),
+                                   std::next(first, offset + num_samples)),
+            std::vector<size_type>(std::next(result, offset),
+                                   std::next(result, offset + num_samples)),
+            std::vector<size_type>(
+                per_replica_sizes,
+                std::next(per_replica_sizes, data_parallel_world_size_)),
+            report_partitions_ ? stats[index] : internal::PartitionStats(),
+            usage};
+      }
     }
 
     LOG(INFO) << absl::StrFormat("Reordering %u micro-batches took %fs", num_microbatches_, omp_get_wtime() - now);
     // clang-format on
 
+    ReportForSchedule(stats);
+
+    if (cache_.has_value()) {
+      MemoizeForSchedule(hashes, entries);
+    }
+
+    if (!bucket_capacities_.empty()) {
+      auto total = BucketUsage();
+      for (const auto &usage : usages) {
+        total.num_tokens += usage.num_tokens;
+        total.capacity += usage.capacity;
+        total.num_overflows += usage.num_overflows;
+      }
+
+      LOG(INFO) << absl::StrFormat(
+          "Bucket utilization: %f (%u micro-batches exceed the largest bucket)",
+          total.capacity == 0 ? 0.0
+                              : static_cast<double>(total.num_tokens) /
+                                    static_cast<double>(total.capacity),
+          total.num_overflows);
+    }
+
     return std::next(result, total_size);
   }
 
+  // Scheduler::IsSplit()
+  //
+  // Returns whether the sample at the given index is split across the context
+  // parallel group.
+  bool IsSplit(size_type index) const {
+    return !splits_.empty() && splits_[sizes_.id(index)];
+  }
+
+  // Scheduler::Cost()
+  //
+  // Returns the predicted cost of the micro-batch consisting of the samples at
+  // the indices in the range [`first`, `last`), as balanced by the scheduler.
+  template <typename InputIterator>
+  value_type Cost(InputIterator first, InputIterator last) const {
+    if (pad_to_longest_) {
+      auto cost = static_cast<value_type>(0);
+      for (auto it = first; it != last; ++it) {
+        cost = std::max(cost, PredForSchedule(*it));
+      }
+      return static_cast<value_type>(std::distance(first, last)) * cost;
+    }
+
+    auto cost = static_cast<value_type>(0);
+    for (auto it = first; it != last; ++it) {
+      cost += PredForSchedule(*it);
+    }
+    return cost;
+  }
+
+  // Scheduler::NumTokens()
+  //
+  // Returns the number of tokens in the micro-batch consisting of the samples
+  // at the indices in the range [`first`, `last`), as laid out in memory.
+  // If samples are padded, this includes the padding.
+  template <typename InputIterator>
+  size_type NumTokens(InputIterator first, InputIterator last) const {
+    if (pad_to_longest_) {
+      auto size = static_cast<size_type>(0);
+      for (auto it = first; it != last; ++it) {
+        size = std::max(size, sizes_[*it]);
+      }
+      return static_cast<size_type>(std::distance(first, last)) * size;
+    }
+
+    auto size = static_cast<size_type>(0);
+    for (auto it = first; it != last; ++it) {
+      size += sizes_[*it];
+    }
+    return size;
+  }
+
+  // Scheduler::Bucket()
+  //
+  // Returns the ID of the smallest shape bucket that holds the micro-batch
+  // consisting of the samples at the indices in the range [`first`, `last`).
+  // If no bucket holds it, or there are no buckets, the number of buckets is
+  // returned instead.
+  template <typename InputIterator>
+  size_type Bucket(InputIterator first, InputIterator last) const {
+    if (bucket_capacities_.empty()) {
+      return 0;
+    }
+
+    const auto num_tokens = NumTokens(first, last);
+    return static_cast<size_type>(
+        std::distance(bucket_capacities_.cbegin(),
+                      std::lower_bound(bucket_capacities_.cbegin(),
+                                       bucket_capacities_.cend(), num_tokens)));
+  }
+
   // Scheduler::on_epoch_begin()
   //
   // A callback to be called at the beginning of an epoch.
@@ -311,19 +865,104 @@ class Scheduler {
   void on_train_end() const noexcept {}
 
  private:
+  // Scheduler::BucketUsage
+  //
+  // The number of tokens and the capacity of the shape buckets taken by the
+  // micro-batches of a global batch, along with the number of micro-batches
+  // that exceed the largest bucket.
+  struct BucketUsage {
+    size_type num_tokens = 0;
+    size_type capacity = 0;
+    size_type num_overflows = 0;
+  };
+
+  // Scheduler::ScheduleEntry
+  //
+  // The memoized schedule of a global batch; the indices as given, the
+  // reordered indices, the number of samples each rank takes, and what was
+  // reported for it. The given indices are compared on lookup, so that a hash
+  // collision counts as a miss.
+  struct ScheduleEntry {
+    std::vector<size_type> samples;
+    std::vector<size_type> indices;
+    std::vector<size_type> sizes;
+    internal::PartitionStats stats;
+    BucketUsage usage;
+  };
+
+  // Scheduler::ScheduleCache
+  //
+  // The memoized schedules of the global batches in the previous call to
+  // `Schedule`, keyed by the hash of their indices, along with the number of
+  // global batches found so far out of those looked up. Each copy of a
+  // scheduler has a cache of its own.
+  struct ScheduleCache {
+    absl::flat_hash_map<std::uint64_t, ScheduleEntry> entries;
+    size_type num_hits = 0;
+    size_type num_lookups = 0;
+  };
+
   // Helper functions for Schedule()
   //
   // Scheduler::CompareForSchedule()
   //
   // Compares the two given indices based on their predicates.
   bool CompareForSchedule(size_type lhs, size_type rhs) const {
-    return preds_[lhs] < preds_[rhs];
+    return PredForSchedule(lhs) < PredForSchedule(rhs);
+  }
+
+  // Scheduler::SortForSchedule()
+  //
+  // Sorts the samples in the range [`first`, `last`) in order of their
+  // predicates. Large ranges are split in halves, which are sorted as tasks
+  // and then merged. The split depends only on the number of samples, so
+  // the result does not depend on the number of threads.
+  template <typename RandomAccessIterator>
+  void SortForSchedule(RandomAccessIterator first,
+                       RandomAccessIterator last) const {
+    constexpr auto kGrainSize = static_cast<std::ptrdiff_t>(1 << 14);
+
+    const auto comp = std::bind_front(&Scheduler::CompareForSchedule, this);
+
+    const auto size = std::distance(first, last);
+    if (size <= kGrainSize) {
+      std::sort(first, last, comp);
+      return;
+    }
+
+    const auto middle = std::next(first, size / 2);
+
+    // clang-format off
+    #pragma omp task
+    SortForSchedule(first, middle);
+    #pragma omp task
+    SortForSchedule(middle, last);
+    #pragma omp taskwait
+    // clang-format on
+
+    std::inplace_merge(first, middle, last, comp);
+  }
+
+  // Scheduler::NumSamplesForSchedule()
+  //
+  // Returns the number of samples in the given per-replica batch.
+  size_type NumSamplesForSchedule(
+      const internal::Subset<value_type,
+                             internal::Subset<value_type, size_type>>
+          &per_replica_batch) const {
+    auto num_samples = static_cast<size_type>(0);
+    for (const auto &microbatch : per_replica_batch) {
+      num_samples += microbatch.items().size();
+    }
+    return num_samples;
   }
 
   // Scheduler::PredForSchedule()
   //
   // Returns the predicate for a given index.
-  value_type PredForSchedule(size_type index) const { return preds_[index]; }
+  value_type PredForSchedule(size_type index) const {
+    return preds_[sizes_.id(index)];
+  }
 
   // Scheduler::BatchPredForSchedule()
   //
@@ -333,6 +972,637 @@ class Scheduler {
     return subset.sum();
   }
 
+  // Scheduler::MicrobatchesForSchedule()
+  //
+  // Partitions the given samples in the range [`first`, `last`), which are
+  // sorted in order of their predicates, into `num_microbatches` micro-batches
+  // of the same size. The resulting micro-batches are sorted in order of their
+  // predicates.
+  //
+  // If the samples are concatenated, the cost of a micro-batch is the sum of
+  // the costs of its samples, and this is a balanced number partitioning
+  // problem. If the samples are padded to the longest one, the cost of
+  // a micro-batch is instead the cost of its longest sample times the number of
+  // samples in it. The total padded cost is then minimized by grouping
+  // consecutive samples in sorted order, which also yields the least padding;
+  // balance is recovered afterwards when partitioning the micro-batches into
+  // the data parallel replicas.
+  template <typename InputIterator>
+  std::vector<internal::Subset<value_type, size_type>> MicrobatchesForSchedule(
+      InputIterator first, InputIterator last,
+      size_type num_microbatches) const {
+    const auto pred = std::bind_front(&Scheduler::PredForSchedule, this);
+    const auto proj = std::identity();
+
+    auto microbatches =
+        std::vector<internal::Subset<value_type, size_type>>(num_microbatches);
+
+    if (num_microbatches == 0) {
+      return microbatches;
+    }
+
+    if (!pad_to_longest_) {
+      internal::Partition(first, last, microbatches.begin(), pred, proj,
+                          num_microbatches);
+      return microbatches;
+    }
+
+    const auto total_size = static_cast<size_type>(std::distance(first, last));
+    const auto micro_batch_size = total_size / num_microbatches;
+
+    for (size_type microbatch_id = 0; microbatch_id < num_microbatches;
+         ++microbatch_id) {
+      auto items = std::vector<size_type>(
+          std::next(first, micro_batch_size * microbatch_id),
+          std::next(first, micro_batch_size * (microbatch_id + 1)));
+      const auto sum = static_cast<value_type>(micro_batch_size) *
+                       PredForSchedule(items.back());
+      microbatches[microbatch_id] =
+          internal::Subset<value_type, size_type>(sum, std::move(items));
+    }
+
+    return microbatches;
+  }
+
+  // Scheduler::MemoryForSchedule()
+  //
+  // Returns the estimated activation memory of a given micro-batch.
+  value_type MemoryForSchedule(
+      const internal::Subset<value_type, size_type> &microbatch) const {
+    if (pad_to_longest_) {
+      auto mem = static_cast<value_type>(0);
+      for (auto index : microbatch) {
+        mem = std::max(mem, mems_[sizes_.id(index)]);
+      }
+      return static_cast<value_type>(microbatch.items().size()) * mem;
+    }
+
+    auto mem = static_cast<value_type>(0);
+    for (auto index : microbatch) {
+      mem += mems_[sizes_.id(index)];
+    }
+    return mem;
+  }
+
+  // Scheduler::NumTokensForSchedule()
+  //
+  // Returns the number of tokens in a given micro-batch including any padding.
+  size_type NumTokensForSchedule(
+      const internal::Subset<value_type, size_type> &microbatch) const {
+    if (pad_to_longest_) {
+      auto size = static_cast<size_type>(0);
+      for (auto index : microbatch) {
+        size = std::max(size, sizes_[index]);
+      }
+      return static_cast<size_type>(microbatch.items().size()) * size;
+    }
+
+    auto size = static_cast<size_type>(0);
+    for (auto index : microbatch) {
+      size += sizes_[index];
+    }
+    return size;
+  }
+
+  // Scheduler::BucketForSchedule()
+  //
+  // Fits the micro-batches of a given per-replica batch into smaller shape
+  // buckets by swapping their samples with smaller ones from the other
+  // micro-batches of the same replica. A micro-batch that exceeds the largest
+  // bucket may push the other one up to the largest bucket, while one that
+  // exceeds any smaller bucket by a little may only take a swap that keeps the
+  // other one in its bucket. Among such swaps, the one that moves the fewest
+  // tokens is taken. This is repeated until no swap applies; each swap either
+  // removes an overflow or moves a micro-batch into a smaller bucket without
+  // moving any other into a larger one, so this terminates. Swapping within
+  // a replica leaves its total cost unchanged, so the balance across replicas
+  // is unaffected.
+  //
+  // This is skipped when samples are padded, as the number of tokens of
+  // a micro-batch then depends on its longest sample alone.
+  void BucketForSchedule(
+      internal::Subset<value_type, internal::Subset<value_type, size_type>>
+          &per_replica_batch) const {
+    if (bucket_capacities_.empty() || pad_to_longest_) {
+      return;
+    }
+
+    const auto num_buckets = bucket_capacities_.size();
+    const auto num_microbatches = per_replica_batch.items().size();
+
+    const auto bucket = [&](size_type num_tokens) {
+      return static_cast<size_type>(std::distance(
+          bucket_capacities_.cbegin(),
+          std::lower_bound(bucket_capacities_.cbegin(),
+                           bucket_capacities_.cend(), num_tokens)));
+    };
+
+    auto num_tokens = std::vector<size_type>(num_microbatches);
+    for (size_type microbatch_id = 0; microbatch_id < num_microbatches;
+         ++microbatch_id) {
+      num_tokens[microbatch_id] =
+          NumTokensForSchedule(per_replica_batch[microbatch_id]);
+    }
+
+    for (auto is_changed = true; is_changed;) {
+      is_changed = false;
+
+      for (size_type lhs = 0; lhs < num_microbatches; ++lhs) {
+        const auto lbucket = bucket(num_tokens[lhs]);
+        if (lbucket == 0) {
+          continue;
+        }
+        const auto excess = num_tokens[lhs] - bucket_capacities_[lbucket - 1];
+        const auto is_overflow = lbucket == num_buckets;
+
+        // A swap is identified by the micro-batch and positions of both
+        // samples.
+        auto best = std::tuple<size_type, size_type, size_type>();
+        auto best_delta = static_cast<size_type>(0);
+
+        for (size_type rhs = 0; rhs < num_microbatches; ++rhs) {
+          const auto rbucket = bucket(num_tokens[rhs]);
+          if (rhs == lhs || rbucket == num_buckets) {
+            continue;
+          }
+          const auto slack =
+              bucket_capacities_[is_overflow ? num_buckets - 1 : rbucket] -
+              num_tokens[rhs];
+          auto &lbatch = per_replica_batch[lhs];
+          auto &rbatch = per_replica_batch[rhs];
+          for (size_type lpos = 0; lpos < lbatch.items().size(); ++lpos) {
+            for (size_type rpos = 0; rpos < rbatch.items().size(); ++rpos) {
+              const auto lsize = sizes_[lbatch[lpos]];
+              const auto rsize = sizes_[rbatch[rpos]];
+              if (lsize <= rsize) {
+                continue;
+              }
+              const auto delta = lsize - rsize;
+              if (excess <= delta && delta <= slack &&
+                  (best_delta == 0 || delta < best_delta)) {
+                best = {rhs, lpos, rpos};
+                best_delta = delta;
+              }
+            }
+          }
+        }
+
+        if (best_delta == 0) {
+          continue;
+        }
+
+        const auto &[rhs, lpos, rpos] = best;
+        auto &lbatch = per_replica_batch[lhs];
+        auto &rbatch = per_replica_batch[rhs];
+        const auto lpred = PredForSchedule(lbatch[lpos]);
+        const auto rpred = PredForSchedule(rbatch[rpos]);
+        lbatch.sum() += rpred - lpred;
+        rbatch.sum() += lpred - rpred;
+        std::swap(lbatch[lpos], rbatch[rpos]);
+        num_tokens[lhs] -= best_delta;
+        num_tokens[rhs] += best_delta;
+        is_changed = true;
+      }
+    }
+  }
+
+  // Scheduler::OrderForSchedule()
+  //
+  // Orders the micro-batches of a given per-replica batch for pipelining.
+  // By default, the micro-batches are sorted in ascending order of their
+  // predicates so that an earlier micro-batch takes less execution time than
+  // the subsequent one.
+  //
+  // If in-flight activations are bounded, the micro-batches are instead
+  // partitioned into rounds of `pp` micro-batches each by their activation
+  // memory, using the balanced differencing method with zero-memory
+  // placeholders for the last round. Any window of `pp` consecutive
+  // micro-batches then spans at most two adjacent rounds, whose sums are
+  // balanced. The rounds are arranged in ascending order of memory and the
+  // micro-batches within each round in ascending order of predicates, which
+  // preserves the bubble reduction at the granularity of round.
+  //
+  // In either case, the samples in each micro-batch are ordered by their
+  // storage offsets if known.
+  void OrderForSchedule(
+      internal::Subset<value_type, internal::Subset<value_type, size_type>>
+          &per_replica_batch) const {
+    std::sort(per_replica_batch.begin(), per_replica_batch.end());
+
+    for (auto &microbatch : per_replica_batch) {
+      LocalizeForSchedule(microbatch);
+    }
+
+    const auto pp = pipeline_parallel_world_size_;
+    const auto num_microbatches = per_replica_batch.items().size();
+
+    if (mems_.empty() || num_microbatches <= pp) {
+      return;
+    }
+
+    // Placeholders are indexed after the actual micro-batches.
+    const auto num_rounds = (num_microbatches - 1) / pp + 1;
+    auto mems = std::vector<value_type>(num_rounds * pp);
+    for (size_type microbatch_id = 0; microbatch_id < num_microbatches;
+         ++microbatch_id) {
+      mems[microbatch_id] = MemoryForSchedule(per_replica_batch[microbatch_id]);
+    }
+
+    const auto pred = [&](size_type microbatch_id) {
+      return mems[microbatch_id];
+    };
+
+    auto microbatch_ids = std::vector<size_type>(mems.size());
+    std::iota(microbatch_ids.begin(), microbatch_ids.end(), 0);
+    std::sort(
+        microbatch_ids.begin(), microbatch_ids.end(),
+        [&](size_type lhs, size_type rhs) { return pred(lhs) < pred(rhs); });
+
+    auto rounds =
+        std::vector<internal::Subset<value_type, size_type>>(num_rounds);
+    internal::Partition(microbatch_ids.begin(), microbatch_ids.end(),
+                        rounds.begin(), pred, std::identity(), num_rounds);
+
+    auto microbatches = std::vector<internal::Subset<value_type, size_type>>();
+    microbatches.reserve(num_microbatches);
+
+    for (auto &round : rounds) {
+      // The micro-batches are already sorted, so are their indices.
+      std::sort(round.begin(), round.end());
+      for (auto microbatch_id : round) {
+        if (microbatch_id < num_microbatches) {
+          auto &microbatch = per_replica_batch[microbatch_id];
+          microbatches.emplace_back(std::move(microbatch));
+        }
+      }
+    }
+
+    per_replica_batch.items() = std::move(microbatches);
+  }
+
+  // Scheduler::LocalizeForSchedule()
+  //
+  // Sorts the samples in a given micro-batch in order of their storage offsets
+  // if known. The samples in a micro-batch are processed together regardless
+  // of their order, so this is free of any change in cost.
+  void LocalizeForSchedule(
+      internal::Subset<value_type, size_type> &microbatch) const {
+    if (offsets_.empty()) {
+      return;
+    }
+
+    std::sort(microbatch.begin(), microbatch.end(),
+              [&](size_type lhs, size_type rhs) {
+                return offsets_[lhs] < offsets_[rhs];
+              });
+  }
+
+  // Scheduler::AffinityForSchedule()
+  //
+  // Exchanges samples between the given per-replica batches so that each
+  // sample is assigned to a rank on the node that holds its shard wherever
+  // possible. This is done in two passes:
+  //
+  // * Samples of the same cost are interchangeable without any change in
+  //   balance, so they are first reassigned within each group of the same cost
+  //   to match as many samples to their nodes as possible.
+  // * Then, pairs of misplaced samples that belong to each other's node are
+  //   swapped, in ascending order of cost, as long as no replica exceeds the
+  //   cost of the slowest one by more than the maximum balance penalty.
+  //   This pass is skipped when samples are padded, as exchanging samples of
+  //   different costs then changes the cost of micro-batches non-linearly.
+  //
+  // The remainder micro-batches of the last global batch, if any, are passed
+  // in as the last micro-batch of each replica.
+  void AffinityForSchedule(
+      std::vector<internal::Subset<
+          value_type, internal::Subset<value_type, size_type>>> &batch) const {
+    if (homes_.empty()) {
+      return;
+    }
+
+    // A slot refers to a sample by its rank, micro-batch and position.
+    using slot_type = std::tuple<size_type, size_type, size_type>;
+
+    const auto sample = [&](const slot_type &slot) -> size_type & {
+      const auto &[rank, microbatch_id, position] = slot;
+      return batch[rank][microbatch_id][position];
+    };
+
+    auto slots = std::vector<slot_type>();
+    for (size_type rank = 0; rank < batch.size(); ++rank) {
+      for (size_type microbatch_id = 0;
+           microbatch_id < batch[rank].items().size(); ++microbatch_id) {
+        for (size_type position = 0;
+             position < batch[rank][microbatch_id].items().size();
+             ++position) {
+          slots.emplace_back(rank, microbatch_id, position);
+        }
+      }
+    }
+
+    std::sort(slots.begin(), slots.end(),
+              [&](const slot_type &lhs, const slot_type &rhs) {
+                return PredForSchedule(sample(lhs)) <
+                       PredForSchedule(sample(rhs));
+              });
+
+    for (auto first = slots.begin(); first != slots.end();) {
+      const auto pred = PredForSchedule(sample(*first));
+      const auto last =
+          std::find_if(first, slots.end(), [&](const slot_type &slot) {
+            return PredForSchedule(sample(slot)) != pred;
+          });
+
+      auto samples = std::map<size_type, std::vector<size_type>>();
+      for (auto it = first; it != last; ++it) {
+        samples[homes_[sample(*it)]].emplace_back(sample(*it));
+      }
+
+      auto pending = std::vector<slot_type>();
+      for (auto it = first; it != last; ++it) {
+        auto &local = samples[node_ids_[std::get<0>(*it)]];
+        if (local.empty()) {
+          pending.emplace_back(*it);
+        } else {
+          sample(*it) = local.back();
+          local.pop_back();
+        }
+      }
+
+      auto slot = pending.begin();
+      for (auto &[node_id, remote] : samples) {
+        for (auto index : remote) {
+          sample(*slot++) = index;
+        }
+      }
+
+      first = last;
+    }
+
+    if (pad_to_longest_ || max_balance_penalty_ <= 0.0) {
+      return;
+    }
+
+    auto limit = static_cast<value_type>(0);
+    for (const auto &per_replica_batch : batch) {
+      limit = std::max(limit, per_replica_batch.sum());
+    }
+    limit += static_cast<value_type>(static_cast<double>(limit) *
+                                     max_balance_penalty_);
+
+    // Misplaced samples are grouped by their current node and home node.
+    // Since `slots` is sorted, so is each of the groups.
+    auto misplaced = std::map<std::pair<size_type, size_type>,
+                              std::vector<slot_type>>();
+    for (const auto &slot : slots) {
+      const auto node_id = node_ids_[std::get<0>(slot)];
+      const auto home = homes_[sample(slot)];
+      if (node_id != home) {
+        misplaced[{node_id, home}].emplace_back(slot);
+      }
+    }
+
+    for (const auto &[nodes, lhs] : misplaced) {
+      const auto &[node_id, home] = nodes;
+      if (home < node_id || !misplaced.contains({home, node_id})) {
+        continue;
+      }
+
+      const auto &rhs = misplaced.at({home, node_id});
+
+      for (size_type lindex = 0, rindex = 0;
+           lindex < lhs.size() && rindex < rhs.size();) {
+        const auto lpred = PredForSchedule(sample(lhs[lindex]));
+        const auto rpred = PredForSchedule(sample(rhs[rindex]));
+        auto &lbatch = batch[std::get<0>(lhs[lindex])];
+        auto &rbatch = batch[std::get<0>(rhs[rindex])];
+
+        if (lbatch.sum() + rpred - lpred <= limit &&
+            rbatch.sum() + lpred - rpred <= limit) {
+          lbatch.sum() += rpred - lpred;
+          rbatch.sum() += lpred - rpred;
+          lbatch[std::get<1>(lhs[lindex])].sum() += rpred - lpred;
+          rbatch[std::get<1>(rhs[rindex])].sum() += lpred - rpred;
+          std::swap(sample(lhs[lindex]), sample(rhs[rindex]));
+          ++lindex;
+          ++rindex;
+        } else if (lpred < rpred) {
+          ++lindex;
+        } else {
+          ++rindex;
+        }
+      }
+    }
+  }
+
+  // Scheduler::RebalanceForSchedule()
+  //
+  // Moves micro-batches from the slowest replica to the fastest one if
+  // micro-batch counts may be uneven. Each move takes the micro-batch whose
+  // cost is closest to half the gap between the two, as long as it is less
+  // than the gap; the sum of squared replica costs strictly decreases with
+  // every move, so this always terminates. Every replica keeps at least one
+  // micro-batch.
+  void RebalanceForSchedule(
+      std::vector<internal::Subset<
+          value_type, internal::Subset<value_type, size_type>>> &batch) const {
+    if (!uneven_microbatches_ || batch.size() < 2) {
+      return;
+    }
+
+    const auto comp = [](const auto &lhs, const auto &rhs) {
+      return lhs.sum() < rhs.sum();
+    };
+
+    for (;;) {
+      const auto [min, max] = std::minmax_element(batch.begin(), batch.end(),
+                                                  comp);
+      const auto gap = max->sum() - min->sum();
+      auto &items = max->items();
+
+      if (gap <= 0 || items.size() < 2) {
+        return;
+      }
+
+      auto it = items.end();
+      for (auto candidate = items.begin(); candidate != items.end();
+           ++candidate) {
+        const auto sum = candidate->sum();
+        if (0 < sum && sum < gap &&
+            (it == items.end() ||
+             std::abs(2 * sum - gap) < std::abs(2 * it->sum() - gap))) {
+          it = candidate;
+        }
+      }
+
+      if (it == items.end()) {
+        return;
+      }
+
+      max->sum() -= it->sum();
+      min->sum() += it->sum();
+      min->items().emplace_back(std::move(*it));
+      items.erase(it);
+    }
+  }
+
+  // Scheduler::PartitionForSchedule()
+  //
+  // Partitions the given items in the range [`first`, `last`), which are
+  // sorted in order of their predicates `pred`, into the data parallel
+  // replicas. The resulting subsets are indexed by rank.
+  //
+  // If the topology of the data parallel group is known, the items are first
+  // partitioned into nodes and then into the ranks within each node. This keeps
+  // the node-level sums balanced, as the inter-node stage of hierarchical
+  // gradient reduction waits for the slowest node rather than the slowest rank.
+  //
+  // If `stats` is given, the solver and gap of the partition are stored in it;
+  // for hierarchical partitioning, those of the worst level are stored. Small
+  // instances are solved exactly only in this case; other partitions, such as
+  // those of the remainders, take the differencing method as is.
+  template <typename InputIterator, typename Pred>
+  std::vector<internal::Subset<value_type, std::iter_value_t<InputIterator>>>
+  PartitionForSchedule(InputIterator first, InputIterator last, Pred pred,
+                       internal::PartitionStats *stats = nullptr) const {
+    using item_type = std::iter_value_t<InputIterator>;
+
+    const auto proj = std::identity();
+
+    auto options = partition_options_;
+    options.exact = options.exact && stats != nullptr;
+
+    auto batch = std::vector<internal::Subset<value_type, item_type>>(
+        data_parallel_world_size_);
+
+    if (nodes_.empty()) {
+      internal::Partition(first, last, batch.begin(), pred, proj,
+                          data_parallel_world_size_, options, stats);
+      return batch;
+    }
+
+    // The last entry holds the stats of the node level.
+    const auto num_nodes = nodes_.size();
+    auto levels = std::vector<internal::PartitionStats>(num_nodes + 1);
+
+    auto per_node_batches =
+        std::vector<internal::Subset<value_type, item_type>>(num_nodes);
+    internal::Partition(first, last, per_node_batches.begin(), pred, proj,
+                        num_nodes, options,
+                        stats == nullptr ? nullptr : &levels.back());
+
+    // The nodes are partitioned independently of each other.
+    // clang-format off
+    #pragma omp taskloop shared(batch, levels, options, per_node_batches, pred)
+    for (size_type node = 0; node < num_nodes; ++node) {
+      auto &items = per_node_batches[node].items();
+      std::sort(items.begin(), items.end(),
+                [&](const auto &lhs, const auto &rhs) {
+                  return pred(lhs) < pred(rhs);
+                });
+
+      auto per_node_batch =
+          std::vector<internal::Subset<value_type, item_type>>(
+              data_parallel_world_size_ / num_nodes);
+      internal::Partition(items.begin(), items.end(), per_node_batch.begin(),
+                          pred, proj, per_node_batch.size(), options,
+                          stats == nullptr ? nullptr : &levels[node]);
+
+      for (size_type index = 0; index < per_node_batch.size(); ++index) {
+        batch[nodes_[node][index]] = std::move(per_node_batch[index]);
+      }
+    }
+    // clang-format on
+
+    if (stats != nullptr) {
+      *stats = *std::max_element(
+          levels.cbegin(), levels.cend(),
+          [](const auto &lhs, const auto &rhs) { return lhs.gap < rhs.gap; });
+    }
+
+    return batch;
+  }
+
+  // Scheduler::ReportForSchedule()
+  //
+  // Reports the solver and gap of partitioning each global batch into the data
+  // parallel replicas, along with a summary over all global batches.
+  void ReportForSchedule(
+      const std::vector<internal::PartitionStats> &stats) const {
+    if (stats.empty()) {
+      return;
+    }
+
+    auto sum = 0.0;
+    auto max = 0.0;
+    auto counts = std::map<std::string_view, size_type>();
+
+    for (size_type index = 0; index < stats.size(); ++index) {
+      VLOG(1) << absl::StrFormat(
+          "Global batch %u was partitioned by %s with a gap of %f", index,
+          stats[index].solver, stats[index].gap);
+      sum += stats[index].gap;
+      max = std::max(max, stats[index].gap);
+      ++counts[stats[index].solver];
+    }
+
+    auto solvers = std::string();
+    for (const auto &[solver, count] : counts) {
+      absl::StrAppendFormat(&solvers, "%s%s: %u", solvers.empty() ? "" : ", ",
+                            solver, count);
+    }
+
+    LOG(INFO) << absl::StrFormat(
+        "Partitioning gap: %f on average and %f at most (%s)",
+        sum / static_cast<double>(stats.size()), max, solvers);
+  }
+
+  // Scheduler::MemoizeForSchedule()
+  //
+  // Replaces the cache with the schedules of the global batches in this call,
+  // either found in the cache or newly made, and reports the hit rate. Only
+  // the latest call is kept, since global batches that were not scheduled
+  // again are unlikely to be scheduled later on, e.g., when the order changes
+  // every epoch.
+  void MemoizeForSchedule(
+      const std::vector<std::uint64_t> &hashes,
+      std::vector<std::optional<ScheduleEntry>> &entries) const {
+    if (hashes.empty()) {
+      return;
+    }
+
+    auto cache = absl::flat_hash_map<std::uint64_t, ScheduleEntry>();
+    cache.reserve(hashes.size());
+
+    auto num_hits = static_cast<size_type>(0);
+    for (size_type index = 0; index < hashes.size(); ++index) {
+      if (entries[index].has_value()) {
+        cache.insert_or_assign(hashes[index], *std::move(entries[index]));
+        continue;
+      }
+      ++num_hits;
+      // The same global batch may appear more than once, in which case its
+      // entry has already been moved.
+      const auto it = cache_->entries.find(hashes[index]);
+      if (it != cache_->entries.end() && !cache.contains(hashes[index])) {
+        cache.emplace(hashes[index], std::move(it->second));
+      }
+    }
+
+    cache_->entries = std::move(cache);
+    cache_->num_hits += num_hits;
+    cache_->num_lookups += hashes.size();
+
+    LOG(INFO) << absl::StrFormat(
+        "Reused %u of %u global batches from the schedule cache (hit rate: %f "
+        "in this call, %f overall)",
+        num_hits, hashes.size(),
+        static_cast<double>(num_hits) / static_cast<double>(hashes.size()),
+        static_cast<double>(cache_->num_hits) /
+            static_cast<double>(cache_->num_lookups));
+  }
+
  protected:
   size_type data_parallel_world_size_;
   size_type global_batch_size_;
@@ -340,7 +1610,23 @@ class Scheduler {
   size_type last_micro_batch_size_;
   size_type micro_batch_size_;
   size_type num_microbatches_;
+  size_type pipeline_parallel_world_size_;
+  bool pad_to_longest_;
+  bool uneven_microbatches_;
+  double max_balance_penalty_;
+  internal::PartitionOptions partition_options_;
+  bool report_partitions_;
+  std::vector<size_type> homes_;
+  std::vector<size_type> node_ids_;
+  std::vector<size_type> bucket_capacities_;
+  internal::Dictionary<size_type> sizes_;
+  std::vector<std::vector<size_type>> nodes_;
+  std::vector<std::uint64_t> offsets_;
+  // Indexed by the IDs of the distinct sizes in `sizes_`, not by samples.
+  std::vector<typename OperatorRegistry::value_type> mems_;
   std::vector<typename OperatorRegistry::value_type> preds_;
+  std::vector<bool> splits_;
+  mutable std::optional<ScheduleCache> cache_;
 };
 
 }  // namespace flatflow
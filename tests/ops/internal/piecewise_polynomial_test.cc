@@ -0,0 +1,89 @@
+// Copyright 2025 The FlatFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "flatflow/ops/internal/piecewise_polynomial.h"
+
+#include <cstdint>
+
+#include "gtest/gtest.h"
+
+#include "flatflow/ops/internal/polynomial.h"
+
+namespace {
+
+TEST(PiecewisePolynomialTest, Evaluation) {
+  const auto poly = flatflow::internal::piecewise_polynomial<int64_t>(
+      flatflow::internal::polynomial<int64_t>(0, 0, 1), 4,
+      flatflow::internal::polynomial<int64_t>(0, 4));
+  EXPECT_EQ(poly.size(), 2);
+  EXPECT_EQ(poly(0), 0);
+  EXPECT_EQ(poly(3), 9);
+  EXPECT_EQ(poly(4), 16);
+  EXPECT_EQ(poly(5), 20);
+  EXPECT_EQ(poly(8), 32);
+}
+
+TEST(PiecewisePolynomialTest, EvaluationWithoutBreakpoints) {
+  const auto poly = flatflow::internal::polynomial<int64_t>(1, 2, 3);
+  const auto piecewise =
+      flatflow::internal::piecewise_polynomial<int64_t>(poly);
+  EXPECT_EQ(piecewise.size(), 1);
+  EXPECT_EQ(piecewise(0), poly(0));
+  EXPECT_EQ(piecewise(7), poly(7));
+  EXPECT_EQ(piecewise(1024), poly(1024));
+}
+
+TEST(PiecewisePolynomialTest, Addition) {
+  const auto lhs = flatflow::internal::piecewise_polynomial<int64_t>(
+      flatflow::internal::polynomial<int64_t>(0, 0, 1), 4,
+      flatflow::internal::polynomial<int64_t>(0, 4));
+  const auto rhs = flatflow::internal::piecewise_polynomial<int64_t>(
+      flatflow::internal::polynomial<int64_t>(0, 0, 2), 2,
+      flatflow::internal::polynomial<int64_t>(0, 4));
+  const auto sum = lhs + rhs;
+  EXPECT_EQ(sum.size(), 3);
+  EXPECT_EQ(sum[1].first, 2);
+  EXPECT_EQ(sum[1].second, flatflow::internal::polynomial<int64_t>(0, 4, 1));
+  EXPECT_EQ(sum[2].first, 4);
+  EXPECT_EQ(sum[2].second, flatflow::internal::polynomial<int64_t>(0, 8));
+
+  for (int64_t value = 0; value < 16; ++value) {
+    EXPECT_EQ(sum(value), lhs(value) + rhs(value));
+  }
+}
+
+TEST(PiecewisePolynomialTest, AdditionIdentity) {
+  const auto poly = flatflow::internal::piecewise_polynomial<int64_t>(
+      flatflow::internal::polynomial<int64_t>(1, 2, 3), 4,
+      flatflow::internal::polynomial<int64_t>(1, 14));
+  const auto zero = flatflow::internal::piecewise_polynomial<int64_t>();
+  EXPECT_EQ(poly + zero, poly);
+  EXPECT_EQ(zero + poly, poly);
+}
+
+TEST(PiecewisePolynomialTest, Normalization) {
+  auto poly = flatflow::internal::piecewise_polynomial<int64_t>(
+      flatflow::internal::polynomial<int64_t>(0, 6, 2), 4,
+      flatflow::internal::polynomial<int64_t>(0, 14));
+  poly.normalize();
+  EXPECT_EQ(poly, flatflow::internal::piecewise_polynomial<int64_t>(
+                      flatflow::internal::polynomial<int64_t>(0, 3, 1), 4,
+                      flatflow::internal::polynomial<int64_t>(0, 7)));
+
+  auto zero = flatflow::internal::piecewise_polynomial<int64_t>();
+  zero.normalize();
+  EXPECT_EQ(zero, flatflow::internal::piecewise_polynomial<int64_t>());
+}
+
+}  // namespace
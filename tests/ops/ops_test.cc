@@ -39,6 +39,13 @@ std::vector<flatflow::SymInt> CreateVectorOfSymInts(Args... args) {
   return std::vector<flatflow::SymInt>{args...};
 }
 
+template <typename... Args>
+flatbuffers::Offset<flatflow::TensorMetadata> CreateTensorMetadata(
+    flatbuffers::FlatBufferBuilder &builder, Args... args) {
+  return flatflow::CreateTensorMetadata(
+      builder, builder.CreateVectorOfStructs(CreateVectorOfSymInts(args...)));
+}
+
 class SymbolicTraceTest : public testing::Test {
  protected:
   void SetUp() override {
@@ -1716,4 +1723,386 @@ TEST_F(SymbolicTraceTest, Llama3) {
   EXPECT_EQ(trace(2048), 2788628635648);
 }
 
+// This test checks whether activation tracing counts the output elements of
+// every node except for views, which alias their inputs.
+TEST_F(SymbolicTraceTest, Activations) {
+  auto builder = flatbuffers::FlatBufferBuilder();
+
+  auto target = flatflow::Operator::MM;
+  auto sym_int0 = CreateSymInt(0, 1);
+  auto sym_int1 = CreateSymInt(4096, 0);
+  auto shape =
+      builder.CreateVectorOfStructs(CreateVectorOfSymInts(sym_int0, sym_int1));
+  auto arg0 = flatflow::CreateTensorMetadata(builder, shape);
+  sym_int0 = CreateSymInt(4096, 0);
+  sym_int1 = CreateSymInt(14336, 0);
+  shape =
+      builder.CreateVectorOfStructs(CreateVectorOfSymInts(sym_int0, sym_int1));
+  auto arg1 = flatflow::CreateTensorMetadata(builder, shape);
+  auto args = builder.CreateVector({arg0, arg1});
+  sym_int0 = CreateSymInt(0, 1);
+  sym_int1 = CreateSymInt(14336, 0);
+  shape =
+      builder.CreateVectorOfStructs(CreateVectorOfSymInts(sym_int0, sym_int1));
+  auto meta = flatflow::CreateTensorMetadata(builder, shape);
+  auto node0 = flatflow::CreateNode(builder, target, args, meta);
+
+  target = flatflow::Operator::VIEW;
+  sym_int0 = CreateSymInt(0, 1);
+  sym_int1 = CreateSymInt(14336, 0);
+  shape =
+      builder.CreateVectorOfStructs(CreateVectorOfSymInts(sym_int0, sym_int1));
+  arg0 = flatflow::CreateTensorMetadata(builder, shape);
+  args = builder.CreateVector({arg0});
+  sym_int0 = CreateSymInt(1, 0);
+  sym_int1 = CreateSymInt(0, 1);
+  auto sym_int2 = CreateSymInt(14336, 0);
+  shape = builder.CreateVectorOfStructs(
+      CreateVectorOfSymInts(sym_int0, sym_int1, sym_int2));
+  meta = flatflow::CreateTensorMetadata(builder, shape);
+  auto node1 = flatflow::CreateNode(builder, target, args, meta);
+
+  target = flatflow::Operator::SILU;
+  sym_int0 = CreateSymInt(1, 0);
+  sym_int1 = CreateSymInt(0, 1);
+  sym_int2 = CreateSymInt(14336, 0);
+  shape = builder.CreateVectorOfStructs(
+      CreateVectorOfSymInts(sym_int0, sym_int1, sym_int2));
+  arg0 = flatflow::CreateTensorMetadata(builder, shape);
+  args = builder.CreateVector({arg0});
+  meta = flatflow::CreateTensorMetadata(builder, shape);
+  auto node2 = flatflow::CreateNode(builder, target, args, meta);
+
+  auto nodes = builder.CreateVector({node0, node1, node2});
+  auto root = flatflow::CreateGraph(builder, nodes);
+  builder.Finish(root);
+
+  auto graph =
+      flatbuffers::GetRoot<flatflow::Graph>(builder.GetBufferPointer());
+  const auto trace = flatflow::symbolic_trace_activations(graph);  // 28672 s0
+
+  EXPECT_EQ(trace(0), 0);
+  EXPECT_EQ(trace(1), 28672);
+  EXPECT_EQ(trace(1024), 29360128);
+}
+
+// This test checks whether symbolic tracing takes breakpoints into account,
+// emulating sliding window attention with a window size of 4096; the attention
+// scores are quadratic up to the window size and linear after it.
+TEST_F(SymbolicTraceTest, Breakpoint) {
+  auto builder = flatbuffers::FlatBufferBuilder();
+
+  auto target = flatflow::Operator::MM;
+  auto sym_int0 = CreateSymInt(0, 1);
+  auto sym_int1 = CreateSymInt(4096, 0);
+  auto shape =
+      builder.CreateVectorOfStructs(CreateVectorOfSymInts(sym_int0, sym_int1));
+  auto arg0 = flatflow::CreateTensorMetadata(builder, shape);
+  sym_int0 = CreateSymInt(4096, 0);
+  sym_int1 = CreateSymInt(4096, 0);
+  shape =
+      builder.CreateVectorOfStructs(CreateVectorOfSymInts(sym_int0, sym_int1));
+  auto arg1 = flatflow::CreateTensorMetadata(builder, shape);
+  auto args = builder.CreateVector({arg0, arg1});
+  sym_int0 = CreateSymInt(0, 1);
+  sym_int1 = CreateSymInt(4096, 0);
+  shape =
+      builder.CreateVectorOfStructs(CreateVectorOfSymInts(sym_int0, sym_int1));
+  auto meta = flatflow::CreateTensorMetadata(builder, shape);
+  auto node0 = flatflow::CreateNode(builder, target, args, meta);
+
+  target = flatflow::Operator::BMM;
+  sym_int0 = CreateSymInt(32, 0);
+  sym_int1 = CreateSymInt(0, 1);
+  auto sym_int2 = CreateSymInt(128, 0);
+  shape = builder.CreateVectorOfStructs(
+      CreateVectorOfSymInts(sym_int0, sym_int1, sym_int2));
+  arg0 = flatflow::CreateTensorMetadata(builder, shape);
+  sym_int0 = CreateSymInt(32, 0);
+  sym_int1 = CreateSymInt(128, 0);
+  sym_int2 = CreateSymInt(0, 1);
+  shape = builder.CreateVectorOfStructs(
+      CreateVectorOfSymInts(sym_int0, sym_int1, sym_int2));
+  arg1 = flatflow::CreateTensorMetadata(builder, shape);
+  args = builder.CreateVector({arg0, arg1});
+  sym_int0 = CreateSymInt(32, 0);
+  sym_int1 = CreateSymInt(0, 1);
+  sym_int2 = CreateSymInt(0, 1);
+  shape = builder.CreateVectorOfStructs(
+      CreateVectorOfSymInts(sym_int0, sym_int1, sym_int2));
+  meta = flatflow::CreateTensorMetadata(builder, shape);
+  auto node1 = flatflow::CreateNode(builder, target, args, meta, 4096);
+
+  auto nodes = builder.CreateVector({node0, node1});
+  auto root = flatflow::CreateGraph(builder, nodes);
+  builder.Finish(root);
+
+  auto graph =
+      flatbuffers::GetRoot<flatflow::Graph>(builder.GetBufferPointer());
+  const auto trace = flatflow::symbolic_trace(
+      graph);  // s0^2 + 4096 s0 if s0 < 4096 else 8192 s0
+
+  EXPECT_EQ(trace(0), 0);
+  EXPECT_EQ(trace(1024), 5242880);
+  EXPECT_EQ(trace(4096), 33554432);
+  EXPECT_EQ(trace(8192), 67108864);
+}
+
+// This test checks whether fused attention costs the same as its decomposition
+// into `bmm`, `_softmax` and `bmm`, so that the quadratic term is kept whether
+// or not the model runs FlashAttention; the attention bias of memory-efficient
+// attention takes one more FLOP for each score.
+TEST_F(SymbolicTraceTest, Attention) {
+  auto builder = flatbuffers::FlatBufferBuilder();
+
+  // Query, key and value of 32 heads of dimension 128.
+  auto qkv = CreateTensorMetadata(builder, CreateSymInt(1, 0),
+                                  CreateSymInt(32, 0), CreateSymInt(0, 1),
+                                  CreateSymInt(128, 0));
+  auto scores = CreateTensorMetadata(builder, CreateSymInt(1, 0),
+                                     CreateSymInt(32, 0), CreateSymInt(0, 1),
+                                     CreateSymInt(0, 1));
+  auto args = builder.CreateVector({qkv, qkv, qkv});
+  auto node0 = flatflow::CreateNode(
+      builder, flatflow::Operator::_SCALED_DOT_PRODUCT_FLASH_ATTENTION, args,
+      qkv);
+
+  args = builder.CreateVector({qkv, qkv, qkv, scores});
+  auto node1 = flatflow::CreateNode(
+      builder, flatflow::Operator::_SCALED_DOT_PRODUCT_EFFICIENT_ATTENTION,
+      args, qkv);
+
+  auto lhs = CreateTensorMetadata(builder, CreateSymInt(32, 0),
+                                  CreateSymInt(0, 1), CreateSymInt(128, 0));
+  auto rhs = CreateTensorMetadata(builder, CreateSymInt(32, 0),
+                                  CreateSymInt(128, 0), CreateSymInt(0, 1));
+  auto meta = CreateTensorMetadata(builder, CreateSymInt(32, 0),
+                                   CreateSymInt(0, 1), CreateSymInt(0, 1));
+  args = builder.CreateVector({lhs, rhs});
+  auto node2 =
+      flatflow::CreateNode(builder, flatflow::Operator::BMM, args, meta);
+
+  args = builder.CreateVector({scores});
+  auto node3 =
+      flatflow::CreateNode(builder, flatflow::Operator::_SOFTMAX, args, scores);
+
+  lhs = CreateTensorMetadata(builder, CreateSymInt(32, 0), CreateSymInt(0, 1),
+                             CreateSymInt(0, 1));
+  rhs = CreateTensorMetadata(builder, CreateSymInt(32, 0), CreateSymInt(0, 1),
+                             CreateSymInt(128, 0));
+  meta = CreateTensorMetadata(builder, CreateSymInt(32, 0), CreateSymInt(0, 1),
+                              CreateSymInt(128, 0));
+  args = builder.CreateVector({lhs, rhs});
+  auto node4 =
+      flatflow::CreateNode(builder, flatflow::Operator::BMM, args, meta);
+
+  auto nodes = builder.CreateVector({node0, node1, node2, node3, node4});
+  auto root = flatflow::CreateGraph(builder, nodes);
+  builder.Finish(root);
+
+  auto graph =
+      flatbuffers::GetRoot<flatflow::Graph>(builder.GetBufferPointer());
+  const auto registry = flatflow::OperatorRegistry();
+  const auto cost = [&](flatbuffers::uoffset_t index, int64_t size) {
+    return registry.dispatch(graph->nodes()->Get(index))(size);
+  };
+
+  // 32 x (2 x 128 + 2 x 128 + 5) = 16544 s0^2
+  EXPECT_EQ(cost(0, 1024), int64_t{16544} * 1024 * 1024);
+  EXPECT_EQ(cost(1, 1024), int64_t{16576} * 1024 * 1024);
+  EXPECT_EQ(cost(2, 1024) + cost(3, 1024) + cost(4, 1024), cost(0, 1024));
+}
+
+// This test checks whether layer normalization and log-softmax are costed per
+// element, taking the affine transformation of the former into account.
+TEST_F(SymbolicTraceTest, Normalization) {
+  auto builder = flatbuffers::FlatBufferBuilder();
+
+  auto input = CreateTensorMetadata(builder, CreateSymInt(1, 0),
+                                    CreateSymInt(0, 1), CreateSymInt(4096, 0));
+  auto weight = CreateTensorMetadata(builder, CreateSymInt(4096, 0));
+  auto args = builder.CreateVector({input, weight, weight});
+  auto node0 = flatflow::CreateNode(
+      builder, flatflow::Operator::NATIVE_LAYER_NORM, args, input);
+
+  args = builder.CreateVector({input});
+  auto node1 = flatflow::CreateNode(
+      builder, flatflow::Operator::NATIVE_LAYER_NORM, args, input);
+
+  auto logits = CreateTensorMetadata(builder, CreateSymInt(0, 1),
+                                     CreateSymInt(128256, 0));
+  args = builder.CreateVector({logits});
+  auto node2 = flatflow::CreateNode(builder, flatflow::Operator::_LOG_SOFTMAX,
+                                    args, logits);
+
+  auto nodes = builder.CreateVector({node0, node1, node2});
+  auto root = flatflow::CreateGraph(builder, nodes);
+  builder.Finish(root);
+
+  auto graph =
+      flatbuffers::GetRoot<flatflow::Graph>(builder.GetBufferPointer());
+  const auto registry = flatflow::OperatorRegistry();
+  const auto cost = [&](flatbuffers::uoffset_t index, int64_t size) {
+    return registry.dispatch(graph->nodes()->Get(index))(size);
+  };
+
+  EXPECT_EQ(cost(0, 1024), 8 * 4096 * 1024);
+  EXPECT_EQ(cost(1, 1024), 6 * 4096 * 1024);
+  EXPECT_EQ(cost(2, 1024), 5 * 128256 * 1024);
+}
+
+// This test checks whether `addmm` and `baddbmm` cost their products plus one
+// addition for each output element.
+TEST_F(SymbolicTraceTest, Addmm) {
+  auto builder = flatbuffers::FlatBufferBuilder();
+
+  auto bias = CreateTensorMetadata(builder, CreateSymInt(11008, 0));
+  auto mat1 = CreateTensorMetadata(builder, CreateSymInt(0, 1),
+                                   CreateSymInt(4096, 0));
+  auto mat2 = CreateTensorMetadata(builder, CreateSymInt(4096, 0),
+                                   CreateSymInt(11008, 0));
+  auto meta = CreateTensorMetadata(builder, CreateSymInt(0, 1),
+                                   CreateSymInt(11008, 0));
+  auto args = builder.CreateVector({bias, mat1, mat2});
+  auto node0 =
+      flatflow::CreateNode(builder, flatflow::Operator::ADDMM, args, meta);
+
+  auto alibi = CreateTensorMetadata(builder, CreateSymInt(32, 0),
+                                    CreateSymInt(0, 1), CreateSymInt(0, 1));
+  auto batch1 = CreateTensorMetadata(builder, CreateSymInt(32, 0),
+                                     CreateSymInt(0, 1), CreateSymInt(128, 0));
+  auto batch2 = CreateTensorMetadata(builder, CreateSymInt(32, 0),
+                                     CreateSymInt(128, 0), CreateSymInt(0, 1));
+  args = builder.CreateVector({alibi, batch1, batch2});
+  auto node1 =
+      flatflow::CreateNode(builder, flatflow::Operator::BADDBMM, args, alibi);
+
+  auto nodes = builder.CreateVector({node0, node1});
+  auto root = flatflow::CreateGraph(builder, nodes);
+  builder.Finish(root);
+
+  auto graph =
+      flatbuffers::GetRoot<flatflow::Graph>(builder.GetBufferPointer());
+  const auto registry = flatflow::OperatorRegistry();
+  const auto cost = [&](flatbuffers::uoffset_t index, int64_t size) {
+    return registry.dispatch(graph->nodes()->Get(index))(size);
+  };
+
+  EXPECT_EQ(cost(0, 1024), int64_t{11008} * (2 * 4096 + 1) * 1024);
+  EXPECT_EQ(cost(1, 1024), int64_t{32} * (2 * 128 + 1) * 1024 * 1024);
+}
+
+// This test checks whether `gelu` is costed per element, whereas selections
+// and gathers such as `where.self`, `masked_fill` and `index_select` have zero
+// FLOPs, and whether the elementwise ones are fusible.
+TEST_F(SymbolicTraceTest, Elementwise) {
+  auto builder = flatbuffers::FlatBufferBuilder();
+
+  auto hidden = CreateTensorMetadata(builder, CreateSymInt(1, 0),
+                                     CreateSymInt(0, 1), CreateSymInt(4096, 0));
+  auto args = builder.CreateVector({hidden});
+  auto node0 =
+      flatflow::CreateNode(builder, flatflow::Operator::GELU, args, hidden);
+
+  auto mask = CreateTensorMetadata(builder, CreateSymInt(1, 0),
+                                   CreateSymInt(1, 0), CreateSymInt(0, 1),
+                                   CreateSymInt(0, 1));
+  args = builder.CreateVector({mask, mask, mask});
+  auto node1 = flatflow::CreateNode(builder, flatflow::Operator::WHERE_SELF,
+                                    args, mask);
+
+  args = builder.CreateVector({mask, mask});
+  auto node2 = flatflow::CreateNode(
+      builder, flatflow::Operator::MASKED_FILL_SCALAR, args, mask);
+
+  auto weight = CreateTensorMetadata(builder, CreateSymInt(128256, 0),
+                                     CreateSymInt(4096, 0));
+  auto index = CreateTensorMetadata(builder, CreateSymInt(0, 1));
+  auto meta = CreateTensorMetadata(builder, CreateSymInt(0, 1),
+                                   CreateSymInt(4096, 0));
+  args = builder.CreateVector({weight, index});
+  auto node3 = flatflow::CreateNode(builder, flatflow::Operator::INDEX_SELECT,
+                                    args, meta);
+
+  auto nodes = builder.CreateVector({node0, node1, node2, node3});
+  auto root = flatflow::CreateGraph(builder, nodes);
+  builder.Finish(root);
+
+  auto graph =
+      flatbuffers::GetRoot<flatflow::Graph>(builder.GetBufferPointer());
+  const auto registry = flatflow::OperatorRegistry();
+  const auto cost = [&](flatbuffers::uoffset_t index, int64_t size) {
+    return registry.dispatch(graph->nodes()->Get(index))(size);
+  };
+
+  EXPECT_EQ(cost(0, 1024), 8 * 4096 * 1024);
+  EXPECT_EQ(cost(1, 1024), 0);
+  EXPECT_EQ(cost(2, 1024), 0);
+  EXPECT_EQ(cost(3, 1024), 0);
+
+  EXPECT_TRUE(flatflow::is_elementwise(flatflow::Operator::GELU));
+  EXPECT_TRUE(flatflow::is_elementwise(flatflow::Operator::WHERE_SELF));
+  EXPECT_TRUE(flatflow::is_elementwise(flatflow::Operator::MASKED_FILL_SCALAR));
+  EXPECT_FALSE(flatflow::is_elementwise(flatflow::Operator::INDEX_SELECT));
+}
+
+// This test checks whether operators outside the operator set are costed per
+// element of their largest tensor, which is the output for elementwise ones
+// and the input for reductions, and whether deregistered operators fall back
+// likewise.
+TEST_F(SymbolicTraceTest, Unknown) {
+  auto builder = flatbuffers::FlatBufferBuilder();
+
+  auto hidden = CreateTensorMetadata(builder, CreateSymInt(1, 0),
+                                     CreateSymInt(0, 1), CreateSymInt(4096, 0));
+  auto weight = CreateTensorMetadata(builder, CreateSymInt(4096, 0));
+  auto args = builder.CreateVector({hidden, weight});
+  auto node0 =
+      flatflow::CreateNode(builder, flatflow::Operator::UNKNOWN, args, hidden);
+
+  auto scores = CreateTensorMetadata(builder, CreateSymInt(1, 0),
+                                     CreateSymInt(32, 0), CreateSymInt(0, 1),
+                                     CreateSymInt(0, 1));
+  auto meta = CreateTensorMetadata(builder, CreateSymInt(1, 0),
+                                   CreateSymInt(32, 0), CreateSymInt(0, 1),
+                                   CreateSymInt(1, 0));
+  args = builder.CreateVector({scores});
+  auto node1 =
+      flatflow::CreateNode(builder, flatflow::Operator::UNKNOWN, args, meta);
+
+  args = builder.CreateVector({hidden});
+  auto node2 =
+      flatflow::CreateNode(builder, flatflow::Operator::GELU, args, hidden);
+
+  auto nodes = builder.CreateVector({node0, node1, node2});
+  auto root = flatflow::CreateGraph(builder, nodes);
+  builder.Finish(root);
+
+  auto graph =
+      flatbuffers::GetRoot<flatflow::Graph>(builder.GetBufferPointer());
+  auto registry = flatflow::OperatorRegistry();
+  const auto cost = [&](flatbuffers::uoffset_t index, int64_t size) {
+    return registry.dispatch(graph->nodes()->Get(index))(size);
+  };
+
+  EXPECT_EQ(cost(0, 1024), 4096 * 1024);
+  EXPECT_EQ(cost(1, 1024), 32 * 1024 * 1024);
+  EXPECT_EQ(cost(2, 1024), 8 * 4096 * 1024);
+
+  registry.deregisterOperator(flatflow::Operator::GELU);
+  EXPECT_EQ(cost(2, 1024), 4096 * 1024);
+}
+
+// This test checks whether module paths are mapped to the layers they belong
+// to, where modules outside the repeated layers are layers of their own.
+TEST(LayerOfTest, ModulePaths) {
+  EXPECT_EQ(flatflow::layer_of("model.layers.0.mlp.down_proj"),
+            "model.layers.0");
+  EXPECT_EQ(flatflow::layer_of("model.layers.31"), "model.layers.31");
+  EXPECT_EQ(flatflow::layer_of("transformer.h.7.attn"), "transformer.h.7");
+  EXPECT_EQ(flatflow::layer_of("model.embed_tokens"), "model.embed_tokens");
+  EXPECT_EQ(flatflow::layer_of("lm_head"), "lm_head");
+  EXPECT_EQ(flatflow::layer_of(""), "");
+}
+
 }  // namespace
@@ -0,0 +1,51 @@
+# Copyright 2025 The FlatFlow Authors
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+import unittest
+
+import sympy
+
+from flatflow.ops.ops import to_coeffs, to_sym_int
+
+
+class ToSymIntTest(unittest.TestCase):
+    def setUp(self) -> None:
+        self.s0, self.s1 = sympy.symbols("s0 s1", integer=True, positive=True)
+
+    def test_static(self) -> None:
+        self.assertEqual(to_sym_int(4096), ([4096, 0], 0))
+
+    def test_linear(self) -> None:
+        self.assertEqual(to_coeffs(self.s0), ([0, 1], 0))
+        self.assertEqual(to_coeffs(2 * self.s0 + 1), ([1, 2], 0))
+
+    def test_min(self) -> None:
+        self.assertEqual(to_coeffs(sympy.Min(self.s0, 4096)), ([0, 1], 4096))
+        self.assertEqual(to_coeffs(sympy.Min(2 * self.s0, 4096)), ([0, 2], 2048))
+
+    # Multiples of clamped sizes, such as the keys and values of sliding window
+    # attention concatenated, are scaled along with the size itself.
+    def test_scaled_min(self) -> None:
+        self.assertEqual(to_coeffs(2 * sympy.Min(self.s0, 4096)), ([0, 2], 4096))
+        self.assertEqual(
+            to_coeffs(3 * sympy.Min(2 * self.s0 + 3, 4096)), ([9, 6], 2047)
+        )
+
+    def test_symbolic_min(self) -> None:
+        with self.assertRaisesRegex(NotImplementedError, "clamped to a constant"):
+            to_coeffs(sympy.Min(self.s0, self.s1))
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,355 @@
+// Copyright 2025 The FlatFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "flatflow/ops/passes.h"
+
+#include <string>
+#include <vector>
+
+#include "absl/base/log_severity.h"
+#include "absl/log/globals.h"
+#include "absl/log/initialize.h"
+#include "absl/log/internal/globals.h"
+#include "absl/log/log.h"
+#include "flatbuffers/flatbuffers.h"
+#include "gtest/gtest.h"
+
+#include "flatflow/ops/graph_generated.h"
+#include "flatflow/ops/node_generated.h"
+#include "flatflow/ops/operator_generated.h"
+#include "flatflow/ops/ops.h"
+
+namespace {
+
+flatflow::SymInt CreateSymInt(int64_t x, int64_t y) {
+  return flatflow::SymInt(flatbuffers::make_span({x, y}));
+}
+
+template <typename... Args>
+std::vector<flatflow::SymInt> CreateVectorOfSymInts(Args... args) {
+  return std::vector<flatflow::SymInt>{args...};
+}
+
+// CreateProjection()
+//
+// Creates a node projecting a matrix of shape [`s0`, 4096] by a weight matrix
+// of shape [4096, 4096], called from the module at `module_path`.
+flatbuffers::Offset<flatflow::Node> CreateProjection(
+    flatbuffers::FlatBufferBuilder &builder, const std::string &module_path) {
+  auto shape = builder.CreateVectorOfStructs(
+      CreateVectorOfSymInts(CreateSymInt(0, 1), CreateSymInt(4096, 0)));
+  auto arg0 = flatflow::CreateTensorMetadata(builder, shape);
+  shape = builder.CreateVectorOfStructs(
+      CreateVectorOfSymInts(CreateSymInt(4096, 0), CreateSymInt(4096, 0)));
+  auto arg1 = flatflow::CreateTensorMetadata(builder, shape);
+  auto args = builder.CreateVector({arg0, arg1});
+  shape = builder.CreateVectorOfStructs(
+      CreateVectorOfSymInts(CreateSymInt(0, 1), CreateSymInt(4096, 0)));
+  auto meta = flatflow::CreateTensorMetadata(builder, shape);
+  return flatflow::CreateNode(builder, flatflow::Operator::MM, args, meta, 0,
+                              builder.CreateString(module_path));
+}
+
+// CreateBiasedProjection()
+//
+// Creates a node projecting a matrix of shape [`s0`, 768] by a weight matrix
+// of shape [768, 768] plus a bias of shape [768], called from the module at
+// `module_path`.
+flatbuffers::Offset<flatflow::Node> CreateBiasedProjection(
+    flatbuffers::FlatBufferBuilder &builder, const std::string &module_path) {
+  auto shape = builder.CreateVectorOfStructs(
+      CreateVectorOfSymInts(CreateSymInt(768, 0)));
+  auto arg0 = flatflow::CreateTensorMetadata(builder, shape);
+  shape = builder.CreateVectorOfStructs(
+      CreateVectorOfSymInts(CreateSymInt(0, 1), CreateSymInt(768, 0)));
+  auto arg1 = flatflow::CreateTensorMetadata(builder, shape);
+  shape = builder.CreateVectorOfStructs(
+      CreateVectorOfSymInts(CreateSymInt(768, 0), CreateSymInt(768, 0)));
+  auto arg2 = flatflow::CreateTensorMetadata(builder, shape);
+  auto args = builder.CreateVector({arg0, arg1, arg2});
+  shape = builder.CreateVectorOfStructs(
+      CreateVectorOfSymInts(CreateSymInt(0, 1), CreateSymInt(768, 0)));
+  auto meta = flatflow::CreateTensorMetadata(builder, shape);
+  return flatflow::CreateNode(builder, flatflow::Operator::ADDMM, args, meta,
+                              0, builder.CreateString(module_path));
+}
+
+class PassesTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    if (!absl::log_internal::IsInitialized()) {
+      absl::InitializeLog();
+      absl::SetStderrThreshold(absl::LogSeverity::kInfo);
+    }
+  }
+};
+
+// This test checks whether graph passes transform the feed-forward gate of
+// Llama 3 as the compiler would; the view is dropped, the copy is merged into
+// its producer, and `mul.Tensor`, `add.Tensor` and `silu` are fused into
+// a single node that neither writes nor reads the intermediate results.
+TEST_F(PassesTest, FuseElementwise) {
+  auto builder = flatbuffers::FlatBufferBuilder();
+
+  auto target = flatflow::Operator::MM;
+  auto sym_int0 = CreateSymInt(0, 1);
+  auto sym_int1 = CreateSymInt(4096, 0);
+  auto shape =
+      builder.CreateVectorOfStructs(CreateVectorOfSymInts(sym_int0, sym_int1));
+  auto arg0 = flatflow::CreateTensorMetadata(builder, shape);
+  sym_int0 = CreateSymInt(4096, 0);
+  sym_int1 = CreateSymInt(14336, 0);
+  shape =
+      builder.CreateVectorOfStructs(CreateVectorOfSymInts(sym_int0, sym_int1));
+  auto arg1 = flatflow::CreateTensorMetadata(builder, shape);
+  auto args = builder.CreateVector({arg0, arg1});
+  sym_int0 = CreateSymInt(0, 1);
+  sym_int1 = CreateSymInt(14336, 0);
+  shape =
+      builder.CreateVectorOfStructs(CreateVectorOfSymInts(sym_int0, sym_int1));
+  auto meta = flatflow::CreateTensorMetadata(builder, shape);
+  auto node0 = flatflow::CreateNode(builder, target, args, meta);
+
+  target = flatflow::Operator::VIEW;
+  sym_int0 = CreateSymInt(0, 1);
+  sym_int1 = CreateSymInt(14336, 0);
+  shape =
+      builder.CreateVectorOfStructs(CreateVectorOfSymInts(sym_int0, sym_int1));
+  arg0 = flatflow::CreateTensorMetadata(builder, shape);
+  args = builder.CreateVector({arg0});
+  sym_int0 = CreateSymInt(1, 0);
+  sym_int1 = CreateSymInt(0, 1);
+  auto sym_int2 = CreateSymInt(14336, 0);
+  shape = builder.CreateVectorOfStructs(
+      CreateVectorOfSymInts(sym_int0, sym_int1, sym_int2));
+  meta = flatflow::CreateTensorMetadata(builder, shape);
+  auto node1 = flatflow::CreateNode(builder, target, args, meta);
+
+  target = flatflow::Operator::MUL_TENSOR;
+  arg0 = flatflow::CreateTensorMetadata(builder, shape);
+  arg1 = flatflow::CreateTensorMetadata(builder, shape);
+  args = builder.CreateVector({arg0, arg1});
+  meta = flatflow::CreateTensorMetadata(builder, shape);
+  auto node2 = flatflow::CreateNode(builder, target, args, meta);
+
+  target = flatflow::Operator::ADD_TENSOR;
+  arg0 = flatflow::CreateTensorMetadata(builder, shape);
+  arg1 = flatflow::CreateTensorMetadata(builder, shape);
+  args = builder.CreateVector({arg0, arg1});
+  meta = flatflow::CreateTensorMetadata(builder, shape);
+  auto node3 = flatflow::CreateNode(builder, target, args, meta);
+
+  target = flatflow::Operator::SILU;
+  arg0 = flatflow::CreateTensorMetadata(builder, shape);
+  args = builder.CreateVector({arg0});
+  meta = flatflow::CreateTensorMetadata(builder, shape);
+  auto node4 = flatflow::CreateNode(builder, target, args, meta);
+
+  target = flatflow::Operator::_TO_COPY;
+  arg0 = flatflow::CreateTensorMetadata(builder, shape);
+  args = builder.CreateVector({arg0});
+  meta = flatflow::CreateTensorMetadata(builder, shape);
+  auto node5 = flatflow::CreateNode(builder, target, args, meta);
+
+  auto nodes =
+      builder.CreateVector({node0, node1, node2, node3, node4, node5});
+  auto root = flatflow::CreateGraph(builder, nodes);
+  builder.Finish(root);
+
+  auto graph =
+      flatbuffers::GetRoot<flatflow::Graph>(builder.GetBufferPointer());
+
+  auto cost_graph = flatflow::CostGraph(graph);
+  EXPECT_EQ(cost_graph.size(), static_cast<size_t>(6));
+
+  // Each node is costed on its own upon lowering, where the view moves no
+  // memory.
+  EXPECT_EQ(cost_graph[0].traffic(1), 4096 + 58720256 + 14336);
+  EXPECT_EQ(cost_graph[1].traffic(1), 0);
+  EXPECT_EQ(cost_graph[2].traffic(1), 43008);
+  EXPECT_EQ(cost_graph[3].traffic(1), 43008);
+  EXPECT_EQ(cost_graph[4].traffic(1), 28672);
+  EXPECT_EQ(cost_graph[5].traffic(1), 28672);
+
+  flatflow::eliminate_views(cost_graph);
+  ASSERT_EQ(cost_graph.size(), static_cast<size_t>(4));
+  EXPECT_EQ(cost_graph[3].targets,
+            std::vector<flatflow::Operator>(
+                {flatflow::Operator::SILU, flatflow::Operator::_TO_COPY}));
+  EXPECT_EQ(cost_graph[3].traffic(1), 28672);
+
+  flatflow::fuse_elementwise(cost_graph);
+  ASSERT_EQ(cost_graph.size(), static_cast<size_t>(2));
+  EXPECT_EQ(cost_graph[0].targets,
+            std::vector<flatflow::Operator>({flatflow::Operator::MM}));
+  EXPECT_EQ(cost_graph[1].targets,
+            std::vector<flatflow::Operator>(
+                {flatflow::Operator::MUL_TENSOR, flatflow::Operator::ADD_TENSOR,
+                 flatflow::Operator::SILU, flatflow::Operator::_TO_COPY}));
+
+  // The fused node reads three inputs and writes one output.
+  EXPECT_EQ(cost_graph[1].args.size(), static_cast<size_t>(3));
+  EXPECT_EQ(cost_graph[1].traffic(1), 57344);
+  EXPECT_EQ(cost_graph[1].traffic(1024), 58720256);
+
+  // Fusion saves memory traffic but not FLOPs.
+  const auto trace = flatflow::symbolic_trace(graph);
+  const auto fused_trace =
+      flatflow::symbolic_trace(graph, flatflow::default_passes(), 0);
+  EXPECT_EQ(fused_trace(1), trace(1));
+  EXPECT_EQ(fused_trace(1024), trace(1024));
+}
+
+// This test checks whether graph passes follow the edges of the graph rather
+// than shapes; the output of the first `mul.Tensor` is read by both `silu` and
+// the second `mul.Tensor` through a view, so it has to be written and stays
+// unfused, while `silu` is fused into its sole consumer.
+TEST_F(PassesTest, FanOut) {
+  auto builder = flatbuffers::FlatBufferBuilder();
+
+  auto shape = builder.CreateVectorOfStructs(
+      CreateVectorOfSymInts(CreateSymInt(0, 1), CreateSymInt(14336, 0)));
+
+  auto arg0 = flatflow::CreateTensorMetadata(builder, shape);
+  auto arg1 = flatflow::CreateTensorMetadata(builder, shape);
+  auto args = builder.CreateVector({arg0, arg1});
+  auto meta = flatflow::CreateTensorMetadata(builder, shape);
+  auto producers = builder.CreateVector<int64_t>({-1, -1});
+  auto node0 = flatflow::CreateNode(builder, flatflow::Operator::MUL_TENSOR,
+                                    args, meta, 0, 0, producers);
+
+  arg0 = flatflow::CreateTensorMetadata(builder, shape);
+  args = builder.CreateVector({arg0});
+  meta = flatflow::CreateTensorMetadata(builder, shape);
+  producers = builder.CreateVector<int64_t>({0});
+  auto node1 = flatflow::CreateNode(builder, flatflow::Operator::VIEW, args,
+                                    meta, 0, 0, producers);
+
+  arg0 = flatflow::CreateTensorMetadata(builder, shape);
+  args = builder.CreateVector({arg0});
+  meta = flatflow::CreateTensorMetadata(builder, shape);
+  producers = builder.CreateVector<int64_t>({1});
+  auto node2 = flatflow::CreateNode(builder, flatflow::Operator::SILU, args,
+                                    meta, 0, 0, producers);
+
+  arg0 = flatflow::CreateTensorMetadata(builder, shape);
+  arg1 = flatflow::CreateTensorMetadata(builder, shape);
+  args = builder.CreateVector({arg0, arg1});
+  meta = flatflow::CreateTensorMetadata(builder, shape);
+  producers = builder.CreateVector<int64_t>({1, 2});
+  auto node3 = flatflow::CreateNode(builder, flatflow::Operator::MUL_TENSOR,
+                                    args, meta, 0, 0, producers);
+
+  auto nodes = builder.CreateVector({node0, node1, node2, node3});
+  auto root = flatflow::CreateGraph(builder, nodes);
+  builder.Finish(root);
+
+  auto graph =
+      flatbuffers::GetRoot<flatflow::Graph>(builder.GetBufferPointer());
+
+  auto cost_graph = flatflow::CostGraph(graph);
+  flatflow::default_passes().run(cost_graph);
+  ASSERT_EQ(cost_graph.size(), static_cast<size_t>(2));
+  EXPECT_EQ(cost_graph[0].targets,
+            std::vector<flatflow::Operator>({flatflow::Operator::MUL_TENSOR}));
+  EXPECT_EQ(cost_graph[0].traffic(1), 43008);
+  EXPECT_EQ(cost_graph[1].targets,
+            std::vector<flatflow::Operator>({flatflow::Operator::SILU,
+                                             flatflow::Operator::MUL_TENSOR}));
+
+  // The fused node reads the output of the first node twice, once for each
+  // operator, and writes one output.
+  EXPECT_EQ(cost_graph[1].producers, std::vector<int64_t>({0, 0}));
+  EXPECT_EQ(cost_graph[1].traffic(1), 43008);
+
+  const auto trace = flatflow::symbolic_trace(graph);
+  const auto fused_trace =
+      flatflow::symbolic_trace(graph, flatflow::default_passes(), 0);
+  EXPECT_EQ(fused_trace(1), trace(1));
+  EXPECT_EQ(fused_trace(1024), trace(1024));
+}
+
+// This test checks whether only the outputs of row-parallel projections are
+// all-reduced across the tensor parallel group, and whether the all-reduces
+// are charged at the given rate on top of FLOPs.
+TEST_F(PassesTest, Communication) {
+  auto builder = flatbuffers::FlatBufferBuilder();
+
+  auto node0 = CreateProjection(builder, "model.layers.0.self_attn.q_proj");
+
+  // The attention scores of 32 heads of dimension 128 need no communication,
+  // as each rank computes those of its own heads.
+  auto shape = builder.CreateVectorOfStructs(CreateVectorOfSymInts(
+      CreateSymInt(32, 0), CreateSymInt(0, 1), CreateSymInt(128, 0)));
+  auto arg0 = flatflow::CreateTensorMetadata(builder, shape);
+  shape = builder.CreateVectorOfStructs(CreateVectorOfSymInts(
+      CreateSymInt(32, 0), CreateSymInt(128, 0), CreateSymInt(0, 1)));
+  auto arg1 = flatflow::CreateTensorMetadata(builder, shape);
+  auto args = builder.CreateVector({arg0, arg1});
+  shape = builder.CreateVectorOfStructs(CreateVectorOfSymInts(
+      CreateSymInt(32, 0), CreateSymInt(0, 1), CreateSymInt(0, 1)));
+  auto meta = flatflow::CreateTensorMetadata(builder, shape);
+  auto node1 = flatflow::CreateNode(builder, flatflow::Operator::BMM, args,
+                                    meta, 0,
+                                    builder.CreateString("model.layers.0"));
+
+  auto node2 = CreateProjection(builder, "model.layers.0.self_attn.o_proj");
+  auto nodes = builder.CreateVector({node0, node1, node2});
+  auto root = flatflow::CreateGraph(builder, nodes);
+  builder.Finish(root);
+
+  auto graph =
+      flatbuffers::GetRoot<flatflow::Graph>(builder.GetBufferPointer());
+
+  const auto cost_graph = flatflow::CostGraph(graph);
+  ASSERT_EQ(cost_graph.size(), static_cast<size_t>(3));
+  EXPECT_EQ(cost_graph[0].communication(1024), 0);
+  EXPECT_EQ(cost_graph[1].communication(1024), 0);
+  EXPECT_EQ(cost_graph[2].communication(1024), 4194304);
+
+  // The scores take 8192 * s0^2 FLOPs and the projections 2^26 * s0, which
+  // reduce to s0^2 + 8192 * s0. Charging 4096 FLOPs for each of the 4096
+  // elements per token all-reduced adds 2^24 * s0 to the latter, i.e.,
+  // 2048 * s0 once reduced.
+  const auto trace =
+      flatflow::symbolic_trace(graph, flatflow::PassManager(), 0);
+  const auto comm_trace =
+      flatflow::symbolic_trace(graph, flatflow::PassManager(), 0, 4096);
+  EXPECT_EQ(trace(1024), 1024 * 1024 + 8192 * 1024);
+  EXPECT_EQ(comm_trace(1024), 1024 * 1024 + 10240 * 1024);
+}
+
+// This test checks whether the outputs of row-parallel projections with a bias
+// are all-reduced as well, as in GPT-2 where `Conv1D` lowers to `addmm`.
+TEST_F(PassesTest, BiasedCommunication) {
+  auto builder = flatbuffers::FlatBufferBuilder();
+
+  auto node0 = CreateBiasedProjection(builder, "transformer.h.0.attn.c_attn");
+  auto node1 = CreateBiasedProjection(builder, "transformer.h.0.attn.c_proj");
+  auto node2 = CreateBiasedProjection(builder, "transformer.h.0.mlp.c_proj");
+  auto nodes = builder.CreateVector({node0, node1, node2});
+  auto root = flatflow::CreateGraph(builder, nodes);
+  builder.Finish(root);
+
+  auto graph =
+      flatbuffers::GetRoot<flatflow::Graph>(builder.GetBufferPointer());
+
+  const auto cost_graph = flatflow::CostGraph(graph);
+  ASSERT_EQ(cost_graph.size(), static_cast<size_t>(3));
+  EXPECT_EQ(cost_graph[0].communication(1024), 0);
+  EXPECT_EQ(cost_graph[1].communication(1024), 786432);
+  EXPECT_EQ(cost_graph[2].communication(1024), 786432);
+}
+
+}  // namespace
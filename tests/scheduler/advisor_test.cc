@@ -0,0 +1,241 @@
+// Copyright 2025 The FlatFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "flatflow/scheduler/advisor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "absl/base/log_severity.h"
+#include "absl/log/globals.h"
+#include "absl/log/initialize.h"
+#include "absl/log/internal/globals.h"
+#include "absl/strings/str_format.h"
+#include "flatbuffers/flatbuffers.h"
+#include "gtest/gtest.h"
+
+#include "flatflow/ops/graph_generated.h"
+#include "flatflow/ops/node_generated.h"
+#include "flatflow/ops/operator_generated.h"
+#include "flatflow/ops/ops.h"
+
+namespace {
+
+flatflow::SymInt CreateSymInt(int64_t x, int64_t y) {
+  return flatflow::SymInt(flatbuffers::make_span({x, y}));
+}
+
+template <typename... Args>
+std::vector<flatflow::SymInt> CreateVectorOfSymInts(Args... args) {
+  return std::vector<flatflow::SymInt>{args...};
+}
+
+// CreateMatmul()
+//
+// Creates a node multiplying a matrix of `s0` rows by a weight matrix of shape
+// [`in_features`, `out_features`], called from the module at `module_path`.
+flatbuffers::Offset<flatflow::Node> CreateMatmul(
+    flatbuffers::FlatBufferBuilder &builder, int64_t in_features,
+    int64_t out_features, const std::string &module_path) {
+  auto shape = builder.CreateVectorOfStructs(
+      CreateVectorOfSymInts(CreateSymInt(0, 1), CreateSymInt(in_features, 0)));
+  auto arg0 = flatflow::CreateTensorMetadata(builder, shape);
+  shape = builder.CreateVectorOfStructs(CreateVectorOfSymInts(
+      CreateSymInt(in_features, 0), CreateSymInt(out_features, 0)));
+  auto arg1 = flatflow::CreateTensorMetadata(builder, shape);
+  auto args = builder.CreateVector({arg0, arg1});
+  shape = builder.CreateVectorOfStructs(CreateVectorOfSymInts(
+      CreateSymInt(0, 1), CreateSymInt(out_features, 0)));
+  auto meta = flatflow::CreateTensorMetadata(builder, shape);
+  return flatflow::CreateNode(builder, flatflow::Operator::MM, args, meta, 0,
+                              builder.CreateString(module_path));
+}
+
+// CreateAttentionScores()
+//
+// Creates a node computing the attention scores of 32 heads of size 128,
+// called outside any module.
+flatbuffers::Offset<flatflow::Node> CreateAttentionScores(
+    flatbuffers::FlatBufferBuilder &builder) {
+  auto shape = builder.CreateVectorOfStructs(CreateVectorOfSymInts(
+      CreateSymInt(32, 0), CreateSymInt(0, 1), CreateSymInt(128, 0)));
+  auto arg0 = flatflow::CreateTensorMetadata(builder, shape);
+  shape = builder.CreateVectorOfStructs(CreateVectorOfSymInts(
+      CreateSymInt(32, 0), CreateSymInt(128, 0), CreateSymInt(0, 1)));
+  auto arg1 = flatflow::CreateTensorMetadata(builder, shape);
+  auto args = builder.CreateVector({arg0, arg1});
+  shape = builder.CreateVectorOfStructs(CreateVectorOfSymInts(
+      CreateSymInt(32, 0), CreateSymInt(0, 1), CreateSymInt(0, 1)));
+  auto meta = flatflow::CreateTensorMetadata(builder, shape);
+  return flatflow::CreateNode(builder, flatflow::Operator::BMM, args, meta);
+}
+
+// CreateModel()
+//
+// Creates a reduced graph of a decoder-only model with `num_layers` layers,
+// each with a query projection, attention scores and an up projection,
+// followed by an output head over a vocabulary of 128256 tokens.
+flatbuffers::Offset<flatflow::Graph> CreateModel(
+    flatbuffers::FlatBufferBuilder &builder, int num_layers) {
+  auto nodes = std::vector<flatbuffers::Offset<flatflow::Node>>();
+  for (int layer = 0; layer < num_layers; ++layer) {
+    nodes.emplace_back(CreateMatmul(
+        builder, 4096, 4096,
+        absl::StrFormat("model.layers.%d.self_attn.q_proj", layer)));
+    nodes.emplace_back(CreateAttentionScores(builder));
+    nodes.emplace_back(CreateMatmul(
+        builder, 4096, 14336,
+        absl::StrFormat("model.layers.%d.mlp.up_proj", layer)));
+  }
+  nodes.emplace_back(CreateMatmul(builder, 4096, 128256, "lm_head"));
+  return flatflow::CreateGraph(builder, builder.CreateVector(nodes));
+}
+
+class StageAdvisorTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    if (!absl::log_internal::IsInitialized()) {
+      absl::InitializeLog();
+      absl::SetStderrThreshold(absl::LogSeverity::kInfo);
+    }
+
+    auto distribution = std::lognormal_distribution(6.0, 0.8);
+    auto generator = std::default_random_engine();
+
+    sizes_.reserve(kTotalSize);
+
+    while (sizes_.size() < sizes_.capacity()) {
+      const auto size = distribution(generator);
+      if (0.5 <= size && size < 8192.5) {
+        sizes_.emplace_back(std::lround(size));
+      }
+    }
+  }
+
+  static constexpr auto kNumLayers = 7;
+  static constexpr auto kPipelineParallelWorldSize = static_cast<size_t>(4);
+  static constexpr auto kTotalSize = static_cast<size_t>(1 << 12);
+  std::vector<uint32_t> sizes_;
+};
+
+// This test checks whether the costs of nodes are rolled up by layer, where
+// nodes without a module path belong to the layer before them.
+TEST_F(StageAdvisorTest, Layers) {
+  auto builder = flatbuffers::FlatBufferBuilder();
+  auto root = CreateModel(builder, kNumLayers);
+  builder.Finish(root);
+
+  auto graph =
+      flatbuffers::GetRoot<flatflow::Graph>(builder.GetBufferPointer());
+
+  const auto layers = flatflow::symbolic_trace_layers(graph);
+  ASSERT_EQ(layers.size(), static_cast<size_t>(kNumLayers + 1));
+
+  for (int layer = 0; layer < kNumLayers; ++layer) {
+    EXPECT_EQ(layers[layer].first, absl::StrFormat("model.layers.%d", layer));
+    // 2 * (4096 * 4096 + 4096 * 14336) * s0 + 2 * 32 * 128 * s0^2
+    EXPECT_EQ(layers[layer].second(1), 150994944 + 8192);
+  }
+  EXPECT_EQ(layers.back().first, "lm_head");
+  EXPECT_EQ(layers.back().second(1), 1050673152);
+}
+
+// This test checks whether the proposed split is optimal and no worse than
+// the split by layer count, which overloads the last stage with the output
+// head.
+TEST_F(StageAdvisorTest, Advise) {
+  auto builder = flatbuffers::FlatBufferBuilder();
+  auto root = CreateModel(builder, kNumLayers);
+  builder.Finish(root);
+
+  auto graph =
+      flatbuffers::GetRoot<flatflow::Graph>(builder.GetBufferPointer());
+
+  const auto advisor = flatflow::StageAdvisor(
+      kPipelineParallelWorldSize, sizes_.begin(), sizes_.end(), graph);
+  const auto num_layers = advisor.layers().size();
+
+  const auto uniform = advisor.Uniform();
+  EXPECT_EQ(uniform.num_layers, std::vector<size_t>({2, 2, 2, 2}));
+
+  const auto advice = advisor.Advise();
+  EXPECT_EQ(std::reduce(advice.num_layers.cbegin(), advice.num_layers.cend(),
+                        static_cast<size_t>(0)),
+            num_layers);
+  EXPECT_NEAR(std::reduce(advice.stage_costs.cbegin(),
+                          advice.stage_costs.cend()),
+              1.0, 1e-9);
+  EXPECT_LT(advice.max_stage_cost, uniform.max_stage_cost);
+
+  auto best = uniform.max_stage_cost;
+  for (size_t first = 1; first < num_layers; ++first) {
+    for (size_t second = first + 1; second < num_layers; ++second) {
+      for (size_t third = second + 1; third < num_layers; ++third) {
+        const auto split = advisor.Evaluate(
+            {first, second - first, third - second, num_layers - third});
+        best = std::min(best, split.max_stage_cost);
+      }
+    }
+  }
+  EXPECT_DOUBLE_EQ(advice.max_stage_cost, best);
+}
+
+// This test checks whether graphs without repeated layers are split evenly;
+// a graph traced without module paths is split by node, and one whose layers
+// are not numbered is split by layer.
+TEST_F(StageAdvisorTest, NoRepeatedLayers) {
+  auto builder = flatbuffers::FlatBufferBuilder();
+  auto nodes = std::vector<flatbuffers::Offset<flatflow::Node>>();
+  for (int node = 0; node < kNumLayers; ++node) {
+    nodes.emplace_back(CreateAttentionScores(builder));
+  }
+  builder.Finish(flatflow::CreateGraph(builder, builder.CreateVector(nodes)));
+
+  auto graph =
+      flatbuffers::GetRoot<flatflow::Graph>(builder.GetBufferPointer());
+
+  const auto advisor = flatflow::StageAdvisor(
+      kPipelineParallelWorldSize, sizes_.begin(), sizes_.end(), graph);
+  ASSERT_EQ(advisor.layers().size(), static_cast<size_t>(kNumLayers));
+  EXPECT_EQ(advisor.layers().front(), "0");
+
+  // The nodes cost the same, so no split beats the even one.
+  const auto uniform = advisor.Uniform();
+  EXPECT_EQ(uniform.num_layers, std::vector<size_t>({2, 2, 2, 1}));
+  EXPECT_DOUBLE_EQ(advisor.Advise().max_stage_cost, uniform.max_stage_cost);
+
+  auto named_builder = flatbuffers::FlatBufferBuilder();
+  nodes.clear();
+  for (const auto *module_path :
+       {"encoder", "encoder.norm", "decoder", "decoder.norm", "lm_head"}) {
+    nodes.emplace_back(CreateMatmul(named_builder, 4096, 4096, module_path));
+  }
+  named_builder.Finish(
+      flatflow::CreateGraph(named_builder, named_builder.CreateVector(nodes)));
+
+  const auto named_advisor = flatflow::StageAdvisor(
+      kPipelineParallelWorldSize, sizes_.begin(), sizes_.end(),
+      flatbuffers::GetRoot<flatflow::Graph>(
+          named_builder.GetBufferPointer()));
+  ASSERT_EQ(named_advisor.layers().size(), static_cast<size_t>(5));
+  EXPECT_EQ(named_advisor.Uniform().num_layers,
+            std::vector<size_t>({2, 1, 1, 1}));
+}
+
+}  // namespace
@@ -0,0 +1,189 @@
+// Copyright 2025 The FlatFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "flatflow/scheduler/autotuner.h"
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "absl/base/log_severity.h"
+#include "absl/log/globals.h"
+#include "absl/log/initialize.h"
+#include "absl/log/internal/globals.h"
+#include "flatbuffers/flatbuffers.h"
+#include "gtest/gtest.h"
+
+#include "flatflow/ops/graph_generated.h"
+#include "flatflow/ops/node_generated.h"
+#include "flatflow/ops/operator_generated.h"
+
+namespace {
+
+flatflow::SymInt CreateSymInt(int64_t x, int64_t y) {
+  return flatflow::SymInt(flatbuffers::make_span({x, y}));
+}
+
+template <typename... Args>
+std::vector<flatflow::SymInt> CreateVectorOfSymInts(Args... args) {
+  return std::vector<flatflow::SymInt>{args...};
+}
+
+// CreateSelfAttention()
+//
+// Creates a reduced graph of a self-attention layer with 32 heads of size 128,
+// consisting of the query projection, the attention scores and the weighted
+// sum of values.
+flatbuffers::Offset<flatflow::Graph> CreateSelfAttention(
+    flatbuffers::FlatBufferBuilder &builder) {
+  auto target = flatflow::Operator::MM;
+  auto shape = builder.CreateVectorOfStructs(
+      CreateVectorOfSymInts(CreateSymInt(0, 1), CreateSymInt(4096, 0)));
+  auto arg0 = flatflow::CreateTensorMetadata(builder, shape);
+  shape = builder.CreateVectorOfStructs(
+      CreateVectorOfSymInts(CreateSymInt(4096, 0), CreateSymInt(4096, 0)));
+  auto arg1 = flatflow::CreateTensorMetadata(builder, shape);
+  auto args = builder.CreateVector({arg0, arg1});
+  shape = builder.CreateVectorOfStructs(
+      CreateVectorOfSymInts(CreateSymInt(0, 1), CreateSymInt(4096, 0)));
+  auto meta = flatflow::CreateTensorMetadata(builder, shape);
+  auto node0 = flatflow::CreateNode(builder, target, args, meta);
+
+  target = flatflow::Operator::BMM;
+  shape = builder.CreateVectorOfStructs(CreateVectorOfSymInts(
+      CreateSymInt(32, 0), CreateSymInt(0, 1), CreateSymInt(128, 0)));
+  arg0 = flatflow::CreateTensorMetadata(builder, shape);
+  shape = builder.CreateVectorOfStructs(CreateVectorOfSymInts(
+      CreateSymInt(32, 0), CreateSymInt(128, 0), CreateSymInt(0, 1)));
+  arg1 = flatflow::CreateTensorMetadata(builder, shape);
+  args = builder.CreateVector({arg0, arg1});
+  shape = builder.CreateVectorOfStructs(CreateVectorOfSymInts(
+      CreateSymInt(32, 0), CreateSymInt(0, 1), CreateSymInt(0, 1)));
+  meta = flatflow::CreateTensorMetadata(builder, shape);
+  auto node1 = flatflow::CreateNode(builder, target, args, meta);
+
+  target = flatflow::Operator::_SOFTMAX;
+  shape = builder.CreateVectorOfStructs(CreateVectorOfSymInts(
+      CreateSymInt(32, 0), CreateSymInt(0, 1), CreateSymInt(0, 1)));
+  arg0 = flatflow::CreateTensorMetadata(builder, shape);
+  args = builder.CreateVector({arg0});
+  shape = builder.CreateVectorOfStructs(CreateVectorOfSymInts(
+      CreateSymInt(32, 0), CreateSymInt(0, 1), CreateSymInt(0, 1)));
+  meta = flatflow::CreateTensorMetadata(builder, shape);
+  auto node2 = flatflow::CreateNode(builder, target, args, meta);
+
+  target = flatflow::Operator::BMM;
+  shape = builder.CreateVectorOfStructs(CreateVectorOfSymInts(
+      CreateSymInt(32, 0), CreateSymInt(0, 1), CreateSymInt(0, 1)));
+  arg0 = flatflow::CreateTensorMetadata(builder, shape);
+  shape = builder.CreateVectorOfStructs(CreateVectorOfSymInts(
+      CreateSymInt(32, 0), CreateSymInt(0, 1), CreateSymInt(128, 0)));
+  arg1 = flatflow::CreateTensorMetadata(builder, shape);
+  args = builder.CreateVector({arg0, arg1});
+  shape = builder.CreateVectorOfStructs(CreateVectorOfSymInts(
+      CreateSymInt(32, 0), CreateSymInt(0, 1), CreateSymInt(128, 0)));
+  meta = flatflow::CreateTensorMetadata(builder, shape);
+  auto node3 = flatflow::CreateNode(builder, target, args, meta);
+
+  auto nodes = builder.CreateVector({node0, node1, node2, node3});
+  return flatflow::CreateGraph(builder, nodes);
+}
+
+class AutotunerTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    if (!absl::log_internal::IsInitialized()) {
+      absl::InitializeLog();
+      absl::SetStderrThreshold(absl::LogSeverity::kInfo);
+    }
+
+    auto distribution = std::lognormal_distribution(5.252, 0.293);
+    auto generator = std::default_random_engine();
+
+    sizes_.reserve(kTotalSize);
+
+    while (sizes_.size() < sizes_.capacity()) {
+      const auto size = distribution(generator);
+      if (0.5 <= size && size < 8192.5) {
+        sizes_.emplace_back(std::lround(size));
+      }
+    }
+  }
+
+  static constexpr auto kDataParallelWorldSize = static_cast<size_t>(1 << 2);
+  static constexpr auto kPipelineParallelWorldSize =
+      static_cast<size_t>(1 << 2);
+  static constexpr auto kTotalSize = static_cast<size_t>(1 << 13);
+  std::vector<uint32_t> sizes_;
+};
+
+// This test checks whether the autotuner ranks the configurations that fit in
+// the memory budget first, in ascending order of their time per sample.
+TEST_F(AutotunerTest, Tune) {
+  auto builder = flatbuffers::FlatBufferBuilder();
+  auto root = CreateSelfAttention(builder);
+  builder.Finish(root);
+
+  auto graph =
+      flatbuffers::GetRoot<flatflow::Graph>(builder.GetBufferPointer());
+
+  auto options = flatflow::AutotunerOptions();
+  options.microbatch_overhead = 2.0;
+
+  const auto autotuner = flatflow::Autotuner(
+      kDataParallelWorldSize, kPipelineParallelWorldSize, sizes_.begin(),
+      sizes_.end(), graph, static_cast<size_t>(1) << 31, options);
+  const auto configs = autotuner.Tune({1 << 8, 1 << 9, 1 << 10});
+
+  // There are 7 + 8 + 9 powers of two dividing the per-replica batch sizes.
+  ASSERT_EQ(configs.size(), static_cast<size_t>(24));
+
+  for (size_t index = 1; index < configs.size(); ++index) {
+    const auto &prev = configs[index - 1];
+    const auto &config = configs[index];
+    EXPECT_EQ(config.global_batch_size % kDataParallelWorldSize, 0);
+    EXPECT_EQ(config.global_batch_size / kDataParallelWorldSize %
+                  config.micro_batch_size,
+              0);
+    if ((0 <= prev.memory_headroom) == (0 <= config.memory_headroom)) {
+      EXPECT_LE(prev.time_per_sample, config.time_per_sample);
+    } else {
+      EXPECT_LE(0, prev.memory_headroom);
+    }
+  }
+}
+
+// This test checks whether a tighter memory budget rules out the largest
+// micro-batches, whose activations do not fit.
+TEST_F(AutotunerTest, MemoryBudget) {
+  auto builder = flatbuffers::FlatBufferBuilder();
+  auto root = CreateSelfAttention(builder);
+  builder.Finish(root);
+
+  auto graph =
+      flatbuffers::GetRoot<flatflow::Graph>(builder.GetBufferPointer());
+
+  const auto autotuner = flatflow::Autotuner(
+      kDataParallelWorldSize, kPipelineParallelWorldSize, sizes_.begin(),
+      sizes_.end(), graph, static_cast<size_t>(1) << 26);
+
+  const auto small = autotuner.Evaluate(1 << 8, 1 << 1);
+  const auto large = autotuner.Evaluate(1 << 8, 1 << 6);
+  EXPECT_GT(small.memory_headroom, large.memory_headroom);
+  EXPECT_LE(0, small.memory_headroom);
+  EXPECT_GT(0, large.memory_headroom);
+}
+
+}  // namespace
@@ -0,0 +1,156 @@
+// Copyright 2025 The FlatFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "flatflow/scheduler/inference.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <numeric>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "absl/base/log_severity.h"
+#include "absl/log/globals.h"
+#include "absl/log/initialize.h"
+#include "absl/log/internal/globals.h"
+#include "flatbuffers/flatbuffers.h"
+#include "gtest/gtest.h"
+
+#include "flatflow/ops/graph_generated.h"
+#include "flatflow/ops/node_generated.h"
+#include "flatflow/ops/operator_generated.h"
+
+namespace {
+
+flatflow::SymInt CreateSymInt(int64_t x, int64_t y) {
+  return flatflow::SymInt(flatbuffers::make_span({x, y}));
+}
+
+template <typename... Args>
+std::vector<flatflow::SymInt> CreateVectorOfSymInts(Args... args) {
+  return std::vector<flatflow::SymInt>{args...};
+}
+
+class InferenceSchedulerTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    if (!absl::log_internal::IsInitialized()) {
+      absl::InitializeLog();
+      absl::SetStderrThreshold(absl::LogSeverity::kInfo);
+    }
+
+    // A single projection of shape [s0, 4096] x [4096, 4096], whose cost is
+    // linear in the number of tokens.
+    auto shape = builder_.CreateVectorOfStructs(
+        CreateVectorOfSymInts(CreateSymInt(0, 1), CreateSymInt(4096, 0)));
+    auto arg0 = flatflow::CreateTensorMetadata(builder_, shape);
+    shape = builder_.CreateVectorOfStructs(
+        CreateVectorOfSymInts(CreateSymInt(4096, 0), CreateSymInt(4096, 0)));
+    auto arg1 = flatflow::CreateTensorMetadata(builder_, shape);
+    auto args = builder_.CreateVector({arg0, arg1});
+    shape = builder_.CreateVectorOfStructs(
+        CreateVectorOfSymInts(CreateSymInt(0, 1), CreateSymInt(4096, 0)));
+    auto meta = flatflow::CreateTensorMetadata(builder_, shape);
+    auto node =
+        flatflow::CreateNode(builder_, flatflow::Operator::MM, args, meta);
+    builder_.Finish(
+        flatflow::CreateGraph(builder_, builder_.CreateVector({node})));
+
+    // Prompt lengths follow a long-tailed distribution, and outputs are
+    // expected to be a quarter of their prompts.
+    auto generator = std::default_random_engine();
+    auto distribution = std::lognormal_distribution(6.0, 1.0);
+    while (prompt_sizes_.size() < kDatasetSize) {
+      const auto size = distribution(generator);
+      if (0.5 <= size && size < 8192.5) {
+        prompt_sizes_.emplace_back(static_cast<uint32_t>(size + 0.5));
+        output_sizes_.emplace_back(prompt_sizes_.back() / 4 + 1);
+      }
+    }
+  }
+
+  const flatflow::Graph *graph() const {
+    return flatbuffers::GetRoot<flatflow::Graph>(builder_.GetBufferPointer());
+  }
+
+  static constexpr auto kDatasetSize = static_cast<std::size_t>(10007);
+  static constexpr auto kDataParallelWorldSize = static_cast<std::size_t>(8);
+  static constexpr auto kKvCacheBudget = static_cast<std::size_t>(65536);
+  static constexpr auto kMaxBatchSize = static_cast<std::size_t>(64);
+  flatbuffers::FlatBufferBuilder builder_;
+  std::vector<uint32_t> prompt_sizes_;
+  std::vector<uint32_t> output_sizes_;
+};
+
+// This test checks whether every sample is scheduled exactly once, whether
+// the batches stay within the KV-cache budget and the maximum batch size, and
+// whether the replicas take about the same cost.
+TEST_F(InferenceSchedulerTest, Schedule) {
+  const auto scheduler = flatflow::InferenceScheduler(
+      kDataParallelWorldSize, prompt_sizes_.begin(), prompt_sizes_.end(),
+      output_sizes_.begin(), graph(), kKvCacheBudget, kMaxBatchSize);
+
+  auto indices = std::vector<std::size_t>(kDatasetSize);
+  std::iota(indices.begin(), indices.end(), 0);
+  auto result = std::vector<std::size_t>(kDatasetSize);
+  const auto sizes =
+      scheduler.Schedule(indices.begin(), indices.end(), result.begin());
+
+  EXPECT_EQ(std::set<std::size_t>(result.cbegin(), result.cend()).size(),
+            kDatasetSize);
+  EXPECT_EQ(sizes.size() % kDataParallelWorldSize,
+            static_cast<std::size_t>(0));
+  EXPECT_EQ(std::reduce(sizes.cbegin(), sizes.cend(),
+                        static_cast<std::size_t>(0)),
+            kDatasetSize);
+
+  auto costs = std::vector<int64_t>(kDataParallelWorldSize);
+  auto offset = static_cast<std::size_t>(0);
+  for (std::size_t index = 0; index < sizes.size(); ++index) {
+    const auto first = std::next(result.cbegin(), offset);
+    const auto last = std::next(first, sizes[index]);
+    EXPECT_LE(sizes[index], kMaxBatchSize);
+    if (1 < sizes[index]) {
+      EXPECT_LE(scheduler.NumTokens(first, last), kKvCacheBudget);
+    }
+    costs[index % kDataParallelWorldSize] += scheduler.Cost(first, last);
+    offset += sizes[index];
+  }
+
+  const auto [min, max] = std::minmax_element(costs.cbegin(), costs.cend());
+  EXPECT_LT(static_cast<double>(*max) / static_cast<double>(*min), 1.01);
+}
+
+// This test checks whether a sample that alone exceeds the budget is given a
+// batch of its own, rather than being dropped or merged with the others.
+TEST_F(InferenceSchedulerTest, Overflow) {
+  const auto prompt_sizes = std::vector<uint32_t>({100, 200000, 300});
+  const auto output_sizes = std::vector<uint32_t>({10, 10, 10});
+  const auto scheduler = flatflow::InferenceScheduler(
+      2, prompt_sizes.begin(), prompt_sizes.end(), output_sizes.begin(),
+      graph(), kKvCacheBudget);
+
+  const auto indices = std::vector<std::size_t>({0, 1, 2});
+  auto result = std::vector<std::size_t>(indices.size());
+  const auto sizes =
+      scheduler.Schedule(indices.begin(), indices.end(), result.begin());
+
+  EXPECT_EQ(sizes, std::vector<std::size_t>({2, 1}));
+  EXPECT_EQ(result, std::vector<std::size_t>({0, 2, 1}));
+}
+
+}  // namespace
@@ -0,0 +1,84 @@
+// Copyright 2025 The FlatFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "flatflow/scheduler/internal/dictionary.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+// This test checks whether a sequence with few distinct keys is encoded with
+// 16-bit IDs, and whether the keys are decoded as they were.
+TEST(DictionaryTest, NarrowIds) {
+  constexpr auto kTotalSize = static_cast<std::size_t>(1 << 16);
+
+  auto generator = std::mt19937();
+  auto distribution = std::uniform_int_distribution<uint32_t>(1, 8192);
+
+  auto keys = std::vector<uint32_t>(kTotalSize);
+  std::generate(keys.begin(), keys.end(),
+                [&]() { return distribution(generator); });
+
+  const auto dictionary =
+      flatflow::internal::Dictionary<std::size_t>(keys.begin(), keys.end());
+
+  EXPECT_EQ(dictionary.size(), kTotalSize);
+  EXPECT_EQ(dictionary.id_width(), static_cast<std::size_t>(16));
+  EXPECT_TRUE(std::is_sorted(dictionary.keys().cbegin(),
+                             dictionary.keys().cend()));
+  EXPECT_EQ(dictionary.num_bytes(),
+            kTotalSize * sizeof(uint16_t) +
+                dictionary.keys().size() * sizeof(std::size_t));
+
+  for (std::size_t index = 0; index < kTotalSize; ++index) {
+    EXPECT_EQ(dictionary[index], keys[index]);
+  }
+
+  // IDs are assigned in ascending order of keys, so comparing IDs is the same
+  // as comparing keys.
+  for (std::size_t index = 1; index < kTotalSize; ++index) {
+    EXPECT_EQ(dictionary.id(index - 1) < dictionary.id(index),
+              keys[index - 1] < keys[index]);
+  }
+}
+
+// This test checks whether a sequence with more distinct keys than 16 bits can
+// hold is encoded with 32-bit IDs.
+TEST(DictionaryTest, WideIds) {
+  constexpr auto kTotalSize = static_cast<std::size_t>(1 << 18);
+
+  auto keys = std::vector<uint32_t>(kTotalSize);
+  for (std::size_t index = 0; index < kTotalSize; ++index) {
+    keys[index] = static_cast<uint32_t>((index * 7919) % (1 << 17));
+  }
+
+  const auto dictionary =
+      flatflow::internal::Dictionary<std::size_t>(keys.begin(), keys.end());
+
+  EXPECT_EQ(dictionary.size(), kTotalSize);
+  EXPECT_EQ(dictionary.id_width(), static_cast<std::size_t>(32));
+  EXPECT_EQ(dictionary.keys().size(), static_cast<std::size_t>(1 << 17));
+
+  for (std::size_t index = 0; index < kTotalSize; ++index) {
+    EXPECT_EQ(dictionary[index], keys[index]);
+  }
+}
+
+}  // namespace
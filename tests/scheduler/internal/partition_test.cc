@@ -18,8 +18,12 @@
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <iterator>
+#include <limits>
+#include <numeric>
 #include <random>
+#include <set>
 #include <utility>
 #include <vector>
 
@@ -142,4 +146,147 @@ TEST_F(PartitionTest, BLDMWithGaltonRealDistribution) {
   LOG(INFO) << absl::StrFormat("Workloads: %s", absl::StrJoin(workloads, " "));
 }
 
+TEST_F(PartitionTest, LowerBound) {
+  // The subset holding the largest item holds the smallest one as well.
+  EXPECT_EQ(flatflow::internal::LowerBound(std::vector<uint32_t>({1, 2, 3, 10}),
+                                           2),
+            static_cast<uint32_t>(11));
+  EXPECT_EQ(flatflow::internal::LowerBound(std::vector<uint32_t>({4, 4, 4, 4}),
+                                           2),
+            static_cast<uint32_t>(8));
+  EXPECT_EQ(flatflow::internal::LowerBound(std::vector<uint32_t>({1, 1, 1, 4}),
+                                           4),
+            static_cast<uint32_t>(4));
+  // The order of predicates does not matter.
+  EXPECT_EQ(flatflow::internal::LowerBound(std::vector<uint32_t>({10, 3, 1, 2}),
+                                           2),
+            static_cast<uint32_t>(11));
+}
+
+// This test checks whether local search narrows the gap of BLDM on
+// a heavy-tailed instance too large to be solved exactly, while keeping both
+// the items and cardinalities of subsets intact.
+TEST_F(PartitionTest, LocalSearchWithHeavyTailedDistribution) {
+  constexpr auto kNumSubsets = static_cast<size_t>(16);
+  constexpr auto kCardinality = static_cast<size_t>(6);
+
+  auto distribution = std::lognormal_distribution(12.0, 1.0);
+  auto generator = std::default_random_engine();
+
+  auto items = std::vector<std::pair<uint64_t, size_t>>();
+  items.reserve(kNumSubsets * kCardinality);
+
+  while (items.size() < items.capacity()) {
+    const auto workload = static_cast<uint64_t>(distribution(generator)) + 1;
+    const auto index = items.size();
+    items.emplace_back(workload, index);
+  }
+
+  auto workloads = std::vector<uint64_t>();
+  workloads.reserve(items.size());
+  for (const auto &item : items) {
+    workloads.emplace_back(item.first);
+  }
+
+  std::sort(items.begin(), items.end(), [](const auto &lhs, const auto &rhs) {
+    return lhs.first < rhs.first;
+  });
+
+  const auto pred = [](const auto &item) { return item.first; };
+  const auto proj = [](const auto &item) { return item.second; };
+
+  auto subsets =
+      std::vector<flatflow::internal::Subset<uint64_t, size_t>>(kNumSubsets);
+  auto stats = flatflow::internal::PartitionStats();
+  flatflow::internal::Partition(items.begin(), items.end(), subsets.begin(),
+                                pred, proj, kNumSubsets,
+                                flatflow::internal::PartitionOptions(), &stats);
+  EXPECT_EQ(stats.solver, "BLDM");
+
+  const auto gap = stats.gap;
+  LOG(INFO) << absl::StrFormat("Gap of BLDM: %f", gap);
+
+  auto options = flatflow::internal::PartitionOptions();
+  options.time_limit = 1.0;
+  flatflow::internal::Partition(items.begin(), items.end(), subsets.begin(),
+                                pred, proj, kNumSubsets, options, &stats);
+  EXPECT_EQ(stats.solver, "local search");
+  EXPECT_LT(stats.gap, gap);
+  LOG(INFO) << absl::StrFormat("Gap of local search: %f", stats.gap);
+
+  EXPECT_TRUE(std::is_sorted(subsets.cbegin(), subsets.cend()));
+
+  auto indices = std::set<size_t>();
+  for (const auto &subset : subsets) {
+    EXPECT_EQ(subset.items().size(), kCardinality);
+    EXPECT_EQ(subset.sum(),
+              std::transform_reduce(
+                  subset.begin(), subset.end(), uint64_t{0}, std::plus<>(),
+                  [&](size_t index) { return workloads[index]; }));
+    indices.insert(subset.begin(), subset.end());
+  }
+  EXPECT_EQ(indices.size(), items.size());
+}
+
+// This test checks whether small instances are partitioned optimally, against
+// exhaustive search over every balanced partition.
+TEST_F(PartitionTest, ExactWithSmallInstances) {
+  constexpr auto kNumItems = static_cast<size_t>(8);
+  constexpr auto kNumTrials = static_cast<size_t>(1 << 6);
+
+  auto distribution = std::lognormal_distribution(12.0, 1.0);
+  auto generator = std::default_random_engine();
+
+  for (size_t trial = 0; trial < kNumTrials; ++trial) {
+    for (const auto m : {2, 4}) {
+      auto items = std::vector<uint64_t>();
+      while (items.size() < kNumItems) {
+        items.emplace_back(static_cast<uint64_t>(distribution(generator)) + 1);
+      }
+      std::sort(items.begin(), items.end());
+
+      // Every assignment of items to subsets is enumerated as a number in
+      // base `m`, of which only those with equal cardinalities are balanced.
+      auto optimum = std::numeric_limits<uint64_t>::max();
+      auto num_assignments = static_cast<size_t>(1);
+      for (size_t index = 0; index < kNumItems; ++index) {
+        num_assignments *= m;
+      }
+      for (size_t assignment = 0; assignment < num_assignments; ++assignment) {
+        auto sums = std::vector<uint64_t>(m);
+        auto counts = std::vector<size_t>(m);
+        auto code = assignment;
+        for (const auto item : items) {
+          sums[code % m] += item;
+          ++counts[code % m];
+          code /= m;
+        }
+        if (std::all_of(counts.cbegin(), counts.cend(), [&](size_t count) {
+              return count == kNumItems / m;
+            })) {
+          optimum =
+              std::min(optimum, *std::max_element(sums.cbegin(), sums.cend()));
+        }
+      }
+
+      auto options = flatflow::internal::PartitionOptions();
+      options.exact = true;
+
+      auto subsets =
+          std::vector<flatflow::internal::Subset<uint64_t, uint64_t>>(m);
+      auto stats = flatflow::internal::PartitionStats();
+      flatflow::internal::Partition(items.begin(), items.end(),
+                                    subsets.begin(), std::identity(),
+                                    std::identity(), m, options, &stats);
+
+      EXPECT_TRUE(std::is_sorted(subsets.cbegin(), subsets.cend()));
+      EXPECT_EQ(subsets.back().sum(), optimum);
+      EXPECT_NE(stats.solver, "branch and bound");
+      for (const auto &subset : subsets) {
+        EXPECT_EQ(subset.items().size(), kNumItems / m);
+      }
+    }
+  }
+}
+
 }  // namespace
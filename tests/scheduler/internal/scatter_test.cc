@@ -80,4 +80,22 @@ TEST(ScatterTest, ScatterWithRemainderOnly) {
   EXPECT_EQ(to, std::vector<size_t>({4, 5}));
 }
 
+TEST(ScatterTest, Scatterv) {
+  constexpr auto kN = static_cast<size_t>(1 << 2);
+  constexpr auto kRank = static_cast<size_t>(1 << 1);
+  constexpr auto kTotalSize = static_cast<size_t>(28);
+
+  auto from = std::vector<size_t>(kTotalSize);
+  std::iota(from.begin(), from.end(), 0);
+
+  const auto counts = std::vector<size_t>({4, 8, 2, 2, 6, 2, 2, 2});
+
+  auto to = std::vector<size_t>(4);
+  const auto result = flatflow::internal::Scatterv(
+      from.begin(), from.end(), to.begin(), counts.begin(), kN, kRank);
+  EXPECT_EQ(std::distance(result, to.end()), 0);
+
+  EXPECT_EQ(to, std::vector<size_t>({12, 13, 24, 25}));
+}
+
 }  // namespace
@@ -0,0 +1,175 @@
+// Copyright 2025 The FlatFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "flatflow/scheduler/policy.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "absl/base/log_severity.h"
+#include "absl/log/globals.h"
+#include "absl/log/initialize.h"
+#include "absl/log/internal/globals.h"
+#include "flatbuffers/flatbuffers.h"
+#include "gtest/gtest.h"
+
+#include "flatflow/ops/graph_generated.h"
+#include "flatflow/ops/node_generated.h"
+#include "flatflow/ops/operator_generated.h"
+#include "flatflow/scheduler/scheduler.h"
+
+namespace {
+
+static_assert(flatflow::SchedulingPolicy<flatflow::Scheduler>);
+static_assert(flatflow::SchedulingPolicy<flatflow::SequentialScheduler>);
+
+flatflow::SymInt CreateSymInt(int64_t x, int64_t y) {
+  return flatflow::SymInt(flatbuffers::make_span({x, y}));
+}
+
+template <typename... Args>
+std::vector<flatflow::SymInt> CreateVectorOfSymInts(Args... args) {
+  return std::vector<flatflow::SymInt>{args...};
+}
+
+class PolicyTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    if (!absl::log_internal::IsInitialized()) {
+      absl::InitializeLog();
+      absl::SetStderrThreshold(absl::LogSeverity::kInfo);
+    }
+
+    // The attention scores of shape [s0, 128] x [128, s0], whose cost is
+    // quadratic in the number of tokens.
+    auto shape = builder_.CreateVectorOfStructs(
+        CreateVectorOfSymInts(CreateSymInt(0, 1), CreateSymInt(128, 0)));
+    auto arg0 = flatflow::CreateTensorMetadata(builder_, shape);
+    shape = builder_.CreateVectorOfStructs(
+        CreateVectorOfSymInts(CreateSymInt(128, 0), CreateSymInt(0, 1)));
+    auto arg1 = flatflow::CreateTensorMetadata(builder_, shape);
+    auto args = builder_.CreateVector({arg0, arg1});
+    shape = builder_.CreateVectorOfStructs(
+        CreateVectorOfSymInts(CreateSymInt(0, 1), CreateSymInt(0, 1)));
+    auto meta = flatflow::CreateTensorMetadata(builder_, shape);
+    auto node =
+        flatflow::CreateNode(builder_, flatflow::Operator::MM, args, meta);
+    builder_.Finish(
+        flatflow::CreateGraph(builder_, builder_.CreateVector({node})));
+
+    auto generator = std::default_random_engine();
+    auto distribution = std::lognormal_distribution(5.252, 0.293);
+    while (sizes_.size() < kDatasetSize) {
+      const auto size = distribution(generator);
+      if (0.5 <= size && size < 8192.5) {
+        sizes_.emplace_back(static_cast<uint32_t>(size + 0.5));
+      }
+    }
+
+    indices_.resize(kDatasetSize);
+    std::iota(indices_.begin(), indices_.end(), 0);
+    std::shuffle(indices_.begin(), indices_.end(), generator);
+  }
+
+  const flatflow::Graph *graph() const {
+    return flatbuffers::GetRoot<flatflow::Graph>(builder_.GetBufferPointer());
+  }
+
+  static constexpr auto kDatasetSize = static_cast<std::size_t>(4000);
+  static constexpr auto kDataParallelWorldSize = static_cast<std::size_t>(4);
+  static constexpr auto kGlobalBatchSize = static_cast<std::size_t>(256);
+  static constexpr auto kMicroBatchSize = static_cast<std::size_t>(4);
+  static constexpr auto kNumGlobalBatches =
+      (kDatasetSize + kGlobalBatchSize - 1) / kGlobalBatchSize;
+  flatbuffers::FlatBufferBuilder builder_;
+  std::vector<uint32_t> sizes_;
+  std::vector<std::size_t> indices_;
+};
+
+// This test checks whether the default policy behaves the same as the
+// scheduler it holds.
+TEST_F(PolicyTest, Default) {
+  const auto scheduler = flatflow::Scheduler(
+      kDataParallelWorldSize, kGlobalBatchSize, kMicroBatchSize,
+      sizes_.begin(), sizes_.end(), graph());
+  const auto policy = flatflow::AnyScheduler(scheduler);
+
+  auto expected = std::vector<std::size_t>(kDatasetSize);
+  auto expected_sizes =
+      std::vector<std::size_t>(kNumGlobalBatches * kDataParallelWorldSize);
+  scheduler.Schedule(indices_.begin(), indices_.end(), expected.begin(),
+                     expected_sizes.begin());
+
+  auto result = std::vector<std::size_t>(kDatasetSize);
+  auto sizes =
+      std::vector<std::size_t>(kNumGlobalBatches * kDataParallelWorldSize);
+  policy.Schedule(indices_.begin(), indices_.end(), result.begin(),
+                  sizes.begin());
+
+  EXPECT_EQ(result, expected);
+  EXPECT_EQ(sizes, expected_sizes);
+  EXPECT_EQ(policy.Cost(result.cbegin(), result.cend()),
+            scheduler.Cost(result.cbegin(), result.cend()));
+}
+
+// This test checks whether the sequential policy keeps the given order, and
+// splits each global batch evenly across the ranks.
+TEST_F(PolicyTest, Sequential) {
+  const auto policy = flatflow::AnyScheduler(flatflow::SequentialScheduler(
+      kDataParallelWorldSize, kGlobalBatchSize, kMicroBatchSize,
+      sizes_.begin(), sizes_.end(), graph()));
+
+  auto result = std::vector<std::size_t>(kDatasetSize);
+  auto sizes =
+      std::vector<std::size_t>(kNumGlobalBatches * kDataParallelWorldSize);
+  policy.Schedule(indices_.begin(), indices_.end(), result.begin(),
+                  sizes.begin());
+
+  EXPECT_EQ(result, indices_);
+  for (std::size_t index = 0; index < sizes.size(); ++index) {
+    const auto expected = index / kDataParallelWorldSize + 1 < kNumGlobalBatches
+                              ? kGlobalBatchSize / kDataParallelWorldSize
+                              : kDatasetSize % kGlobalBatchSize /
+                                    kDataParallelWorldSize;
+    EXPECT_EQ(sizes[index], expected);
+  }
+}
+
+// This test checks whether the sequential policy spreads the remainder of
+// a global batch that does not divide evenly over the first ranks.
+TEST_F(PolicyTest, SequentialRemainder) {
+  const auto policy = flatflow::AnyScheduler(flatflow::SequentialScheduler(
+      kDataParallelWorldSize, kGlobalBatchSize, kMicroBatchSize,
+      sizes_.begin(), sizes_.end(), graph()));
+
+  // The last global batch holds 159 samples, or 39 per rank with 3 left over.
+  constexpr auto kNumSamples = kDatasetSize - 1;
+
+  auto result = std::vector<std::size_t>(kNumSamples);
+  auto sizes =
+      std::vector<std::size_t>(kNumGlobalBatches * kDataParallelWorldSize);
+  policy.Schedule(indices_.begin(), std::next(indices_.begin(), kNumSamples),
+                  result.begin(), sizes.begin());
+
+  EXPECT_EQ(std::reduce(sizes.cbegin(), sizes.cend()), kNumSamples);
+  const auto tail = std::vector<std::size_t>(
+      std::prev(sizes.cend(), kDataParallelWorldSize), sizes.cend());
+  EXPECT_EQ(tail, std::vector<std::size_t>({40, 40, 40, 39}));
+}
+
+}  // namespace
@@ -0,0 +1,147 @@
+// Copyright 2025 The FlatFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "flatflow/scheduler/recompute.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "absl/base/log_severity.h"
+#include "absl/log/globals.h"
+#include "absl/log/initialize.h"
+#include "absl/log/internal/globals.h"
+#include "absl/strings/str_format.h"
+#include "flatbuffers/flatbuffers.h"
+#include "gtest/gtest.h"
+
+#include "flatflow/ops/graph_generated.h"
+#include "flatflow/ops/node_generated.h"
+#include "flatflow/ops/operator_generated.h"
+
+namespace {
+
+flatflow::SymInt CreateSymInt(int64_t x, int64_t y) {
+  return flatflow::SymInt(flatbuffers::make_span({x, y}));
+}
+
+template <typename... Args>
+std::vector<flatflow::SymInt> CreateVectorOfSymInts(Args... args) {
+  return std::vector<flatflow::SymInt>{args...};
+}
+
+// CreateMatmul()
+//
+// Creates a node multiplying a matrix of `s0` rows by a weight matrix of shape
+// [4096, `out_features`], called from the module at `module_path`.
+flatbuffers::Offset<flatflow::Node> CreateMatmul(
+    flatbuffers::FlatBufferBuilder &builder, int64_t out_features,
+    const std::string &module_path) {
+  auto shape = builder.CreateVectorOfStructs(
+      CreateVectorOfSymInts(CreateSymInt(0, 1), CreateSymInt(4096, 0)));
+  auto arg0 = flatflow::CreateTensorMetadata(builder, shape);
+  shape = builder.CreateVectorOfStructs(CreateVectorOfSymInts(
+      CreateSymInt(4096, 0), CreateSymInt(out_features, 0)));
+  auto arg1 = flatflow::CreateTensorMetadata(builder, shape);
+  auto args = builder.CreateVector({arg0, arg1});
+  shape = builder.CreateVectorOfStructs(CreateVectorOfSymInts(
+      CreateSymInt(0, 1), CreateSymInt(out_features, 0)));
+  auto meta = flatflow::CreateTensorMetadata(builder, shape);
+  return flatflow::CreateNode(builder, flatflow::Operator::MM, args, meta, 0,
+                              builder.CreateString(module_path));
+}
+
+class RecomputePlannerTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    if (!absl::log_internal::IsInitialized()) {
+      absl::InitializeLog();
+      absl::SetStderrThreshold(absl::LogSeverity::kInfo);
+    }
+
+    // Each layer allocates 4096 + 14336 = 18432 activations per token.
+    auto nodes = std::vector<flatbuffers::Offset<flatflow::Node>>();
+    for (int layer = 0; layer < kNumLayers; ++layer) {
+      nodes.emplace_back(CreateMatmul(
+          builder_, 4096,
+          absl::StrFormat("model.layers.%d.self_attn.q_proj", layer)));
+      nodes.emplace_back(CreateMatmul(
+          builder_, 14336,
+          absl::StrFormat("model.layers.%d.mlp.up_proj", layer)));
+    }
+    builder_.Finish(
+        flatflow::CreateGraph(builder_, builder_.CreateVector(nodes)));
+  }
+
+  const flatflow::Graph *graph() const {
+    return flatbuffers::GetRoot<flatflow::Graph>(builder_.GetBufferPointer());
+  }
+
+  // The budget holds a micro-batch of 1024 tokens in bf16.
+  static constexpr auto kNumLayers = 4;
+  static constexpr auto kMemoryBudget =
+      static_cast<std::size_t>(18432 * kNumLayers * 1024 * 2);
+  flatbuffers::FlatBufferBuilder builder_;
+  std::vector<uint32_t> sizes_ = {512, 1024, 2048, 4096, 8192};
+  std::vector<std::size_t> indices_ = {0, 1, 2, 3, 4};
+};
+
+// This test checks whether micro-batches that fit in the budget skip
+// recomputation, while the others recompute just enough layers to fit.
+TEST_F(RecomputePlannerTest, Plan) {
+  const auto planner = flatflow::RecomputePlanner(
+      sizes_.begin(), sizes_.end(), graph(), kMemoryBudget);
+  EXPECT_EQ(planner.num_layers(), static_cast<std::size_t>(kNumLayers));
+
+  const auto plan = [&](std::size_t first, std::size_t last) {
+    return planner.Plan(std::next(indices_.cbegin(), first),
+                        std::next(indices_.cbegin(), last));
+  };
+
+  EXPECT_EQ(plan(0, 1), static_cast<std::size_t>(0));
+  EXPECT_EQ(plan(1, 2), static_cast<std::size_t>(0));
+  EXPECT_EQ(plan(2, 3), static_cast<std::size_t>(2));
+  EXPECT_EQ(plan(3, 4), static_cast<std::size_t>(3));
+  EXPECT_EQ(plan(4, 5), static_cast<std::size_t>(4));
+  EXPECT_EQ(plan(0, 2), static_cast<std::size_t>(2));
+}
+
+// This test checks whether the layers and the budget are shared among the
+// pipeline stages, and whether padding is taken into account.
+TEST_F(RecomputePlannerTest, Options) {
+  auto options = flatflow::RecomputeOptions();
+  options.pipeline_parallel_world_size = 2;
+
+  auto planner = flatflow::RecomputePlanner(sizes_.begin(), sizes_.end(),
+                                            graph(), kMemoryBudget, options);
+  EXPECT_EQ(planner.num_layers(), static_cast<std::size_t>(2));
+  EXPECT_EQ(planner.Plan(std::next(indices_.cbegin(), 1),
+                         std::next(indices_.cbegin(), 2)),
+            static_cast<std::size_t>(0));
+  EXPECT_EQ(planner.Plan(std::next(indices_.cbegin(), 2),
+                         std::next(indices_.cbegin(), 3)),
+            static_cast<std::size_t>(1));
+
+  options.pipeline_parallel_world_size = 1;
+  options.pad_to_longest = true;
+
+  planner = flatflow::RecomputePlanner(sizes_.begin(), sizes_.end(), graph(),
+                                       kMemoryBudget, options);
+  EXPECT_EQ(planner.Plan(indices_.cbegin(), std::next(indices_.cbegin(), 2)),
+            static_cast<std::size_t>(2));
+}
+
+}  // namespace
@@ -14,6 +14,8 @@
 
 #include "flatflow/scheduler/scheduler.h"
 
+#include <omp.h>
+
 #include <algorithm>
 #include <cmath>
 #include <cstddef>
@@ -101,7 +103,8 @@ class SchedChecker : public flatflow::Scheduler {
               std::transform_reduce(
                   std::next(indices.begin(), first),
                   std::next(indices.begin(), first + micro_batch_size_), kZero,
-                  std::plus<>(), [&](size_t index) { return preds_[index]; }));
+                  std::plus<>(),
+                  [&](size_t index) { return preds_[sizes_.id(index)]; }));
         }
 
         LOG(INFO) << absl::StrFormat("[%s]", absl::StrJoin(buf, " "));
@@ -115,7 +118,7 @@ class SchedChecker : public flatflow::Scheduler {
             std::transform_reduce(
                 std::next(indices.begin(), last - last_micro_batch_size),
                 std::next(indices.begin(), last), kZero, std::plus<>(),
-                [&](size_t index) { return preds_[index]; }));
+                [&](size_t index) { return preds_[sizes_.id(index)]; }));
       }
 
       LOG(INFO) << absl::StrFormat("[%s]", absl::StrJoin(buf, " "));
@@ -133,6 +136,67 @@ std::vector<flatflow::SymInt> CreateVectorOfSymInts(Args... args) {
   return std::vector<flatflow::SymInt>{args...};
 }
 
+// CreateSelfAttention()
+//
+// Creates a reduced graph of a self-attention layer with 32 heads of size 128,
+// consisting of the query projection, the attention scores and the weighted
+// sum of values. This is sufficient to produce a cost model with both linear
+// and quadratic terms.
+flatbuffers::Offset<flatflow::Graph> CreateSelfAttention(
+    flatbuffers::FlatBufferBuilder &builder) {
+  auto target = flatflow::Operator::MM;
+  auto shape = builder.CreateVectorOfStructs(
+      CreateVectorOfSymInts(CreateSymInt(0, 1), CreateSymInt(4096, 0)));
+  auto arg0 = flatflow::CreateTensorMetadata(builder, shape);
+  shape = builder.CreateVectorOfStructs(
+      CreateVectorOfSymInts(CreateSymInt(4096, 0), CreateSymInt(4096, 0)));
+  auto arg1 = flatflow::CreateTensorMetadata(builder, shape);
+  auto args = builder.CreateVector({arg0, arg1});
+  shape = builder.CreateVectorOfStructs(
+      CreateVectorOfSymInts(CreateSymInt(0, 1), CreateSymInt(4096, 0)));
+  auto meta = flatflow::CreateTensorMetadata(builder, shape);
+  auto node0 = flatflow::CreateNode(builder, target, args, meta);
+
+  target = flatflow::Operator::BMM;
+  shape = builder.CreateVectorOfStructs(CreateVectorOfSymInts(
+      CreateSymInt(32, 0), CreateSymInt(0, 1), CreateSymInt(128, 0)));
+  arg0 = flatflow::CreateTensorMetadata(builder, shape);
+  shape = builder.CreateVectorOfStructs(CreateVectorOfSymInts(
+      CreateSymInt(32, 0), CreateSymInt(128, 0), CreateSymInt(0, 1)));
+  arg1 = flatflow::CreateTensorMetadata(builder, shape);
+  args = builder.CreateVector({arg0, arg1});
+  shape = builder.CreateVectorOfStructs(CreateVectorOfSymInts(
+      CreateSymInt(32, 0), CreateSymInt(0, 1), CreateSymInt(0, 1)));
+  meta = flatflow::CreateTensorMetadata(builder, shape);
+  auto node1 = flatflow::CreateNode(builder, target, args, meta);
+
+  target = flatflow::Operator::_SOFTMAX;
+  shape = builder.CreateVectorOfStructs(CreateVectorOfSymInts(
+      CreateSymInt(32, 0), CreateSymInt(0, 1), CreateSymInt(0, 1)));
+  arg0 = flatflow::CreateTensorMetadata(builder, shape);
+  args = builder.CreateVector({arg0});
+  shape = builder.CreateVectorOfStructs(CreateVectorOfSymInts(
+      CreateSymInt(32, 0), CreateSymInt(0, 1), CreateSymInt(0, 1)));
+  meta = flatflow::CreateTensorMetadata(builder, shape);
+  auto node2 = flatflow::CreateNode(builder, target, args, meta);
+
+  target = flatflow::Operator::BMM;
+  shape = builder.CreateVectorOfStructs(CreateVectorOfSymInts(
+      CreateSymInt(32, 0), CreateSymInt(0, 1), CreateSymInt(0, 1)));
+  arg0 = flatflow::CreateTensorMetadata(builder, shape);
+  shape = builder.CreateVectorOfStructs(CreateVectorOfSymInts(
+      CreateSymInt(32, 0), CreateSymInt(0, 1), CreateSymInt(128, 0)));
+  arg1 = flatflow::CreateTensorMetadata(builder, shape);
+  args = builder.CreateVector({arg0, arg1});
+  shape = builder.CreateVectorOfStructs(CreateVectorOfSymInts(
+      CreateSymInt(32, 0), CreateSymInt(0, 1), CreateSymInt(128, 0)));
+  meta = flatflow::CreateTensorMetadata(builder, shape);
+  auto node3 = flatflow::CreateNode(builder, target, args, meta);
+
+  auto nodes = builder.CreateVector({node0, node1, node2, node3});
+  return flatflow::CreateGraph(builder, nodes);
+}
+
 class SchedulerTest : public testing::Test {
  protected:
   void SetUp() override {
@@ -5221,4 +5285,1005 @@ TEST_F(SchedulerWithRemainderOnlyTest, Llama3) {
   checker.on_train_end();
 }
 
+class SchedulerWithOptionsTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    if (!absl::log_internal::IsInitialized()) {
+      absl::InitializeLog();
+      absl::SetStderrThreshold(absl::LogSeverity::kInfo);
+    }
+
+    auto distribution = std::lognormal_distribution(5.252, 0.293);
+    auto generator = std::default_random_engine();
+
+    sizes_.reserve(kTotalSize);
+
+    while (sizes_.size() < sizes_.capacity()) {
+      const auto size = distribution(generator);
+      if (0.5 <= size && size < 8192.5) {
+        sizes_.emplace_back(std::lround(size));
+      }
+    }
+  }
+
+  static constexpr auto kDataParallelWorldSize = static_cast<size_t>(1 << 3);
+  static constexpr auto kGlobalBatchSize = static_cast<size_t>(3 << 8);
+  static constexpr auto kMicroBatchSize = static_cast<size_t>(3 << 1);
+  static constexpr auto kNumEpochs = static_cast<size_t>(1 << 1);
+  static constexpr auto kTotalSize = static_cast<size_t>(1 << 15);
+  std::vector<uint32_t> sizes_;
+};
+
+TEST_F(SchedulerWithOptionsTest, Topology) {
+  auto builder = flatbuffers::FlatBufferBuilder();
+  auto root = CreateSelfAttention(builder);
+  builder.Finish(root);
+
+  auto graph =
+      flatbuffers::GetRoot<flatflow::Graph>(builder.GetBufferPointer());
+
+  // Two nodes with interleaved ranks, so that ranks on the same node are not
+  // adjacent to each other.
+  auto options = flatflow::SchedulerOptions();
+  options.node_ids = std::vector<size_t>({0, 1, 0, 1, 0, 1, 0, 1});
+
+  const auto checker =
+      SchedChecker(kDataParallelWorldSize, kGlobalBatchSize, kMicroBatchSize,
+                   sizes_.begin(), sizes_.end(), graph, options);
+
+  checker.on_train_begin();
+  for (size_t epoch = 0; epoch < kNumEpochs; ++epoch) {
+    checker.on_epoch_begin(epoch);
+
+    auto schedule = std::vector<size_t>(kTotalSize);
+    std::iota(schedule.begin(), schedule.end(), 0);
+
+    auto generator = std::mt19937();
+    generator.seed(epoch);
+    std::shuffle(schedule.begin(), schedule.end(), generator);
+
+    checker.Check(schedule);
+
+    checker.on_epoch_end(epoch);
+  }
+  checker.on_train_end();
+}
+
+TEST_F(SchedulerWithOptionsTest, ContextParallel) {
+  auto builder = flatbuffers::FlatBufferBuilder();
+  auto root = CreateSelfAttention(builder);
+  builder.Finish(root);
+
+  auto graph =
+      flatbuffers::GetRoot<flatflow::Graph>(builder.GetBufferPointer());
+
+  constexpr auto kThreshold = static_cast<uint32_t>(300);
+
+  auto options = flatflow::SchedulerOptions();
+  options.context_parallel_world_size = 2;
+  options.context_parallel_threshold = kThreshold;
+
+  const auto checker =
+      SchedChecker(kDataParallelWorldSize, kGlobalBatchSize, kMicroBatchSize,
+                   sizes_.begin(), sizes_.end(), graph, options);
+
+  for (size_t index = 0; index < kTotalSize; ++index) {
+    EXPECT_EQ(checker.IsSplit(index), kThreshold <= sizes_[index]);
+  }
+
+  checker.on_train_begin();
+  for (size_t epoch = 0; epoch < kNumEpochs; ++epoch) {
+    checker.on_epoch_begin(epoch);
+
+    auto schedule = std::vector<size_t>(kTotalSize);
+    std::iota(schedule.begin(), schedule.end(), 0);
+
+    auto generator = std::mt19937();
+    generator.seed(epoch);
+    std::shuffle(schedule.begin(), schedule.end(), generator);
+
+    checker.Check(schedule);
+
+    checker.on_epoch_end(epoch);
+  }
+  checker.on_train_end();
+}
+
+TEST_F(SchedulerWithOptionsTest, PadToLongest) {
+  auto builder = flatbuffers::FlatBufferBuilder();
+  auto root = CreateSelfAttention(builder);
+  builder.Finish(root);
+
+  auto graph =
+      flatbuffers::GetRoot<flatflow::Graph>(builder.GetBufferPointer());
+
+  auto options = flatflow::SchedulerOptions();
+  options.pad_to_longest = true;
+
+  const auto checker =
+      SchedChecker(kDataParallelWorldSize, kGlobalBatchSize, kMicroBatchSize,
+                   sizes_.begin(), sizes_.end(), graph, options);
+
+  checker.on_train_begin();
+  for (size_t epoch = 0; epoch < kNumEpochs; ++epoch) {
+    checker.on_epoch_begin(epoch);
+
+    auto schedule = std::vector<size_t>(kTotalSize);
+    std::iota(schedule.begin(), schedule.end(), 0);
+
+    auto generator = std::mt19937();
+    generator.seed(epoch);
+    std::shuffle(schedule.begin(), schedule.end(), generator);
+
+    checker.Check(schedule);
+
+    checker.on_epoch_end(epoch);
+  }
+  checker.on_train_end();
+}
+
+TEST_F(SchedulerWithOptionsTest, BoundInflightActivations) {
+  auto builder = flatbuffers::FlatBufferBuilder();
+  auto root = CreateSelfAttention(builder);
+  builder.Finish(root);
+
+  auto graph =
+      flatbuffers::GetRoot<flatflow::Graph>(builder.GetBufferPointer());
+
+  auto options = flatflow::SchedulerOptions();
+  options.pipeline_parallel_world_size = 4;
+  options.bound_inflight_activations = true;
+
+  const auto checker =
+      SchedChecker(kDataParallelWorldSize, kGlobalBatchSize, kMicroBatchSize,
+                   sizes_.begin(), sizes_.end(), graph, options);
+
+  checker.on_train_begin();
+  for (size_t epoch = 0; epoch < kNumEpochs; ++epoch) {
+    checker.on_epoch_begin(epoch);
+
+    auto schedule = std::vector<size_t>(kTotalSize);
+    std::iota(schedule.begin(), schedule.end(), 0);
+
+    auto generator = std::mt19937();
+    generator.seed(epoch);
+    std::shuffle(schedule.begin(), schedule.end(), generator);
+
+    checker.Check(schedule);
+
+    checker.on_epoch_end(epoch);
+  }
+  checker.on_train_end();
+}
+
+TEST_F(SchedulerWithOptionsTest, Offsets) {
+  auto builder = flatbuffers::FlatBufferBuilder();
+  auto root = CreateSelfAttention(builder);
+  builder.Finish(root);
+
+  auto graph =
+      flatbuffers::GetRoot<flatflow::Graph>(builder.GetBufferPointer());
+
+  // Store the samples in reverse order, so that the offsets are not aligned
+  // with the indices.
+  auto options = flatflow::SchedulerOptions();
+  options.offsets.resize(kTotalSize);
+  for (size_t index = 0; index < kTotalSize; ++index) {
+    options.offsets[index] = (kTotalSize - index) << 12;
+  }
+
+  const auto checker =
+      SchedChecker(kDataParallelWorldSize, kGlobalBatchSize, kMicroBatchSize,
+                   sizes_.begin(), sizes_.end(), graph, options);
+
+  checker.on_train_begin();
+  for (size_t epoch = 0; epoch < kNumEpochs; ++epoch) {
+    checker.on_epoch_begin(epoch);
+
+    auto schedule = std::vector<size_t>(kTotalSize);
+    std::iota(schedule.begin(), schedule.end(), 0);
+
+    auto generator = std::mt19937();
+    generator.seed(epoch);
+    std::shuffle(schedule.begin(), schedule.end(), generator);
+
+    checker.Check(schedule);
+
+    auto indices = std::vector<size_t>(kTotalSize);
+    checker.Schedule(schedule.begin(), schedule.end(), indices.begin());
+
+    // Only the full global batches are checked here, as the last one has
+    // a different micro-batch size.
+    constexpr auto kFullSize = kTotalSize - kTotalSize % kGlobalBatchSize;
+    for (size_t offset = 0; offset < kFullSize; offset += kMicroBatchSize) {
+      EXPECT_TRUE(std::is_sorted(
+          std::next(indices.begin(), offset),
+          std::next(indices.begin(), offset + kMicroBatchSize),
+          [&](size_t lhs, size_t rhs) {
+            return options.offsets[lhs] < options.offsets[rhs];
+          }));
+    }
+
+    checker.on_epoch_end(epoch);
+  }
+  checker.on_train_end();
+}
+
+TEST_F(SchedulerWithOptionsTest, ShardAffinity) {
+  auto builder = flatbuffers::FlatBufferBuilder();
+  auto root = CreateSelfAttention(builder);
+  builder.Finish(root);
+
+  auto graph =
+      flatbuffers::GetRoot<flatflow::Graph>(builder.GetBufferPointer());
+
+  // Emulate 64 shards spread over four nodes with two ranks each.
+  constexpr auto kNumShards = static_cast<size_t>(1 << 6);
+  constexpr auto kNumNodes = static_cast<size_t>(1 << 2);
+
+  auto options = flatflow::SchedulerOptions();
+  options.node_ids = {0, 0, 1, 1, 2, 2, 3, 3};
+  options.shard_ids.resize(kTotalSize);
+  for (size_t index = 0; index < kTotalSize; ++index) {
+    options.shard_ids[index] = index * 7 % kNumShards;
+  }
+  options.shard_node_ids.resize(kNumShards);
+  for (size_t shard_id = 0; shard_id < kNumShards; ++shard_id) {
+    options.shard_node_ids[shard_id] = shard_id % kNumNodes;
+  }
+  options.max_balance_penalty = 0.01;
+
+  const auto checker =
+      SchedChecker(kDataParallelWorldSize, kGlobalBatchSize, kMicroBatchSize,
+                   sizes_.begin(), sizes_.end(), graph, options);
+
+  checker.on_train_begin();
+  for (size_t epoch = 0; epoch < kNumEpochs; ++epoch) {
+    checker.on_epoch_begin(epoch);
+
+    auto schedule = std::vector<size_t>(kTotalSize);
+    std::iota(schedule.begin(), schedule.end(), 0);
+
+    auto generator = std::mt19937();
+    generator.seed(epoch);
+    std::shuffle(schedule.begin(), schedule.end(), generator);
+
+    checker.Check(schedule);
+
+    // Without shard affinity, about a quarter of the samples would be local.
+    auto indices = std::vector<size_t>(kTotalSize);
+    checker.Schedule(schedule.begin(), schedule.end(), indices.begin());
+
+    constexpr auto kFullSize = kTotalSize - kTotalSize % kGlobalBatchSize;
+    constexpr auto kPerReplicaBatchSize =
+        kGlobalBatchSize / kDataParallelWorldSize;
+    auto num_locals = static_cast<size_t>(0);
+    for (size_t offset = 0; offset < kFullSize; ++offset) {
+      const auto rank = offset % kGlobalBatchSize / kPerReplicaBatchSize;
+      const auto shard_id = options.shard_ids[indices[offset]];
+      if (options.shard_node_ids[shard_id] == options.node_ids[rank]) {
+        ++num_locals;
+      }
+    }
+    EXPECT_GT(num_locals, kFullSize / 2);
+
+    // Each replica takes its remainders after its full micro-batches in the
+    // last global batch, which are exchanged for locality as well.
+    constexpr auto kLastPerReplicaBatchSize =
+        (kTotalSize - kFullSize) / kDataParallelWorldSize;
+    constexpr auto kNumRemainders = kLastPerReplicaBatchSize % kMicroBatchSize;
+    auto num_remainder_locals = static_cast<size_t>(0);
+    for (size_t rank = 0; rank < kDataParallelWorldSize; ++rank) {
+      for (size_t position = kLastPerReplicaBatchSize - kNumRemainders;
+           position < kLastPerReplicaBatchSize; ++position) {
+        const auto offset =
+            kFullSize + kLastPerReplicaBatchSize * rank + position;
+        const auto shard_id = options.shard_ids[indices[offset]];
+        if (options.shard_node_ids[shard_id] == options.node_ids[rank]) {
+          ++num_remainder_locals;
+        }
+      }
+    }
+    EXPECT_GT(num_remainder_locals,
+              kDataParallelWorldSize * kNumRemainders / 3);
+
+    checker.on_epoch_end(epoch);
+  }
+  checker.on_train_end();
+}
+
+// This test checks whether allowing uneven micro-batch counts balances
+// heavy-tailed workloads better than equal cardinalities, while every global
+// batch is still fully scattered across the ranks in whole micro-batches.
+TEST_F(SchedulerWithOptionsTest, UnevenMicrobatches) {
+  auto builder = flatbuffers::FlatBufferBuilder();
+  auto root = CreateSelfAttention(builder);
+  builder.Finish(root);
+
+  auto graph =
+      flatbuffers::GetRoot<flatflow::Graph>(builder.GetBufferPointer());
+
+  auto distribution = std::lognormal_distribution(5.0, 1.2);
+  auto generator = std::default_random_engine();
+
+  auto sizes = std::vector<uint32_t>();
+  sizes.reserve(kTotalSize);
+
+  while (sizes.size() < sizes.capacity()) {
+    const auto size = distribution(generator);
+    if (0.5 <= size && size < 8192.5) {
+      sizes.emplace_back(std::lround(size));
+    }
+  }
+
+  auto options = flatflow::SchedulerOptions();
+  options.uneven_microbatches = true;
+
+  const auto scheduler =
+      flatflow::Scheduler(kDataParallelWorldSize, kGlobalBatchSize,
+                          kMicroBatchSize, sizes.begin(), sizes.end(), graph);
+  const auto checker =
+      SchedChecker(kDataParallelWorldSize, kGlobalBatchSize, kMicroBatchSize,
+                   sizes.begin(), sizes.end(), graph, options);
+
+  const auto trace = flatflow::symbolic_trace(graph);
+
+  constexpr auto kNumGlobalBatches =
+      (kTotalSize + kGlobalBatchSize - 1) / kGlobalBatchSize;
+
+  // Returns the cost of the slowest rank in each global batch.
+  const auto max_costs = [&](const std::vector<size_t> &indices,
+                             const std::vector<size_t> &batch_sizes) {
+    auto costs = std::vector<int64_t>(kNumGlobalBatches);
+    auto offset = static_cast<size_t>(0);
+    for (size_t index = 0; index < batch_sizes.size(); ++index) {
+      auto cost = static_cast<int64_t>(0);
+      for (size_t count = 0; count < batch_sizes[index]; ++count) {
+        cost += trace(sizes[indices[offset++]]);
+      }
+      auto &max_cost = costs[index / kDataParallelWorldSize];
+      max_cost = std::max(max_cost, cost);
+    }
+    return costs;
+  };
+
+  checker.on_train_begin();
+  for (size_t epoch = 0; epoch < kNumEpochs; ++epoch) {
+    checker.on_epoch_begin(epoch);
+
+    auto schedule = std::vector<size_t>(kTotalSize);
+    std::iota(schedule.begin(), schedule.end(), 0);
+
+    auto generator = std::mt19937();
+    generator.seed(epoch);
+    std::shuffle(schedule.begin(), schedule.end(), generator);
+
+    checker.Check(schedule);
+
+    auto indices = std::vector<size_t>(kTotalSize);
+    auto batch_sizes =
+        std::vector<size_t>(kNumGlobalBatches * kDataParallelWorldSize);
+    checker.Schedule(schedule.begin(), schedule.end(), indices.begin(),
+                     batch_sizes.begin());
+
+    auto even_indices = std::vector<size_t>(kTotalSize);
+    auto even_batch_sizes =
+        std::vector<size_t>(kNumGlobalBatches * kDataParallelWorldSize);
+    scheduler.Schedule(schedule.begin(), schedule.end(), even_indices.begin(),
+                       even_batch_sizes.begin());
+
+    EXPECT_EQ(std::reduce(batch_sizes.cbegin(), batch_sizes.cend()),
+              kTotalSize);
+
+    // Only the full global batches consist of whole micro-batches alone.
+    constexpr auto kNumFullGlobalBatches = kTotalSize / kGlobalBatchSize;
+    for (size_t index = 0;
+         index < kNumFullGlobalBatches * kDataParallelWorldSize; ++index) {
+      EXPECT_NE(batch_sizes[index], static_cast<size_t>(0));
+      EXPECT_EQ(batch_sizes[index] % kMicroBatchSize, static_cast<size_t>(0));
+      EXPECT_EQ(even_batch_sizes[index],
+                kGlobalBatchSize / kDataParallelWorldSize);
+    }
+
+    const auto costs = max_costs(indices, batch_sizes);
+    const auto even_costs = max_costs(even_indices, even_batch_sizes);
+    for (size_t index = 0; index < kNumGlobalBatches; ++index) {
+      EXPECT_LE(costs[index], even_costs[index]);
+    }
+    EXPECT_LT(std::reduce(costs.cbegin(), costs.cend()),
+              std::reduce(even_costs.cbegin(), even_costs.cend()));
+
+    checker.on_epoch_end(epoch);
+  }
+  checker.on_train_end();
+}
+
+// This test checks whether forward-only scheduling keeps micro-batch counts
+// even and ignores in-flight activations, as there are no backward passes.
+TEST_F(SchedulerWithOptionsTest, ForwardOnly) {
+  auto builder = flatbuffers::FlatBufferBuilder();
+  auto root = CreateSelfAttention(builder);
+  builder.Finish(root);
+
+  auto graph =
+      flatbuffers::GetRoot<flatflow::Graph>(builder.GetBufferPointer());
+
+  auto distribution = std::lognormal_distribution(5.0, 1.2);
+  auto generator = std::default_random_engine();
+
+  auto sizes = std::vector<uint32_t>();
+  sizes.reserve(kTotalSize);
+
+  while (sizes.size() < sizes.capacity()) {
+    const auto size = distribution(generator);
+    if (0.5 <= size && size < 8192.5) {
+      sizes.emplace_back(std::lround(size));
+    }
+  }
+
+  auto options = flatflow::SchedulerOptions();
+  options.pipeline_parallel_world_size = 4;
+  options.bound_inflight_activations = true;
+  options.forward_only = true;
+
+  auto unbounded_options = flatflow::SchedulerOptions();
+  unbounded_options.pipeline_parallel_world_size = 4;
+
+  const auto scheduler =
+      flatflow::Scheduler(kDataParallelWorldSize, kGlobalBatchSize,
+                          kMicroBatchSize, sizes.begin(), sizes.end(), graph,
+                          unbounded_options);
+  const auto checker =
+      SchedChecker(kDataParallelWorldSize, kGlobalBatchSize, kMicroBatchSize,
+                   sizes.begin(), sizes.end(), graph, options);
+
+  constexpr auto kNumGlobalBatches =
+      (kTotalSize + kGlobalBatchSize - 1) / kGlobalBatchSize;
+
+  checker.on_train_begin();
+  for (size_t epoch = 0; epoch < kNumEpochs; ++epoch) {
+    checker.on_epoch_begin(epoch);
+
+    auto schedule = std::vector<size_t>(kTotalSize);
+    std::iota(schedule.begin(), schedule.end(), 0);
+
+    auto generator = std::mt19937();
+    generator.seed(epoch);
+    std::shuffle(schedule.begin(), schedule.end(), generator);
+
+    checker.Check(schedule);
+
+    auto indices = std::vector<size_t>(kTotalSize);
+    auto batch_sizes =
+        std::vector<size_t>(kNumGlobalBatches * kDataParallelWorldSize);
+    checker.Schedule(schedule.begin(), schedule.end(), indices.begin(),
+                     batch_sizes.begin());
+
+    auto expected_indices = std::vector<size_t>(kTotalSize);
+    auto expected_batch_sizes =
+        std::vector<size_t>(kNumGlobalBatches * kDataParallelWorldSize);
+    scheduler.Schedule(schedule.begin(), schedule.end(),
+                       expected_indices.begin(), expected_batch_sizes.begin());
+
+    EXPECT_EQ(indices, expected_indices);
+    EXPECT_EQ(batch_sizes, expected_batch_sizes);
+
+    for (size_t index = 0; index < batch_sizes.size(); ++index) {
+      EXPECT_EQ(batch_sizes[index],
+                batch_sizes[index - index % kDataParallelWorldSize]);
+    }
+
+    checker.on_epoch_end(epoch);
+  }
+  checker.on_train_end();
+}
+
+// This test checks whether the predicted cost of a micro-batch is the sum of
+// the costs of its samples, or the cost of its longest sample times its size
+// if samples are padded.
+TEST_F(SchedulerWithOptionsTest, Cost) {
+  auto builder = flatbuffers::FlatBufferBuilder();
+  auto root = CreateSelfAttention(builder);
+  builder.Finish(root);
+
+  auto graph =
+      flatbuffers::GetRoot<flatflow::Graph>(builder.GetBufferPointer());
+
+  auto options = flatflow::SchedulerOptions();
+  options.pad_to_longest = true;
+
+  const auto scheduler =
+      flatflow::Scheduler(kDataParallelWorldSize, kGlobalBatchSize,
+                          kMicroBatchSize, sizes_.begin(), sizes_.end(), graph);
+  const auto padded_scheduler = flatflow::Scheduler(
+      kDataParallelWorldSize, kGlobalBatchSize, kMicroBatchSize,
+      sizes_.begin(), sizes_.end(), graph, options);
+
+  const auto trace = flatflow::symbolic_trace(graph);
+
+  for (size_t offset = 0; offset < kTotalSize; offset += kMicroBatchSize) {
+    auto indices = std::vector<size_t>(kMicroBatchSize);
+    std::iota(indices.begin(), indices.end(), offset);
+
+    auto sum = static_cast<int64_t>(0);
+    auto max = static_cast<int64_t>(0);
+    for (const auto index : indices) {
+      sum += trace(sizes_[index]);
+      max = std::max(max, static_cast<int64_t>(trace(sizes_[index])));
+    }
+
+    EXPECT_EQ(scheduler.Cost(indices.begin(), indices.end()), sum);
+    EXPECT_EQ(padded_scheduler.Cost(indices.begin(), indices.end()),
+              max * static_cast<int64_t>(kMicroBatchSize));
+  }
+}
+
+// This test checks whether the number of tokens in a micro-batch is the sum of
+// the sizes of its samples, or the size of its longest sample times its size
+// if samples are padded.
+TEST_F(SchedulerWithOptionsTest, NumTokens) {
+  auto builder = flatbuffers::FlatBufferBuilder();
+  auto root = CreateSelfAttention(builder);
+  builder.Finish(root);
+
+  auto graph =
+      flatbuffers::GetRoot<flatflow::Graph>(builder.GetBufferPointer());
+
+  auto options = flatflow::SchedulerOptions();
+  options.pad_to_longest = true;
+
+  const auto scheduler =
+      flatflow::Scheduler(kDataParallelWorldSize, kGlobalBatchSize,
+                          kMicroBatchSize, sizes_.begin(), sizes_.end(), graph);
+  const auto padded_scheduler = flatflow::Scheduler(
+      kDataParallelWorldSize, kGlobalBatchSize, kMicroBatchSize,
+      sizes_.begin(), sizes_.end(), graph, options);
+
+  for (size_t offset = 0; offset < kTotalSize; offset += kMicroBatchSize) {
+    auto indices = std::vector<size_t>(kMicroBatchSize);
+    std::iota(indices.begin(), indices.end(), offset);
+
+    auto sum = static_cast<size_t>(0);
+    auto max = static_cast<size_t>(0);
+    for (const auto index : indices) {
+      sum += sizes_[index];
+      max = std::max(max, static_cast<size_t>(sizes_[index]));
+    }
+
+    EXPECT_EQ(scheduler.NumTokens(indices.begin(), indices.end()), sum);
+    EXPECT_EQ(padded_scheduler.NumTokens(indices.begin(), indices.end()),
+              max * kMicroBatchSize);
+  }
+}
+
+// This test checks whether shape buckets are assigned to the smallest bucket
+// that fits each micro-batch, and whether fitting micro-batches into buckets
+// reduces overflows without changing the cost of any replica.
+TEST_F(SchedulerWithOptionsTest, ShapeBuckets) {
+  auto builder = flatbuffers::FlatBufferBuilder();
+  auto root = CreateSelfAttention(builder);
+  builder.Finish(root);
+
+  auto graph =
+      flatbuffers::GetRoot<flatflow::Graph>(builder.GetBufferPointer());
+
+  auto options = flatflow::SchedulerOptions();
+  options.bucket_capacities = {1024, 1152, 1280};
+  const auto num_buckets = options.bucket_capacities.size();
+
+  const auto scheduler =
+      flatflow::Scheduler(kDataParallelWorldSize, kGlobalBatchSize,
+                          kMicroBatchSize, sizes_.begin(), sizes_.end(), graph);
+  const auto checker =
+      SchedChecker(kDataParallelWorldSize, kGlobalBatchSize, kMicroBatchSize,
+                   sizes_.begin(), sizes_.end(), graph, options);
+
+  const auto trace = flatflow::symbolic_trace(graph);
+
+  constexpr auto kNumGlobalBatches =
+      (kTotalSize + kGlobalBatchSize - 1) / kGlobalBatchSize;
+
+  // Returns the cost of each replica in each global batch.
+  const auto costs = [&](const std::vector<size_t> &indices,
+                         const std::vector<size_t> &batch_sizes) {
+    auto costs = std::vector<int64_t>(batch_sizes.size());
+    auto offset = static_cast<size_t>(0);
+    for (size_t index = 0; index < batch_sizes.size(); ++index) {
+      for (size_t count = 0; count < batch_sizes[index]; ++count) {
+        costs[index] += trace(sizes_[indices[offset++]]);
+      }
+    }
+    return costs;
+  };
+
+  // Returns the number of micro-batches that exceed the largest bucket.
+  const auto num_overflows = [&](const std::vector<size_t> &indices,
+                                 const std::vector<size_t> &batch_sizes) {
+    auto count = static_cast<size_t>(0);
+    auto offset = static_cast<size_t>(0);
+    for (const auto batch_size : batch_sizes) {
+      for (size_t base = 0; base < batch_size; base += kMicroBatchSize) {
+        const auto first = std::next(indices.cbegin(), offset + base);
+        const auto last = std::next(
+            first, std::min(kMicroBatchSize, batch_size - base));
+        const auto num_tokens = std::transform_reduce(
+            first, last, static_cast<size_t>(0), std::plus<>(),
+            [&](size_t index) { return static_cast<size_t>(sizes_[index]); });
+        const auto bucket = checker.Bucket(first, last);
+        if (bucket < num_buckets) {
+          EXPECT_LE(num_tokens, options.bucket_capacities[bucket]);
+          if (0 < bucket) {
+            EXPECT_GT(num_tokens, options.bucket_capacities[bucket - 1]);
+          }
+        } else {
+          EXPECT_GT(num_tokens, options.bucket_capacities.back());
+          ++count;
+        }
+      }
+      offset += batch_size;
+    }
+    return count;
+  };
+
+  checker.on_train_begin();
+  for (size_t epoch = 0; epoch < kNumEpochs; ++epoch) {
+    checker.on_epoch_begin(epoch);
+
+    auto schedule = std::vector<size_t>(kTotalSize);
+    std::iota(schedule.begin(), schedule.end(), 0);
+
+    auto generator = std::mt19937();
+    generator.seed(epoch);
+    std::shuffle(schedule.begin(), schedule.end(), generator);
+
+    checker.Check(schedule);
+
+    auto indices = std::vector<size_t>(kTotalSize);
+    auto batch_sizes =
+        std::vector<size_t>(kNumGlobalBatches * kDataParallelWorldSize);
+    checker.Schedule(schedule.begin(), schedule.end(), indices.begin(),
+                     batch_sizes.begin());
+
+    auto unbucketed_indices = std::vector<size_t>(kTotalSize);
+    auto unbucketed_batch_sizes =
+        std::vector<size_t>(kNumGlobalBatches * kDataParallelWorldSize);
+    scheduler.Schedule(schedule.begin(), schedule.end(),
+                       unbucketed_indices.begin(),
+                       unbucketed_batch_sizes.begin());
+
+    EXPECT_EQ(batch_sizes, unbucketed_batch_sizes);
+    EXPECT_EQ(costs(indices, batch_sizes),
+              costs(unbucketed_indices, unbucketed_batch_sizes));
+    EXPECT_LE(num_overflows(indices, batch_sizes),
+              num_overflows(unbucketed_indices, unbucketed_batch_sizes));
+
+    checker.on_epoch_end(epoch);
+  }
+  checker.on_train_end();
+}
+
+// This test checks whether micro-batches that exceed a bucket other than the
+// largest one are fitted as well. With a generous largest bucket nothing
+// overflows, so every micro-batch that misses the middle bucket by a little
+// must have no swap left that fits it into a smaller bucket while keeping the
+// other micro-batch in its own bucket.
+TEST_F(SchedulerWithOptionsTest, ShapeBucketsMiddle) {
+  auto builder = flatbuffers::FlatBufferBuilder();
+  auto root = CreateSelfAttention(builder);
+  builder.Finish(root);
+
+  auto graph =
+      flatbuffers::GetRoot<flatflow::Graph>(builder.GetBufferPointer());
+
+  auto options = flatflow::SchedulerOptions();
+  options.bucket_capacities = {1024, 1152, 1536};
+  const auto &capacities = options.bucket_capacities;
+
+  const auto scheduler =
+      flatflow::Scheduler(kDataParallelWorldSize, kGlobalBatchSize,
+                          kMicroBatchSize, sizes_.begin(), sizes_.end(), graph);
+  const auto checker =
+      SchedChecker(kDataParallelWorldSize, kGlobalBatchSize, kMicroBatchSize,
+                   sizes_.begin(), sizes_.end(), graph, options);
+
+  constexpr auto kNumGlobalBatches =
+      (kTotalSize + kGlobalBatchSize - 1) / kGlobalBatchSize;
+
+  const auto bucket = [&](size_t num_tokens) {
+    return static_cast<size_t>(std::distance(
+        capacities.cbegin(),
+        std::lower_bound(capacities.cbegin(), capacities.cend(), num_tokens)));
+  };
+
+  // Returns the samples of each micro-batch of each replica.
+  const auto microbatches = [&](const std::vector<size_t> &indices,
+                                const std::vector<size_t> &batch_sizes) {
+    auto replicas = std::vector<std::vector<std::vector<size_t>>>();
+    auto offset = static_cast<size_t>(0);
+    for (const auto batch_size : batch_sizes) {
+      auto &replica = replicas.emplace_back();
+      for (size_t base = 0; base < batch_size; base += kMicroBatchSize) {
+        const auto first = std::next(indices.cbegin(), offset + base);
+        replica.emplace_back(
+            first,
+            std::next(first, std::min(kMicroBatchSize, batch_size - base)));
+      }
+      offset += batch_size;
+    }
+    return replicas;
+  };
+
+  const auto num_tokens = [&](const std::vector<size_t> &microbatch) {
+    return std::transform_reduce(
+        microbatch.cbegin(), microbatch.cend(), static_cast<size_t>(0),
+        std::plus<>(),
+        [&](size_t index) { return static_cast<size_t>(sizes_[index]); });
+  };
+
+  // Returns the number of micro-batches that fit the smallest two buckets.
+  const auto num_fits = [&](const auto &replicas) {
+    auto count = static_cast<size_t>(0);
+    for (const auto &replica : replicas) {
+      for (const auto &microbatch : replica) {
+        count += num_tokens(microbatch) <= capacities[1] ? 1 : 0;
+      }
+    }
+    return count;
+  };
+
+  checker.on_train_begin();
+  for (size_t epoch = 0; epoch < kNumEpochs; ++epoch) {
+    checker.on_epoch_begin(epoch);
+
+    auto schedule = std::vector<size_t>(kTotalSize);
+    std::iota(schedule.begin(), schedule.end(), 0);
+
+    auto generator = std::mt19937();
+    generator.seed(epoch);
+    std::shuffle(schedule.begin(), schedule.end(), generator);
+
+    auto indices = std::vector<size_t>(kTotalSize);
+    auto batch_sizes =
+        std::vector<size_t>(kNumGlobalBatches * kDataParallelWorldSize);
+    checker.Schedule(schedule.begin(), schedule.end(), indices.begin(),
+                     batch_sizes.begin());
+
+    auto unbucketed_indices = std::vector<size_t>(kTotalSize);
+    auto unbucketed_batch_sizes =
+        std::vector<size_t>(kNumGlobalBatches * kDataParallelWorldSize);
+    scheduler.Schedule(schedule.begin(), schedule.end(),
+                       unbucketed_indices.begin(),
+                       unbucketed_batch_sizes.begin());
+
+    const auto replicas = microbatches(indices, batch_sizes);
+    EXPECT_GT(num_fits(replicas),
+              num_fits(microbatches(unbucketed_indices,
+                                    unbucketed_batch_sizes)));
+
+    for (const auto &replica : replicas) {
+      for (const auto &lhs : replica) {
+        const auto lnum_tokens = num_tokens(lhs);
+        const auto lbucket = bucket(lnum_tokens);
+        ASSERT_LT(lbucket, capacities.size());
+        if (lbucket == 0) {
+          continue;
+        }
+        const auto excess = lnum_tokens - capacities[lbucket - 1];
+        for (const auto &rhs : replica) {
+          if (&rhs == &lhs) {
+            continue;
+          }
+          const auto rnum_tokens = num_tokens(rhs);
+          const auto slack = capacities[bucket(rnum_tokens)] - rnum_tokens;
+          for (const auto lindex : lhs) {
+            for (const auto rindex : rhs) {
+              if (sizes_[lindex] <= sizes_[rindex]) {
+                continue;
+              }
+              const auto delta =
+                  static_cast<size_t>(sizes_[lindex] - sizes_[rindex]);
+              EXPECT_FALSE(excess <= delta && delta <= slack);
+            }
+          }
+        }
+      }
+    }
+
+    checker.on_epoch_end(epoch);
+  }
+  checker.on_train_end();
+}
+
+// This test checks whether refining partitions never makes the slowest replica
+// of any global batch slower, while keeping the composition of each batch.
+TEST_F(SchedulerWithOptionsTest, PartitionGap) {
+  auto builder = flatbuffers::FlatBufferBuilder();
+  auto root = CreateSelfAttention(builder);
+  builder.Finish(root);
+
+  auto graph =
+      flatbuffers::GetRoot<flatflow::Graph>(builder.GetBufferPointer());
+
+  auto options = flatflow::SchedulerOptions();
+  options.partition_time_limit = 1.0;
+
+  const auto scheduler =
+      flatflow::Scheduler(kDataParallelWorldSize, kGlobalBatchSize,
+                          kMicroBatchSize, sizes_.begin(), sizes_.end(), graph);
+  const auto checker =
+      SchedChecker(kDataParallelWorldSize, kGlobalBatchSize, kMicroBatchSize,
+                   sizes_.begin(), sizes_.end(), graph, options);
+
+  const auto trace = flatflow::symbolic_trace(graph);
+
+  constexpr auto kNumGlobalBatches =
+      (kTotalSize + kGlobalBatchSize - 1) / kGlobalBatchSize;
+
+  // Returns the cost of the slowest replica in each global batch.
+  const auto costs = [&](const std::vector<size_t> &indices,
+                         const std::vector<size_t> &batch_sizes) {
+    auto costs = std::vector<int64_t>(kNumGlobalBatches);
+    auto offset = static_cast<size_t>(0);
+    for (size_t index = 0; index < batch_sizes.size(); ++index) {
+      auto cost = static_cast<int64_t>(0);
+      for (size_t count = 0; count < batch_sizes[index]; ++count) {
+        cost += trace(sizes_[indices[offset++]]);
+      }
+      auto &max = costs[index / kDataParallelWorldSize];
+      max = std::max(max, cost);
+    }
+    return costs;
+  };
+
+  checker.on_train_begin();
+  for (size_t epoch = 0; epoch < kNumEpochs; ++epoch) {
+    checker.on_epoch_begin(epoch);
+
+    auto schedule = std::vector<size_t>(kTotalSize);
+    std::iota(schedule.begin(), schedule.end(), 0);
+
+    auto generator = std::mt19937();
+    generator.seed(epoch);
+    std::shuffle(schedule.begin(), schedule.end(), generator);
+
+    checker.Check(schedule);
+
+    auto indices = std::vector<size_t>(kTotalSize);
+    auto batch_sizes =
+        std::vector<size_t>(kNumGlobalBatches * kDataParallelWorldSize);
+    checker.Schedule(schedule.begin(), schedule.end(), indices.begin(),
+                     batch_sizes.begin());
+
+    auto unrefined_indices = std::vector<size_t>(kTotalSize);
+    auto unrefined_batch_sizes =
+        std::vector<size_t>(kNumGlobalBatches * kDataParallelWorldSize);
+    scheduler.Schedule(schedule.begin(), schedule.end(),
+                       unrefined_indices.begin(),
+                       unrefined_batch_sizes.begin());
+
+    EXPECT_EQ(batch_sizes, unrefined_batch_sizes);
+
+    const auto refined = costs(indices, batch_sizes);
+    const auto unrefined = costs(unrefined_indices, unrefined_batch_sizes);
+    for (size_t index = 0; index < kNumGlobalBatches; ++index) {
+      EXPECT_LE(refined[index], unrefined[index]);
+    }
+
+    checker.on_epoch_end(epoch);
+  }
+  checker.on_train_end();
+}
+
+// This test checks whether the computation schedule stays the same regardless
+// of the number of threads, including when a single global batch is large
+// enough to be sorted in parallel.
+TEST_F(SchedulerWithOptionsTest, NumThreads) {
+  auto builder = flatbuffers::FlatBufferBuilder();
+  auto root = CreateSelfAttention(builder);
+  builder.Finish(root);
+
+  auto graph =
+      flatbuffers::GetRoot<flatflow::Graph>(builder.GetBufferPointer());
+
+  auto options = flatflow::SchedulerOptions();
+  options.node_ids = std::vector<size_t>({0, 0, 0, 0, 1, 1, 1, 1});
+
+  for (const auto global_batch_size : {kGlobalBatchSize, kTotalSize}) {
+    const auto checker =
+        SchedChecker(kDataParallelWorldSize, global_batch_size,
+                     kMicroBatchSize, sizes_.begin(), sizes_.end(), graph,
+                     options);
+
+    const auto num_global_batches =
+        (kTotalSize + global_batch_size - 1) / global_batch_size;
+
+    auto schedule = std::vector<size_t>(kTotalSize);
+    std::iota(schedule.begin(), schedule.end(), 0);
+
+    auto generator = std::mt19937();
+    std::shuffle(schedule.begin(), schedule.end(), generator);
+
+    checker.Check(schedule);
+
+    const auto max_threads = omp_get_max_threads();
+
+    omp_set_num_threads(1);
+    auto expected = std::vector<size_t>(kTotalSize);
+    auto expected_sizes =
+        std::vector<size_t>(num_global_batches * kDataParallelWorldSize);
+    checker.Schedule(schedule.begin(), schedule.end(), expected.begin(),
+                     expected_sizes.begin());
+
+    omp_set_num_threads(std::max(max_threads, 4));
+    auto result = std::vector<size_t>(kTotalSize);
+    auto sizes =
+        std::vector<size_t>(num_global_batches * kDataParallelWorldSize);
+    checker.Schedule(schedule.begin(), schedule.end(), result.begin(),
+                     sizes.begin());
+
+    omp_set_num_threads(max_threads);
+
+    EXPECT_EQ(result, expected);
+    EXPECT_EQ(sizes, expected_sizes);
+  }
+}
+
+// This test checks whether memoized schedules are the same as those made from
+// scratch, both when the order stays the same across epochs and when only
+// a few global batches change.
+TEST_F(SchedulerWithOptionsTest, MemoizeSchedule) {
+  auto builder = flatbuffers::FlatBufferBuilder();
+  auto root = CreateSelfAttention(builder);
+  builder.Finish(root);
+
+  auto graph =
+      flatbuffers::GetRoot<flatflow::Graph>(builder.GetBufferPointer());
+
+  auto options = flatflow::SchedulerOptions();
+  options.memoize_schedule = true;
+
+  const auto scheduler =
+      flatflow::Scheduler(kDataParallelWorldSize, kGlobalBatchSize,
+                          kMicroBatchSize, sizes_.begin(), sizes_.end(), graph,
+                          options);
+  const auto checker =
+      SchedChecker(kDataParallelWorldSize, kGlobalBatchSize, kMicroBatchSize,
+                   sizes_.begin(), sizes_.end(), graph);
+
+  constexpr auto kNumGlobalBatches =
+      (kTotalSize + kGlobalBatchSize - 1) / kGlobalBatchSize;
+
+  auto schedule = std::vector<size_t>(kTotalSize);
+  std::iota(schedule.begin(), schedule.end(), 0);
+
+  checker.on_train_begin();
+  for (size_t epoch = 0; epoch < kNumEpochs + 1; ++epoch) {
+    checker.on_epoch_begin(epoch);
+
+    // The last epoch swaps a sample in the first global batch with another
+    // in the second one, so that only these two are scheduled again.
+    if (epoch == kNumEpochs) {
+      std::swap(schedule.front(), schedule[kGlobalBatchSize]);
+    }
+
+    auto expected = std::vector<size_t>(kTotalSize);
+    auto expected_sizes =
+        std::vector<size_t>(kNumGlobalBatches * kDataParallelWorldSize);
+    checker.Schedule(schedule.begin(), schedule.end(), expected.begin(),
+                     expected_sizes.begin());
+
+    auto result = std::vector<size_t>(kTotalSize);
+    auto sizes =
+        std::vector<size_t>(kNumGlobalBatches * kDataParallelWorldSize);
+    scheduler.Schedule(schedule.begin(), schedule.end(), result.begin(),
+                       sizes.begin());
+
+    EXPECT_EQ(result, expected);
+    EXPECT_EQ(sizes, expected_sizes);
+
+    checker.on_epoch_end(epoch);
+  }
+  checker.on_train_end();
+}
+
 }  // namespace